@@ -0,0 +1,358 @@
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "CaptureFile.hh"
+#include "FrameCodec.hh"
+
+using namespace capture;
+
+namespace {
+
+const char file_magic[8] = {'R', 'G', 'L', 'C', 'A', 'P', '0', '1'};
+const char segment_magic[4] = {'S', 'E', 'G', 'M'};
+const char index_magic[8] = {'R', 'G', 'L', 'I', 'D', 'X', '0', '1'};
+const uint32_t version = 1;
+
+static_assert(sizeof(File_header) == 16 && sizeof(Segment_header) == 8 && sizeof(Record_header) == 40 &&
+			sizeof(Index_entry) == 24 && sizeof(Trailer) == 24, "Capture file structures have to be packed");
+
+//! Records are padded so that every header in the mapping is aligned
+inline uint64_t padded(uint64_t size) {
+
+	return (size + 7) & ~(uint64_t)7;
+
+}
+
+inline int64_t toNanoseconds(std::chrono::system_clock::time_point time) {
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+
+}
+
+inline std::chrono::system_clock::time_point fromNanoseconds(int64_t time) {
+
+	return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+				std::chrono::nanoseconds(time)));
+
+}
+
+}
+
+CaptureWriter::CaptureWriter(const std::string& path, size_t segment_frames, bool compress) :
+			file_(path.c_str(), std::ios::binary | std::ios::trunc), path_(path),
+			segment_frames_(segment_frames ? segment_frames : 1), segment_offset_(0), frames_in_segment_(0),
+			offset_(0), compress_(compress) {
+
+	if(!file_)
+		throw std::runtime_error("Could not create capture file " + path);
+
+	File_header header = {};
+	memcpy(header.magic, file_magic, sizeof(header.magic));
+	header.version = version;
+	file_.write((const char*)&header, sizeof(header));
+	offset_ = sizeof(header);
+	check();
+
+}
+
+CaptureWriter::~CaptureWriter() {
+
+	try {
+		close();
+	}
+	catch(...) {
+	}
+
+}
+
+void CaptureWriter::append(const Waveform_frame& frame) {
+
+	if(!file_.is_open())
+		throw std::runtime_error("Capture file " + path_ + " is closed");
+
+	if(frames_in_segment_ == 0)
+		beginSegment();
+
+	Record_header header = {};
+	header.timestamp = toNanoseconds(frame.timestamp);
+	header.samples = frame.samples.size();
+	header.channel = frame.channel;
+	header.volt_scale = frame.volt_scale;
+	header.volt_offset = frame.volt_offset;
+	header.timescale = frame.timescale;
+	header.time_offset = frame.time_offset;
+	header.sample_interval = frame.sample_interval;
+
+	const uint8_t* samples = frame.samples.data();
+	header.stored_size = frame.samples.size();
+	if(compress_) {
+		encodeFrame(frame.samples, encoded_);
+		samples = encoded_.data();
+		header.encoding = Encoding_rice;
+		header.stored_size = encoded_.size();
+	}
+
+	Index_entry entry = {};
+	entry.offset = offset_;
+	entry.timestamp = header.timestamp;
+	entry.samples = header.samples;
+	entry.channel = header.channel;
+
+	static const char padding[8] = {};
+	uint64_t size = sizeof(header) + header.stored_size;
+	file_.write((const char*)&header, sizeof(header));
+	file_.write((const char*)samples, header.stored_size);
+	file_.write(padding, padded(size) - size);
+	check();
+
+	offset_ += padded(size);
+	index_.push_back(entry);
+
+	if(++frames_in_segment_ == segment_frames_)
+		endSegment();
+
+}
+
+void CaptureWriter::close() {
+
+	if(!file_.is_open())
+		return;
+
+	if(frames_in_segment_ != 0)
+		endSegment();
+
+	Trailer trailer = {};
+	trailer.index_offset = offset_;
+	trailer.frames = index_.size();
+	memcpy(trailer.magic, index_magic, sizeof(trailer.magic));
+
+	file_.write((const char*)index_.data(), index_.size()*sizeof(Index_entry));
+	file_.write((const char*)&trailer, sizeof(trailer));
+	file_.flush();
+	check();
+	file_.close();
+
+}
+
+size_t CaptureWriter::size() const {
+
+	return index_.size();
+
+}
+
+void CaptureWriter::beginSegment() {
+
+	Segment_header header = {};
+	memcpy(header.magic, segment_magic, sizeof(header.magic));
+	file_.write((const char*)&header, sizeof(header));
+	check();
+
+	segment_offset_ = offset_;
+	offset_ += sizeof(header);
+
+}
+
+void CaptureWriter::endSegment() {
+
+	// The frame count marks the segment complete
+	uint32_t frames = frames_in_segment_;
+	file_.seekp(segment_offset_ + offsetof(Segment_header, frames));
+	file_.write((const char*)&frames, sizeof(frames));
+	file_.seekp(offset_);
+	file_.flush();
+	check();
+
+	frames_in_segment_ = 0;
+
+}
+
+void CaptureWriter::check() {
+
+	if(!file_)
+		throw std::runtime_error("Could not write capture file " + path_);
+
+}
+
+CaptureReader::CaptureReader(const std::string& path) : data_(0), size_(0), index_(0), frames_(0), indexed_(false) {
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw std::runtime_error("Could not open capture file " + path + ": " + strerror(errno));
+
+	struct stat status;
+	if(fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(File_header)) {
+		::close(fd);
+		throw std::runtime_error("Not a capture file: " + path);
+	}
+
+	size_ = status.st_size;
+	void* data = mmap(0, size_, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED)
+		throw std::runtime_error("Could not map capture file " + path + ": " + strerror(errno));
+	data_ = (const uint8_t*)data;
+
+	const File_header* header = (const File_header*)data_;
+	if(memcmp(header->magic, file_magic, sizeof(file_magic)) != 0 || header->version != version) {
+		munmap((void*)data_, size_);
+		throw std::runtime_error("Not a capture file: " + path);
+	}
+
+	// Use the index footer if the capture was closed properly, otherwise walk the segments
+	const Trailer* trailer = (const Trailer*)(data_ + size_ - sizeof(Trailer));
+	if(size_ >= sizeof(File_header) + sizeof(Trailer) && memcmp(trailer->magic, index_magic, sizeof(index_magic)) == 0 &&
+				trailer->index_offset <= size_ - sizeof(Trailer) &&
+				trailer->frames == (size_ - sizeof(Trailer) - trailer->index_offset)/sizeof(Index_entry)) {
+		index_ = (const Index_entry*)(data_ + trailer->index_offset);
+		frames_ = trailer->frames;
+		indexed_ = true;
+	}
+	else
+		scan();
+
+}
+
+CaptureReader::~CaptureReader() {
+
+	munmap((void*)data_, size_);
+
+}
+
+size_t CaptureReader::size() const {
+
+	return frames_;
+
+}
+
+bool CaptureReader::indexed() const {
+
+	return indexed_;
+
+}
+
+void CaptureReader::read(size_t index, Waveform_frame& frame) const {
+
+	const Record_header& header = record(index);
+	const uint8_t* samples = (const uint8_t*)(&header + 1);
+
+	frame.channel = (Channel)header.channel;
+	if(header.encoding == Encoding_rice) {
+		decodeFrame(samples, header.stored_size, frame.samples);
+		if(frame.samples.size() != header.samples)
+			throw std::runtime_error("Corrupt frame in capture file");
+	}
+	else
+		frame.samples.assign(samples, samples + header.samples);
+	frame.volt_scale = header.volt_scale;
+	frame.volt_offset = header.volt_offset;
+	frame.timescale = header.timescale;
+	frame.time_offset = header.time_offset;
+	frame.sample_interval = header.sample_interval;
+	frame.timestamp = fromNanoseconds(header.timestamp);
+
+}
+
+const uint8_t* CaptureReader::samples(size_t index, size_t& count) const {
+
+	const Record_header& header = record(index);
+	if(header.encoding != Encoding_raw)
+		throw std::logic_error("Frame is compressed, use read()");
+	count = header.samples;
+	return (const uint8_t*)(&header + 1);
+
+}
+
+std::chrono::system_clock::time_point CaptureReader::timestamp(size_t index) const {
+
+	if(index >= frames_)
+		throw std::out_of_range("No such frame");
+	return fromNanoseconds(index_[index].timestamp);
+
+}
+
+Channel CaptureReader::channel(size_t index) const {
+
+	if(index >= frames_)
+		throw std::out_of_range("No such frame");
+	return (Channel)index_[index].channel;
+
+}
+
+size_t CaptureReader::findFrame(std::chrono::system_clock::time_point time) const {
+
+	int64_t nanoseconds = toNanoseconds(time);
+	const Index_entry* found = std::lower_bound(index_, index_ + frames_, nanoseconds,
+				[](const Index_entry& entry, int64_t t) { return entry.timestamp < t; });
+	return found - index_;
+
+}
+
+std::pair<size_t, size_t> CaptureReader::findRange(std::chrono::system_clock::time_point begin,
+			std::chrono::system_clock::time_point end) const {
+
+	size_t first = findFrame(begin);
+	return std::make_pair(first, std::max(first, findFrame(end)));
+
+}
+
+const Record_header& CaptureReader::record(size_t index) const {
+
+	if(index >= frames_)
+		throw std::out_of_range("No such frame");
+
+	// The index footer comes from the file too, a record it points at has to lie within the mapping
+	uint64_t offset = index_[index].offset;
+	if(offset > size_ || size_ - offset < sizeof(Record_header))
+		throw std::runtime_error("Corrupt frame in capture file");
+	const Record_header& header = *(const Record_header*)(data_ + offset);
+	if(header.stored_size > size_ - offset - sizeof(Record_header) ||
+				(header.encoding != Encoding_raw && header.encoding != Encoding_rice) ||
+				(header.encoding == Encoding_raw && header.samples != header.stored_size))
+		throw std::runtime_error("Corrupt frame in capture file");
+	return header;
+
+}
+
+void CaptureReader::scan() {
+
+	uint64_t offset = sizeof(File_header);
+
+	while(offset + sizeof(Segment_header) <= size_) {
+		const Segment_header* segment = (const Segment_header*)(data_ + offset);
+		if(memcmp(segment->magic, segment_magic, sizeof(segment_magic)) != 0)
+			break;
+		offset += sizeof(Segment_header);
+
+		// An incomplete segment is the last one, it is read until the data runs out
+		size_t frames = segment->frames ? segment->frames : (size_t)-1;
+		for(size_t i = 0; i != frames; ++i) {
+			if(offset + sizeof(Record_header) > size_)
+				break;
+			const Record_header* header = (const Record_header*)(data_ + offset);
+			uint64_t size = padded(sizeof(Record_header) + header->stored_size);
+			if(offset + size > size_ || (header->channel != CH1 && header->channel != CH2))
+				break;
+
+			Index_entry entry = {};
+			entry.offset = offset;
+			entry.timestamp = header->timestamp;
+			entry.samples = header->samples;
+			entry.channel = header->channel;
+			scanned_.push_back(entry);
+			offset += size;
+		}
+		if(segment->frames == 0)
+			break;
+	}
+
+	index_ = scanned_.data();
+	frames_ = scanned_.size();
+
+}
@@ -0,0 +1,189 @@
+#ifndef CAPTUREFILE_HH
+#define CAPTUREFILE_HH
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include "WaveformFrame.hh"
+
+//! Capture files store raw frames with their settings, so hours of acquisitions can be recorded without
+//! converting anything to volts. Layout of a file:
+//!   File header
+//!   Segments, each a segment header followed by the frames of the segment. A frame is a record header
+//!   (timestamp, settings, amount of samples) followed by the samples, raw or compressed with
+//!   encodeFrame(), padded to 8 bytes
+//!   Index footer, one entry per frame (offset, timestamp, channel, samples) and a trailer pointing to it
+//! All values are little endian. The index is written when the capture is closed, files without one
+//! (a crashed recording for example) are indexed by scanning the segments when opened.
+
+namespace capture {
+
+struct File_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+struct Segment_header {
+	char magic[4];
+//! Amount of frames in the segment, 0 until the segment is complete
+	uint32_t frames;
+};
+
+struct Record_header {
+//! Nanoseconds since the epoch of std::chrono::system_clock
+	int64_t timestamp;
+	uint32_t samples;
+	uint8_t channel;
+//! Encoding_raw or Encoding_rice
+	uint8_t encoding;
+	uint8_t reserved[2];
+	float volt_scale;
+	float volt_offset;
+	float timescale;
+	float time_offset;
+	float sample_interval;
+//! Size of the stored samples in bytes
+	uint32_t stored_size;
+};
+
+enum Encoding {Encoding_raw, Encoding_rice};
+
+struct Index_entry {
+//! Offset of the record header from the beginning of the file
+	uint64_t offset;
+	int64_t timestamp;
+	uint32_t samples;
+	uint8_t channel;
+	uint8_t reserved[3];
+};
+
+struct Trailer {
+	uint64_t index_offset;
+	uint64_t frames;
+	char magic[8];
+};
+
+}
+
+//! Appends frames to a capture file
+class CaptureWriter {
+public:
+
+//! Create a capture file, an existing file is overwritten
+//! \note{Throws std::runtime_error if the file can not be created}
+//! @param path Path of the file
+//! @param segment_frames Amount of frames in a segment, the file is flushed after every segment
+//! @param compress Store the samples compressed, see FrameCodec.hh
+	CaptureWriter(const std::string& path, size_t segment_frames = 1024, bool compress = false);
+
+//! Closes the capture if close() was not called, errors are ignored
+	~CaptureWriter();
+
+//! Append a frame to the capture. Frames should be appended in the order of their timestamps,
+//! the time based seeking of CaptureReader relies on it.
+//! \note{Throws std::runtime_error on write errors}
+	void append(const Waveform_frame& frame);
+
+//! Finish the last segment and write the index. Nothing can be appended after this.
+//! \note{Throws std::runtime_error on write errors}
+	void close();
+
+//! @return Amount of frames appended
+	size_t size() const;
+
+private:
+
+	void beginSegment();
+	void endSegment();
+	void check();
+
+	std::ofstream file_;
+	std::string path_;
+	size_t segment_frames_;
+	uint64_t segment_offset_;
+	size_t frames_in_segment_;
+	uint64_t offset_;
+	bool compress_;
+	std::vector<uint8_t> encoded_;
+	std::vector<capture::Index_entry> index_;
+
+//! Disable copying and assignment
+	CaptureWriter(const CaptureWriter&);
+	CaptureWriter& operator=(const CaptureWriter&);
+
+};
+
+//! Reads a capture file through a read only memory mapping. Only the index is looked at when opening,
+//! frames are read from the mapping when asked for.
+class CaptureReader {
+public:
+
+//! Open a capture file
+//! \note{Throws std::runtime_error if the file can not be mapped or is not a capture file}
+//! @param path Path of the file
+	explicit CaptureReader(const std::string& path);
+
+	~CaptureReader();
+
+//! @return Amount of frames in the capture
+	size_t size() const;
+
+//! @return false if the file had no index and it was rebuilt by scanning the file
+	bool indexed() const;
+
+//! Read a frame, compressed frames are decompressed
+//! \note{Throws std::out_of_range if there is no such frame, and std::runtime_error if it is corrupt}
+//! @param index Index of the frame
+//! @param frame Frame to fill, the sample memory is reused if it is big enough
+	void read(size_t index, Waveform_frame& frame) const;
+
+//! Samples of a frame without copying, valid as long as the reader is
+//! \note{Throws std::out_of_range if there is no such frame, std::logic_error if the frame is compressed and
+//! std::runtime_error if it is corrupt}
+//! @param index Index of the frame
+//! @param count Amount of samples
+//! @return Pointer to the samples in the mapping
+	const uint8_t* samples(size_t index, size_t& count) const;
+
+//! @return Timestamp of a frame
+	std::chrono::system_clock::time_point timestamp(size_t index) const;
+
+//! @return Channel of a frame
+	Channel channel(size_t index) const;
+
+//! Binary search for the first frame with a timestamp at or after time
+//! @return Index of the frame, size() if there is none
+	size_t findFrame(std::chrono::system_clock::time_point time) const;
+
+//! Frames with timestamps in [begin, end)
+//! @return Index of the first frame and one past the last frame of the range
+	std::pair<size_t, size_t> findRange(std::chrono::system_clock::time_point begin,
+				std::chrono::system_clock::time_point end) const;
+
+private:
+
+//! \note{Throws std::out_of_range if there is no such frame, and std::runtime_error if the record does not fit
+//! in the file, has an unknown encoding or is raw with a different amount of samples than bytes stored}
+	const capture::Record_header& record(size_t index) const;
+	void scan();
+
+	const uint8_t* data_;
+	size_t size_;
+	const capture::Index_entry* index_;
+	size_t frames_;
+	bool indexed_;
+//! Index rebuilt by scan() for files without one
+	std::vector<capture::Index_entry> scanned_;
+
+//! Disable copying and assignment
+	CaptureReader(const CaptureReader&);
+	CaptureReader& operator=(const CaptureReader&);
+
+};
+
+#endif
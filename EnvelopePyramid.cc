@@ -0,0 +1,152 @@
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include "EnvelopePyramid.hh"
+#include "SampleScaler.hh"
+
+namespace {
+
+inline void include(Min_max& result, const Min_max& other) {
+
+	result.min = std::min(result.min, other.min);
+	result.max = std::max(result.max, other.max);
+
+}
+
+inline void include(Min_max& result, uint8_t sample) {
+
+	result.min = std::min(result.min, sample);
+	result.max = std::max(result.max, sample);
+
+}
+
+}
+
+EnvelopePyramid::EnvelopePyramid() : levels_(1) {
+
+}
+
+void EnvelopePyramid::clear() {
+
+	samples_.clear();
+	levels_.assign(1, std::vector<Min_max>());
+
+}
+
+void EnvelopePyramid::reserve(size_t samples) {
+
+	samples_.reserve(samples);
+	levels_[0].reserve(samples/block_size_);
+
+}
+
+void EnvelopePyramid::append(const uint8_t* samples, size_t count) {
+
+	samples_.insert(samples_.end(), samples, samples + count);
+
+	// Blocks completed by the new samples
+	std::vector<Min_max>& blocks = levels_[0];
+	for(size_t block = blocks.size(); block < samples_.size()/block_size_; ++block) {
+		const uint8_t* data = samples_.data() + block*block_size_;
+		Min_max result = {data[0], data[0]};
+		for(size_t i = 1; i != block_size_; ++i)
+			include(result, data[i]);
+		blocks.push_back(result);
+	}
+
+	// Pairs completed on each level
+	for(size_t level = 0; levels_[level].size() >= 2; ++level) {
+		if(level + 1 == levels_.size())
+			levels_.push_back(std::vector<Min_max>());
+		const std::vector<Min_max>& below = levels_[level];
+		std::vector<Min_max>& above = levels_[level + 1];
+		for(size_t i = above.size(); i < below.size()/2; ++i) {
+			Min_max result = below[2*i];
+			include(result, below[2*i + 1]);
+			above.push_back(result);
+		}
+	}
+
+}
+
+void EnvelopePyramid::assign(const std::vector<uint8_t>& samples) {
+
+	clear();
+	append(samples.data(), samples.size());
+
+}
+
+size_t EnvelopePyramid::size() const {
+
+	return samples_.size();
+
+}
+
+const std::vector<uint8_t>& EnvelopePyramid::samples() const {
+
+	return samples_;
+
+}
+
+Min_max EnvelopePyramid::range(size_t begin, size_t end) const {
+
+	if(begin >= end || end > samples_.size())
+		throw std::out_of_range("Invalid sample range");
+
+	Min_max result = {samples_[begin], samples_[begin]};
+
+	// Samples outside whole blocks
+	while(begin != end && begin % block_size_ != 0)
+		include(result, samples_[begin++]);
+	while(end != begin && end % block_size_ != 0)
+		include(result, samples_[--end]);
+
+	// Climb the levels taking the entries that do not pair up with a neighbour inside the range
+	size_t first = begin/block_size_;
+	size_t last = end/block_size_;
+	for(size_t level = 0; first < last; ++level) {
+		const std::vector<Min_max>& entries = levels_[level];
+		if(first & 1)
+			include(result, entries[first++]);
+		if(last & 1)
+			include(result, entries[--last]);
+		first >>= 1;
+		last >>= 1;
+	}
+
+	return result;
+
+}
+
+void EnvelopePyramid::envelope(size_t begin, size_t end, size_t buckets, std::vector<Min_max>& result) const {
+
+	if(begin >= end || end > samples_.size())
+		throw std::out_of_range("Invalid sample range");
+
+	result.resize(buckets);
+	uint64_t width = end - begin;
+	for(size_t i = 0; i != buckets; ++i) {
+		size_t first = begin + width*i/buckets;
+		size_t last = begin + width*(i + 1)/buckets;
+		result[i] = range(first, std::max(last, first + 1));
+	}
+
+}
+
+void EnvelopePyramid::envelope(size_t begin, size_t end, size_t buckets, float volt_offset, float volt_scale,
+			std::vector<float>& min, std::vector<float>& max) const {
+
+	std::vector<Min_max> raw;
+	envelope(begin, end, buckets, raw);
+
+	SampleScaler scaler;
+	scaler.configure(volt_offset, volt_scale);
+	min.resize(buckets);
+	max.resize(buckets);
+	for(size_t i = 0; i != buckets; ++i) {
+		// Bigger raw value is a smaller voltage
+		min[i] = scaler(raw[i].max);
+		max[i] = scaler(raw[i].min);
+	}
+
+}
@@ -0,0 +1,74 @@
+#ifndef ENVELOPEPYRAMID_HH
+#define ENVELOPEPYRAMID_HH
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Smallest and largest raw sample of a range
+struct Min_max {
+
+	uint8_t min;
+	uint8_t max;
+
+};
+
+//! Multi resolution min/max decimation of a long frame. Level 0 holds the min/max of every block of 16
+//! samples, every level above it combines two entries of the level below. The pyramid is built while
+//! samples are appended, so it can be fed chunk by chunk as a long memory frame is read from the scope.
+//! The min/max of any range is combined from at most two entries per level plus the unaligned samples
+//! at the ends, so an envelope of N buckets costs O(N log(range/N)) instead of touching every sample.
+//! \note{The values are raw samples, the scope sends the samples upside down so the raw minimum is the
+//! maximum voltage, see the volts version of envelope()}
+class EnvelopePyramid {
+public:
+
+	EnvelopePyramid();
+
+//! Remove all samples
+	void clear();
+
+//! Reserve memory for samples, avoids reallocations while appending
+	void reserve(size_t samples);
+
+//! Append samples and update the levels they complete
+	void append(const uint8_t* samples, size_t count);
+
+//! Replace the samples
+	void assign(const std::vector<uint8_t>& samples);
+
+//! @return Amount of samples
+	size_t size() const;
+
+//! @return The samples appended so far
+	const std::vector<uint8_t>& samples() const;
+
+//! Min/max of the samples [begin, end)
+//! \note{Throws std::out_of_range if the range is empty or goes past the end}
+	Min_max range(size_t begin, size_t end) const;
+
+//! Envelope of the samples [begin, end) split into buckets of equal width. If there are more buckets than
+//! samples, buckets get the value of the sample they start at.
+//! \note{Throws std::out_of_range if the range is empty or goes past the end}
+//! @param buckets Amount of buckets
+//! @param result Min/max of each bucket, the memory is reused if it is big enough
+	void envelope(size_t begin, size_t end, size_t buckets, std::vector<Min_max>& result) const;
+
+//! Envelope as volts, see envelope() above
+//! @param volt_offset Voltage offset of the channel the samples are from
+//! @param volt_scale v/div of the channel the samples are from
+//! @param min Smallest voltage of each bucket
+//! @param max Largest voltage of each bucket
+	void envelope(size_t begin, size_t end, size_t buckets, float volt_offset, float volt_scale,
+				std::vector<float>& min, std::vector<float>& max) const;
+
+private:
+
+	static const size_t block_size_ = 16;
+
+	std::vector<uint8_t> samples_;
+	std::vector<std::vector<Min_max> > levels_;
+
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include <vector>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "FrameAccumulator.hh"
+
+namespace {
+
+//! Fraction bits of the exponential average, a raw sample shifted left by 7 still fits an int16_t
+const unsigned exponential_bits = 7;
+
+void addSums(const uint8_t* samples, size_t count, uint32_t* sums) {
+
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	for(; i + 16 <= count; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+		__m128i low = _mm_unpacklo_epi8(x, zero);
+		__m128i high = _mm_unpackhi_epi8(x, zero);
+		__m128i* s = (__m128i*)(sums + i);
+		_mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_unpacklo_epi16(low, zero)));
+		_mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(low, zero)));
+		_mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(high, zero)));
+		_mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(high, zero)));
+	}
+#endif
+	for(; i != count; ++i)
+		sums[i] += samples[i];
+
+}
+
+void addPeak(const uint8_t* samples, size_t count, uint8_t* min, uint8_t* max) {
+
+	size_t i = 0;
+#ifdef __SSE2__
+	for(; i + 16 <= count; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+		__m128i* low = (__m128i*)(min + i);
+		__m128i* high = (__m128i*)(max + i);
+		_mm_storeu_si128(low, _mm_min_epu8(_mm_loadu_si128(low), x));
+		_mm_storeu_si128(high, _mm_max_epu8(_mm_loadu_si128(high), x));
+	}
+#endif
+	for(; i != count; ++i) {
+		min[i] = std::min(min[i], samples[i]);
+		max[i] = std::max(max[i], samples[i]);
+	}
+
+}
+
+//! average += (sample - average)/2^shift in fixed point
+void addExponential(const uint8_t* samples, size_t count, unsigned shift, int16_t* average) {
+
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	for(; i + 16 <= count; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+		__m128i* a = (__m128i*)(average + i);
+		__m128i low = _mm_slli_epi16(_mm_unpacklo_epi8(x, zero), exponential_bits);
+		__m128i high = _mm_slli_epi16(_mm_unpackhi_epi8(x, zero), exponential_bits);
+		__m128i first = _mm_loadu_si128(a);
+		__m128i second = _mm_loadu_si128(a + 1);
+		first = _mm_add_epi16(first, _mm_sra_epi16(_mm_sub_epi16(low, first), _mm_cvtsi32_si128(shift)));
+		second = _mm_add_epi16(second, _mm_sra_epi16(_mm_sub_epi16(high, second), _mm_cvtsi32_si128(shift)));
+		_mm_storeu_si128(a, first);
+		_mm_storeu_si128(a + 1, second);
+	}
+#endif
+	for(; i != count; ++i)
+		average[i] += (int16_t)((samples[i] << exponential_bits) - average[i]) >> shift;
+
+}
+
+}
+
+FrameAccumulator::FrameAccumulator(size_t samples, unsigned flags, unsigned exponential_shift, size_t columns) :
+			samples_(samples), flags_(flags), shift_(exponential_shift), columns_(columns ? columns : samples),
+			rows_(samples), active_(0), writing_(-1), reset_(false), last_bank_(0), generation_(0), started_(false),
+			frames_(0), snapshot_generation_(0), channel_(CH1), volt_scale_(0.0), volt_offset_(0.0),
+			sample_interval_(0.0) {
+
+	if(samples == 0)
+		throw std::invalid_argument("Frames need at least one sample");
+	if(exponential_shift < 1 || exponential_shift > exponential_bits)
+		throw std::invalid_argument("Exponential shift has to be 1 to 7");
+
+	for(size_t i = 0; i != samples_; ++i)
+		rows_[i] = i*columns_/samples_*256;
+
+	for(Bank& bank : banks_) {
+		if(flags_ & Accumulate_mean)
+			bank.sums.resize(samples_);
+		if(flags_ & Accumulate_peak) {
+			bank.min.resize(samples_);
+			bank.max.resize(samples_);
+		}
+		if(flags_ & Accumulate_histogram)
+			bank.histogram.resize(columns_*256);
+		if(flags_ & Accumulate_exponential)
+			bank.exponential.resize(samples_);
+		bank.generation = 0;
+		bank.channel = CH1;
+		bank.volt_scale = bank.volt_offset = bank.sample_interval = 0.0;
+		clear(bank);
+	}
+
+	if(flags_ & Accumulate_mean)
+		sums_.resize(samples_);
+	if(flags_ & Accumulate_peak) {
+		min_.resize(samples_, 255);
+		max_.resize(samples_, 0);
+	}
+	if(flags_ & Accumulate_histogram)
+		histogram_.resize(columns_*256);
+	if(flags_ & Accumulate_exponential)
+		exponential_.resize(samples_);
+
+}
+
+void FrameAccumulator::clear(Bank& bank) {
+
+	std::fill(bank.sums.begin(), bank.sums.end(), 0);
+	std::fill(bank.min.begin(), bank.min.end(), 255);
+	std::fill(bank.max.begin(), bank.max.end(), 0);
+	std::fill(bank.histogram.begin(), bank.histogram.end(), 0);
+	bank.frames = 0;
+
+}
+
+void FrameAccumulator::add(const Waveform_frame& frame) {
+
+	if(frame.samples.size() != samples_)
+		throw std::invalid_argument("Frame has a different amount of samples than the accumulator");
+
+	// Announce the bank being written, and check that snapshot() did not swap the banks meanwhile
+	int active;
+	while(true) {
+		active = active_.load();
+		writing_.store(active);
+		if(active_.load() == active)
+			break;
+	}
+	Bank& bank = banks_[active];
+	const Bank& last = banks_[last_bank_];
+
+	bool reset = reset_.exchange(false);
+	if(started_ && (frame.channel != last.channel || frame.volt_scale != last.volt_scale ||
+				frame.volt_offset != last.volt_offset || frame.sample_interval != last.sample_interval))
+		reset = true;
+	if(reset) {
+		++generation_;
+		started_ = false;
+		clear(bank);
+	}
+
+	const uint8_t* samples = frame.samples.data();
+	if(flags_ & Accumulate_exponential) {
+		if(!started_) {
+			for(size_t i = 0; i != samples_; ++i)
+				bank.exponential[i] = samples[i] << exponential_bits;
+		}
+		else {
+			// The average goes on from where it was in the other bank
+			if(active != last_bank_)
+				bank.exponential = last.exponential;
+			addExponential(samples, samples_, shift_, bank.exponential.data());
+		}
+	}
+	if(flags_ & Accumulate_mean)
+		addSums(samples, samples_, bank.sums.data());
+	if(flags_ & Accumulate_peak)
+		addPeak(samples, samples_, bank.min.data(), bank.max.data());
+	if(flags_ & Accumulate_histogram) {
+		uint32_t* histogram = bank.histogram.data();
+		for(size_t i = 0; i != samples_; ++i)
+			++histogram[rows_[i] + 255 - samples[i]];
+	}
+
+	++bank.frames;
+	bank.generation = generation_;
+	bank.channel = frame.channel;
+	bank.volt_scale = frame.volt_scale;
+	bank.volt_offset = frame.volt_offset;
+	bank.sample_interval = frame.sample_interval;
+	started_ = true;
+	last_bank_ = active;
+
+	writing_.store(-1);
+
+}
+
+void FrameAccumulator::reset() {
+
+	reset_.store(true);
+
+}
+
+void FrameAccumulator::snapshot(Accumulator_snapshot& result) {
+
+	std::lock_guard<std::mutex> lock(snapshot_mutex_);
+
+	// Retire the active bank and wait for an add() still writing it
+	int retired = active_.load();
+	active_.store(1 - retired);
+	while(writing_.load() == retired)
+		std::this_thread::yield();
+
+	Bank& bank = banks_[retired];
+	if(bank.frames != 0) {
+		if(bank.generation != snapshot_generation_) {
+			std::fill(sums_.begin(), sums_.end(), 0);
+			std::fill(min_.begin(), min_.end(), 255);
+			std::fill(max_.begin(), max_.end(), 0);
+			std::fill(histogram_.begin(), histogram_.end(), 0);
+			frames_ = 0;
+			snapshot_generation_ = bank.generation;
+		}
+		for(size_t i = 0; i != sums_.size(); ++i)
+			sums_[i] += bank.sums[i];
+		for(size_t i = 0; i != min_.size(); ++i) {
+			min_[i] = std::min(min_[i], bank.min[i]);
+			max_[i] = std::max(max_[i], bank.max[i]);
+		}
+		for(size_t i = 0; i != histogram_.size(); ++i)
+			histogram_[i] += bank.histogram[i];
+		exponential_ = bank.exponential;
+		frames_ += bank.frames;
+		channel_ = bank.channel;
+		volt_scale_ = bank.volt_scale;
+		volt_offset_ = bank.volt_offset;
+		sample_interval_ = bank.sample_interval;
+		clear(bank);
+	}
+
+	result.frames = frames_;
+	result.channel = channel_;
+	result.volt_scale = volt_scale_;
+	result.volt_offset = volt_offset_;
+	result.sample_interval = sample_interval_;
+	result.columns = columns_;
+
+	// Sums and averages are fractional raw values, so the scaling is done without the table
+	float gain = SampleScaler::gain(volt_scale_);
+	float zero = SampleScaler::zero(volt_offset_, volt_scale_);
+	bool valid = frames_ != 0;
+
+	result.mean.resize(valid ? sums_.size() : 0);
+	for(size_t i = 0; i != result.mean.size(); ++i)
+		result.mean[i] = gain*sums_[i]/frames_ + zero;
+	result.exponential.resize(valid ? exponential_.size() : 0);
+	for(size_t i = 0; i != result.exponential.size(); ++i)
+		result.exponential[i] = gain*exponential_[i]/(1 << exponential_bits) + zero;
+	// Bigger raw value is a smaller voltage
+	result.min.resize(valid ? max_.size() : 0);
+	result.max.resize(valid ? min_.size() : 0);
+	for(size_t i = 0; i != result.min.size(); ++i) {
+		result.min[i] = gain*max_[i] + zero;
+		result.max[i] = gain*min_[i] + zero;
+	}
+	result.histogram.assign(histogram_.begin(), histogram_.end());
+
+}
+
+size_t FrameAccumulator::size() const {
+
+	return samples_;
+
+}
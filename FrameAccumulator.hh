@@ -0,0 +1,128 @@
+#ifndef FRAMEACCUMULATOR_HH
+#define FRAMEACCUMULATOR_HH
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include "WaveformFrame.hh"
+
+//! Accumulations done by a FrameAccumulator, combine with |
+enum Accumulator_flags {Accumulate_mean = 1, Accumulate_exponential = 2, Accumulate_peak = 4, Accumulate_histogram = 8,
+			Accumulate_all = 15};
+
+//! State of a FrameAccumulator, voltages are scaled with the settings of the last frame
+struct Accumulator_snapshot {
+
+//! Amount of frames in the snapshot
+	size_t frames;
+	Channel channel;
+	float volt_scale;
+	float volt_offset;
+	float sample_interval;
+//! Mean of every sample in volts
+	std::vector<float> mean;
+//! Exponential average of every sample in volts
+	std::vector<float> exponential;
+//! Smallest and largest value of every sample in volts
+	std::vector<float> min;
+	std::vector<float> max;
+//! Amount of time columns of the histogram
+	size_t columns;
+//! Hit counts, columns rows of 256 amplitude levels. Level 255 - raw sample, so bigger levels are higher voltages.
+	std::vector<uint32_t> histogram;
+
+	Accumulator_snapshot() : frames(0), channel(CH1), volt_scale(0.0), volt_offset(0.0), sample_interval(0.0),
+				columns(0) {}
+
+};
+
+//! Accumulates frames of a fixed length for averaging and an analog persistence view: the running mean, an
+//! exponential average, the peak min/max and a time x amplitude histogram of hits. The raw samples are accumulated
+//! with integer math 16 samples at a time with SSE2, the exponential average in 8.7 fixed point.
+//! Frames are added into one of two banks while snapshot() swaps the banks and merges the one that was retired
+//! into its totals, so a snapshot never stops add(). Memory is allocated only in the constructor.
+//! Accumulation starts over when a frame has different channel settings than the frames before it, averaging
+//! raw samples of different scales would be meaningless.
+//! \note{add() and reset() may be called from one thread, snapshot() from any thread}
+class FrameAccumulator {
+public:
+
+//! @param samples Amount of samples in the frames
+//! @param flags Accumulations to do, see Accumulator_flags
+//! @param exponential_shift Weight of a new frame in the exponential average is 1/2^shift, 1 to 7
+//! @param columns Amount of time columns of the histogram, 0 for a column per sample
+	explicit FrameAccumulator(size_t samples, unsigned flags = Accumulate_all, unsigned exponential_shift = 4,
+				size_t columns = 0);
+
+//! Accumulate a frame
+//! \note{Throws std::invalid_argument if the frame does not have the amount of samples given to the constructor}
+	void add(const Waveform_frame& frame);
+
+//! Start over, takes effect when the next frame is added
+	void reset();
+
+//! @param result State after the frames added so far, the memory is reused if it is big enough
+	void snapshot(Accumulator_snapshot& result);
+
+//! @return Amount of samples in the frames
+	size_t size() const;
+
+private:
+
+//! Frames added since the bank was last merged
+	struct Bank {
+
+		std::vector<uint32_t> sums;
+		std::vector<uint8_t> min;
+		std::vector<uint8_t> max;
+		std::vector<uint32_t> histogram;
+//! Exponential average as of the last frame added to the bank
+		std::vector<int16_t> exponential;
+		size_t frames;
+//! Incremented on every reset, a snapshot drops its totals when a bank has a newer generation
+		unsigned generation;
+		Channel channel;
+		float volt_scale;
+		float volt_offset;
+		float sample_interval;
+
+	};
+
+	void clear(Bank& bank);
+
+	size_t samples_;
+	unsigned flags_;
+	unsigned shift_;
+	size_t columns_;
+//! Offset of the histogram row of every sample
+	std::vector<uint32_t> rows_;
+
+	Bank banks_[2];
+//! Bank add() writes to, and the bank it is writing right now or -1
+	std::atomic<int> active_;
+	std::atomic<int> writing_;
+	std::atomic<bool> reset_;
+//! Used only by add()
+	int last_bank_;
+	unsigned generation_;
+	bool started_;
+
+//! Totals of the merged banks, used only by snapshot()
+	std::mutex snapshot_mutex_;
+	std::vector<uint64_t> sums_;
+	std::vector<uint8_t> min_;
+	std::vector<uint8_t> max_;
+	std::vector<uint32_t> histogram_;
+	std::vector<int16_t> exponential_;
+	size_t frames_;
+	unsigned snapshot_generation_;
+	Channel channel_;
+	float volt_scale_;
+	float volt_offset_;
+	float sample_interval_;
+
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <string.h>
+#include "FrameCodec.hh"
+
+namespace {
+
+const size_t block_size = 64;
+//! Rice parameters 0 to 7 are coded as is, raw_block marks a block of raw 8bit residuals
+const unsigned raw_block = 15;
+//! Quotients this long are cut and the residual follows as 8 raw bits, bounds a code to 32 bits
+const unsigned escape_length = 24;
+
+inline uint8_t zigzag(uint8_t residual) {
+
+	return (uint8_t)(residual << 1) ^ (uint8_t)((int8_t)residual >> 7);
+
+}
+
+inline uint8_t unzigzag(uint8_t value) {
+
+	return (value >> 1) ^ (uint8_t)-(value & 1);
+
+}
+
+//! Residuals of a block for both predictors, a and b are the two samples before the block
+//! @return true if the linear predictor fits the block better
+inline bool residuals(const uint8_t* samples, size_t count, uint8_t a, uint8_t b, uint8_t* previous, uint8_t* linear,
+			unsigned& sum) {
+
+	unsigned previous_sum = 0;
+	unsigned linear_sum = 0;
+	for(size_t i = 0; i != count; ++i) {
+		previous[i] = zigzag(samples[i] - a);
+		linear[i] = zigzag(samples[i] - (uint8_t)(2*a - b));
+		previous_sum += previous[i];
+		linear_sum += linear[i];
+		b = a;
+		a = samples[i];
+	}
+	sum = std::min(previous_sum, linear_sum);
+	return linear_sum < previous_sum;
+
+}
+
+//! @return Size of the residuals in bits with Rice parameter k
+inline size_t riceCost(const uint8_t* values, size_t count, unsigned k) {
+
+	size_t bits = 0;
+	for(size_t i = 0; i != count; ++i) {
+		unsigned quotient = values[i] >> k;
+		bits += quotient < escape_length ? quotient + 1 + k : escape_length + 8;
+	}
+	return bits;
+
+}
+
+//! Pick the Rice parameter for the residuals. The best one is near log2 of the mean, the two
+//! candidates there are compared exactly, and raw storage if neither is smaller.
+inline unsigned riceParameter(const uint8_t* values, size_t count, unsigned sum) {
+
+	unsigned k = 0;
+	while(k != 7 && (count << (k + 1)) <= sum)
+		++k;
+
+	size_t best = 8*count;
+	unsigned parameter = raw_block;
+	for(unsigned candidate = k ? k - 1 : 0; candidate <= k + 1 && candidate != 8; ++candidate) {
+		size_t bits = riceCost(values, count, candidate);
+		if(bits < best) {
+			best = bits;
+			parameter = candidate;
+		}
+	}
+	return parameter;
+
+}
+
+class Bit_writer {
+public:
+
+	explicit Bit_writer(uint8_t* data) : data_(data), bits_(0), count_(0) {}
+
+//! @param bits At most 32
+	void put(uint32_t value, unsigned bits) {
+		bits_ |= (uint64_t)value << count_;
+		count_ += bits;
+		if(count_ >= 32) {
+			uint32_t word = bits_;
+			memcpy(data_, &word, 4);
+			data_ += 4;
+			bits_ >>= 32;
+			count_ -= 32;
+		}
+	}
+
+	uint8_t* finish() {
+		for(; count_ > 0; count_ -= std::min(count_, 8u)) {
+			*data_++ = bits_;
+			bits_ >>= 8;
+		}
+		return data_;
+	}
+
+private:
+
+	uint8_t* data_;
+	uint64_t bits_;
+	unsigned count_;
+
+};
+
+class Bit_reader {
+public:
+
+	Bit_reader(const uint8_t* data, const uint8_t* end) : data_(data), end_(end), bits_(0), count_(0) {}
+
+//! @param bits At most 32
+	uint32_t peek(unsigned bits) {
+		if(count_ < bits)
+			refill();
+		return bits_ & ((1ull << bits) - 1);
+	}
+
+	void skip(unsigned bits) {
+		if(count_ < bits)
+			refill();
+		if(count_ < bits)
+			throw std::runtime_error("Encoded frame is truncated");
+		bits_ >>= bits;
+		count_ -= bits;
+	}
+
+	uint32_t get(unsigned bits) {
+		uint32_t value = peek(bits);
+		skip(bits);
+		return value;
+	}
+
+private:
+
+	void refill() {
+		if(end_ - data_ >= 8) {
+			uint64_t word;
+			memcpy(&word, data_, 8);
+			bits_ |= word << count_;
+			data_ += (63 - count_) >> 3;
+			count_ |= 56;
+			return;
+		}
+		while(count_ <= 56 && data_ != end_) {
+			bits_ |= (uint64_t)*data_++ << count_;
+			count_ += 8;
+		}
+	}
+
+	const uint8_t* data_;
+	const uint8_t* end_;
+	uint64_t bits_;
+	unsigned count_;
+
+};
+
+}
+
+size_t maxEncodedSize(size_t count) {
+
+	size_t blocks = (count + block_size - 1)/block_size;
+	return 10 + count + (5*blocks + 7)/8;
+
+}
+
+size_t encodeFrame(const uint8_t* samples, size_t count, uint8_t* data) {
+
+	uint8_t* start = data;
+	for(size_t value = count; ; value >>= 7) {
+		if(value < 0x80) {
+			*data++ = value;
+			break;
+		}
+		*data++ = (value & 0x7f) | 0x80;
+	}
+
+	Bit_writer writer(data);
+	uint8_t previous[block_size];
+	uint8_t linear[block_size];
+	uint8_t a = 0;
+	uint8_t b = 0;
+
+	for(size_t begin = 0; begin < count; begin += block_size) {
+		size_t length = std::min(block_size, count - begin);
+		unsigned sum;
+		bool use_linear = residuals(samples + begin, length, a, b, previous, linear, sum);
+		const uint8_t* values = use_linear ? linear : previous;
+		unsigned k = riceParameter(values, length, sum);
+
+		writer.put(use_linear | (k << 1), 5);
+		if(k == raw_block) {
+			for(size_t i = 0; i != length; ++i)
+				writer.put(values[i], 8);
+		}
+		else {
+			for(size_t i = 0; i != length; ++i) {
+				unsigned quotient = values[i] >> k;
+				if(quotient < escape_length)
+					writer.put((1u << quotient) | ((values[i] & ((1u << k) - 1)) << (quotient + 1)), quotient + 1 + k);
+				else
+					writer.put((uint32_t)values[i] << escape_length, escape_length + 8);
+			}
+		}
+
+		b = length > 1 ? samples[begin + length - 2] : a;
+		a = samples[begin + length - 1];
+	}
+
+	return writer.finish() - start;
+
+}
+
+void encodeFrame(const std::vector<uint8_t>& samples, std::vector<uint8_t>& data) {
+
+	data.resize(maxEncodedSize(samples.size()));
+	data.resize(encodeFrame(samples.data(), samples.size(), data.data()));
+
+}
+
+size_t decodedSize(const uint8_t* data, size_t size) {
+
+	size_t count = 0;
+	for(size_t i = 0; i != size && i != 10; ++i) {
+		count |= (size_t)(data[i] & 0x7f) << (7*i);
+		// Every sample takes at least one bit
+		if(!(data[i] & 0x80) && count <= 8*size)
+			return count;
+	}
+	throw std::runtime_error("Not an encoded frame");
+
+}
+
+size_t decodeFrame(const uint8_t* data, size_t size, uint8_t* samples) {
+
+	size_t count = decodedSize(data, size);
+	const uint8_t* end = data + size;
+	while(*data & 0x80)
+		++data;
+	++data;
+
+	Bit_reader reader(data, end);
+	uint8_t a = 0;
+	uint8_t b = 0;
+
+	for(size_t begin = 0; begin < count; begin += block_size) {
+		size_t length = std::min(block_size, count - begin);
+		uint32_t header = reader.get(5);
+		bool use_linear = header & 1;
+		unsigned k = header >> 1;
+		if(k > 7 && k != raw_block)
+			throw std::runtime_error("Encoded frame is corrupt");
+
+		for(size_t i = 0; i != length; ++i) {
+			uint8_t value;
+			if(k == raw_block)
+				value = reader.get(8);
+			else {
+				uint32_t bits = reader.peek(escape_length);
+				unsigned quotient = bits ? __builtin_ctz(bits) : escape_length;
+				if(quotient < escape_length) {
+					reader.skip(quotient + 1);
+					value = (quotient << k) | (k ? reader.get(k) : 0);
+				}
+				else {
+					reader.skip(escape_length);
+					value = reader.get(8);
+				}
+			}
+
+			uint8_t prediction = use_linear ? (uint8_t)(2*a - b) : a;
+			uint8_t sample = prediction + unzigzag(value);
+			samples[begin + i] = sample;
+			b = a;
+			a = sample;
+		}
+	}
+
+	return count;
+
+}
+
+void decodeFrame(const uint8_t* data, size_t size, std::vector<uint8_t>& samples) {
+
+	samples.resize(decodedSize(data, size));
+	decodeFrame(data, size, samples.data());
+
+}
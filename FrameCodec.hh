@@ -0,0 +1,47 @@
+#ifndef FRAMECODEC_HH
+#define FRAMECODEC_HH
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Lossless compression for raw 8bit frames. Every sample is predicted from the ones before it in the same
+//! frame, so frames decode independently of each other. The prediction residuals are Rice coded in blocks
+//! of 64 samples, each block picking the predictor (previous sample or linear extrapolation from the two
+//! previous ones) with the smaller residuals and the Rice parameter giving the smallest output, or storing
+//! the residuals raw if that is smaller.
+//! Encoded frame: amount of samples as a LEB128 varint followed by the bitstream, least significant bit first.
+
+//! @return Upper bound for the encoded size of count samples
+size_t maxEncodedSize(size_t count);
+
+//! Compress a frame
+//! @param samples Raw samples
+//! @param count Amount of samples
+//! @param data Output buffer, has to have room for maxEncodedSize(count) bytes
+//! @return Size of the encoded frame
+size_t encodeFrame(const uint8_t* samples, size_t count, uint8_t* data);
+
+//! Compress a frame
+//! @param samples Raw samples
+//! @param data Encoded frame, the memory is reused if it is big enough
+void encodeFrame(const std::vector<uint8_t>& samples, std::vector<uint8_t>& data);
+
+//! \note{Throws std::runtime_error if the data is not an encoded frame}
+//! @return Amount of samples in an encoded frame
+size_t decodedSize(const uint8_t* data, size_t size);
+
+//! Decompress a frame
+//! \note{Throws std::runtime_error if the data is corrupt}
+//! @param data Encoded frame
+//! @param size Size of the encoded frame
+//! @param samples Output buffer, has to have room for decodedSize() samples
+//! @return Amount of samples
+size_t decodeFrame(const uint8_t* data, size_t size, uint8_t* samples);
+
+//! Decompress a frame
+//! \note{Throws std::runtime_error if the data is corrupt}
+//! @param samples Decoded samples, the memory is reused if it is big enough
+void decodeFrame(const uint8_t* data, size_t size, std::vector<uint8_t>& samples);
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef FRAMERING_HH
+#define FRAMERING_HH
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <stdexcept>
+#include <stdint.h>
+
+//! What FrameRing::push() does when the ring is full
+enum Ring_policy {Ring_drop_newest, Ring_overwrite_oldest};
+
+//! Fixed capacity lock-free ring for passing frames from one producer thread to any number of consumer threads,
+//! every item is consumed by one consumer. Items are swapped in and out instead of copied, so if the caller
+//! and the ring hold preallocated items (Waveform_frame with room for the samples for example) nothing gets
+//! allocated once the ring is running.
+//! \note{Only one thread may call push(), pop() can be called from any thread}
+template <class T>
+class FrameRing {
+public:
+
+//! \note{Throws std::invalid_argument if capacity is less than two}
+//! @param capacity Amount of items the ring holds
+//! @param policy What to do when the ring is full, drop the new item or overwrite the oldest one
+//! @param prototype Every slot of the ring is initialized as a copy of this, use it to preallocate items
+	FrameRing(size_t capacity, Ring_policy policy, const T& prototype = T()) : capacity_(capacity), 
+				policy_(policy), slots_(new Slot[capacity]), head_(0), tail_(0), pushed_(0), dropped_(0), 
+				overwritten_(0) {
+
+		// With one slot the sequence of a full slot equals the one of the free slot for the next push
+		if(capacity < 2)
+			throw std::invalid_argument("Capacity has to be at least two");
+
+		for(size_t i = 0; i != capacity_; ++i) {
+			slots_[i].sequence.store(i, std::memory_order_relaxed);
+			slots_[i].item = prototype;
+		}
+
+	}
+
+//! Push an item into the ring. The item is swapped with the contents of a free slot, so afterwards
+//! item holds an old (consumed or overwritten) item whose memory can be reused.
+//! @param item Item to push
+//! @return false if the ring was full and the item was dropped (only with Ring_drop_newest)
+	bool push(T& item) {
+
+		size_t pos = head_.load(std::memory_order_relaxed);
+
+		for(;;) {
+			Slot& slot = slots_[pos % capacity_];
+			intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+
+			if(diff == 0) {
+				std::swap(slot.item, item);
+				slot.sequence.store(pos + 1, std::memory_order_release);
+				head_.store(pos + 1, std::memory_order_relaxed);
+				pushed_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+
+			if(policy_ == Ring_drop_newest) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			// Ring is full, take the oldest item away from the consumers. If a consumer has already claimed it
+			// but is still swapping it out, wait for it to finish.
+			size_t oldest = pos - capacity_;
+			if(tail_.load(std::memory_order_relaxed) != oldest) {
+				std::this_thread::yield();
+				continue;
+			}
+			if(tail_.compare_exchange_strong(oldest, oldest + 1, std::memory_order_relaxed)) {
+				slot.sequence.store(pos, std::memory_order_release);
+				overwritten_.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+	}
+
+//! Pop the oldest item from the ring. The item is swapped with the contents of the slot, so the slot
+//! gets the memory item had.
+//! @param item Item to pop into
+//! @return false if the ring was empty
+	bool pop(T& item) {
+
+		size_t pos = tail_.load(std::memory_order_relaxed);
+
+		for(;;) {
+			Slot& slot = slots_[pos % capacity_];
+			intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+
+			if(diff == 0) {
+				if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					std::swap(slot.item, item);
+					slot.sequence.store(pos + capacity_, std::memory_order_release);
+					return true;
+				}
+			}
+			else if(diff < 0)
+				return false;
+			else
+				pos = tail_.load(std::memory_order_relaxed);
+		}
+
+	}
+
+//! @return Amount of items the ring holds
+	size_t capacity() const {
+		return capacity_;
+	}
+
+//! @return Approximate amount of items waiting in the ring
+	size_t size() const {
+		size_t head = head_.load(std::memory_order_relaxed);
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		return head > tail ? head - tail : 0;
+	}
+
+//! @return Amount of items pushed into the ring
+	uint64_t pushed() const {
+		return pushed_.load(std::memory_order_relaxed);
+	}
+
+//! @return Amount of items dropped because the ring was full (Ring_drop_newest)
+	uint64_t dropped() const {
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+//! @return Amount of items overwritten before any consumer got them (Ring_overwrite_oldest)
+	uint64_t overwritten() const {
+		return overwritten_.load(std::memory_order_relaxed);
+	}
+
+private:
+
+	struct Slot {
+		std::atomic<size_t> sequence;
+		T item;
+	};
+
+	const size_t capacity_;
+	const Ring_policy policy_;
+	std::unique_ptr<Slot[]> slots_;
+
+//! Producer and consumer positions on separate cache lines
+	alignas(64) std::atomic<size_t> head_;
+	alignas(64) std::atomic<size_t> tail_;
+
+	alignas(64) std::atomic<uint64_t> pushed_;
+	std::atomic<uint64_t> dropped_;
+	std::atomic<uint64_t> overwritten_;
+
+//! Disable copying and assignment
+	FrameRing(const FrameRing&);
+	void operator=(const FrameRing&);
+
+};
+#endif
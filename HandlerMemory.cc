@@ -0,0 +1,34 @@
+#include <new>
+#include "HandlerMemory.hh"
+
+const size_t HandlerMemory::blocks_;
+const size_t HandlerMemory::block_size_;
+
+HandlerMemory::HandlerMemory() {
+
+	for(size_t i = 0; i != blocks_; ++i)
+		used_[i].store(false, std::memory_order_relaxed);
+
+}
+
+void* HandlerMemory::allocate(size_t size) {
+
+	if(size <= block_size_) {
+		for(size_t i = 0; i != blocks_; ++i)
+			if(!used_[i].load(std::memory_order_relaxed) && !used_[i].exchange(true, std::memory_order_acquire))
+				return storage_[i];
+	}
+	return ::operator new(size);
+
+}
+
+void HandlerMemory::deallocate(void* pointer) {
+
+	for(size_t i = 0; i != blocks_; ++i)
+		if(pointer == storage_[i]) {
+			used_[i].store(false, std::memory_order_release);
+			return;
+		}
+	::operator delete(pointer);
+
+}
@@ -0,0 +1,119 @@
+#ifndef HANDLERMEMORY_HH
+#define HANDLERMEMORY_HH
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <stddef.h>
+
+//! Memory for the handlers of asynchronous operations, reused from one operation to the next so that the
+//! steady state of a link allocates nothing. Blocks of a fixed size are handed out in turn, requests
+//! larger than a block or made while every block is in use fall back to operator new.
+//! allocate() and deallocate() can be called from any thread. The handlers share the ownership of the memory,
+//! so it stays valid for the operations destroyed with their io_service after the owner is gone.
+class HandlerMemory {
+public:
+
+	HandlerMemory();
+
+	void* allocate(size_t size);
+	void deallocate(void* pointer);
+
+private:
+
+	static const size_t blocks_ = 8;
+	static const size_t block_size_ = 512;
+
+	alignas(std::max_align_t) unsigned char storage_[blocks_][block_size_];
+	std::atomic<bool> used_[blocks_];
+
+//! Disable copying and assignment
+	HandlerMemory(const HandlerMemory&);
+	HandlerMemory& operator=(const HandlerMemory&);
+
+};
+
+//! Allocator handing out HandlerMemory, the associated allocator of a Pooled_handler
+template <class T>
+class Handler_allocator {
+public:
+
+	typedef T value_type;
+
+	explicit Handler_allocator(HandlerMemory& memory) : memory_(&memory) {}
+
+	template <class U>
+	Handler_allocator(const Handler_allocator<U>& other) : memory_(other.memory_) {}
+
+	T* allocate(size_t n) {
+		return static_cast<T*>(memory_->allocate(sizeof(T)*n));
+	}
+
+	void deallocate(T* pointer, size_t) {
+		memory_->deallocate(pointer);
+	}
+
+	template <class U>
+	bool operator==(const Handler_allocator<U>& other) const {
+		return memory_ == other.memory_;
+	}
+
+	template <class U>
+	bool operator!=(const Handler_allocator<U>& other) const {
+		return memory_ != other.memory_;
+	}
+
+private:
+
+	template <class U> friend class Handler_allocator;
+	HandlerMemory* memory_;
+
+};
+
+//! Handler whose operations keep their state in a HandlerMemory. boost::asio looks for the memory through the
+//! associated allocator, and through the allocation hooks for handlers wrapped with io_service::strand::wrap().
+template <class Handler>
+class Pooled_handler {
+public:
+
+	typedef Handler_allocator<void> allocator_type;
+
+	template <class H>
+	Pooled_handler(const std::shared_ptr<HandlerMemory>& memory, H&& handler) : memory_(memory), 
+				handler_(std::forward<H>(handler)) {}
+
+	allocator_type get_allocator() const {
+		return allocator_type(*memory_);
+	}
+
+	template <class... Args>
+	void operator()(Args&&... args) {
+		handler_(std::forward<Args>(args)...);
+	}
+
+	friend void* asio_handler_allocate(size_t size, Pooled_handler* handler) {
+		return handler->memory_->allocate(size);
+	}
+
+	friend void asio_handler_deallocate(void* pointer, size_t, Pooled_handler* handler) {
+		handler->memory_->deallocate(pointer);
+	}
+
+private:
+
+	std::shared_ptr<HandlerMemory> memory_;
+	Handler handler_;
+
+};
+
+template <class Handler>
+Pooled_handler<typename std::decay<Handler>::type> makePooledHandler(const std::shared_ptr<HandlerMemory>& memory,
+			Handler&& handler) {
+
+	return Pooled_handler<typename std::decay<Handler>::type>(memory, std::forward<Handler>(handler));
+
+}
+
+#endif
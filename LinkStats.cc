@@ -0,0 +1,240 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <math.h>
+#include <boost/asio/error.hpp>
+#include "LinkStats.hh"
+
+namespace {
+
+//! Print a latency in the unit that fits it
+std::string formatLatency(uint64_t nanoseconds) {
+
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(1);
+	if(nanoseconds < 1000)
+		out << nanoseconds << " ns";
+	else if(nanoseconds < 1000000)
+		out << nanoseconds/1e3 << " us";
+	else if(nanoseconds < 1000000000)
+		out << nanoseconds/1e6 << " ms";
+	else
+		out << nanoseconds/1e9 << " s";
+	return out.str();
+
+}
+
+}
+
+const size_t LatencyHistogram::buckets_;
+
+LatencyHistogram::LatencyHistogram() : counts_(buckets_), count_(0), min_(0), max_(0), sum_(0.0) {
+
+}
+
+size_t LatencyHistogram::bucket(uint64_t nanoseconds) {
+
+	if(nanoseconds < (1u << sub_bits_))
+		return nanoseconds;
+
+	unsigned exponent = 63 - __builtin_clzll(nanoseconds);
+	if(exponent > max_exponent_)
+		return buckets_ - 1;
+	size_t sub = (nanoseconds >> (exponent - sub_bits_)) & ((1u << sub_bits_) - 1);
+	return ((exponent - sub_bits_ + 1) << sub_bits_) + sub;
+
+}
+
+uint64_t LatencyHistogram::upperLimit(size_t bucket) {
+
+	if(bucket < (1u << sub_bits_))
+		return bucket;
+
+	unsigned shift = (bucket >> sub_bits_) - 1;
+	uint64_t sub = bucket & ((1u << sub_bits_) - 1);
+	return (((1ull << sub_bits_) + sub + 1) << shift) - 1;
+
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+
+	++counts_[bucket(nanoseconds)];
+	min_ = count_ == 0 ? nanoseconds : std::min(min_, nanoseconds);
+	max_ = std::max(max_, nanoseconds);
+	sum_ += nanoseconds;
+	++count_;
+
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+
+	if(other.count_ == 0)
+		return;
+	for(size_t i = 0; i != buckets_; ++i)
+		counts_[i] += other.counts_[i];
+	min_ = count_ == 0 ? other.min_ : std::min(min_, other.min_);
+	max_ = std::max(max_, other.max_);
+	sum_ += other.sum_;
+	count_ += other.count_;
+
+}
+
+uint64_t LatencyHistogram::count() const {
+
+	return count_;
+
+}
+
+uint64_t LatencyHistogram::min() const {
+
+	return min_;
+
+}
+
+uint64_t LatencyHistogram::max() const {
+
+	return max_;
+
+}
+
+double LatencyHistogram::mean() const {
+
+	return count_ ? sum_/count_ : 0.0;
+
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+
+	if(count_ == 0)
+		return 0;
+
+	uint64_t target = std::max<uint64_t>(1, ceil(fraction*count_));
+	uint64_t seen = 0;
+	for(size_t i = 0; i != buckets_; ++i) {
+		seen += counts_[i];
+		if(seen >= target)
+			return std::min(upperLimit(i), max_);
+	}
+	return max_;
+
+}
+
+LinkStats::LinkStats() : bytes_in_(0), bytes_out_(0), start_(std::chrono::steady_clock::now()), dumping_(false) {
+
+}
+
+LinkStats::~LinkStats() {
+
+	stopDump();
+
+}
+
+void LinkStats::recordCommand(const std::string& command, uint64_t nanoseconds, const boost::system::error_code& error) {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	Command_statistics& statistics = commands_[command];
+	statistics.latency.record(nanoseconds);
+	if(error == boost::asio::error::timed_out)
+		++statistics.timeouts;
+	else if(error)
+		++statistics.errors;
+
+}
+
+void LinkStats::snapshot(Link_statistics& result) const {
+
+	result.bytes_in = bytes_in_.load(std::memory_order_relaxed);
+	result.bytes_out = bytes_out_.load(std::memory_order_relaxed);
+	result.commands = result.timeouts = result.errors = 0;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+	result.bytes_in_per_second = result.seconds > 0 ? result.bytes_in/result.seconds : 0.0;
+	result.bytes_out_per_second = result.seconds > 0 ? result.bytes_out/result.seconds : 0.0;
+
+	result.per_command.resize(commands_.size());
+	size_t i = 0;
+	for(std::map<std::string, Command_statistics>::const_iterator command = commands_.begin();
+				command != commands_.end(); ++command, ++i) {
+		result.per_command[i] = command->second;
+		result.per_command[i].command = command->first;
+		result.commands += command->second.latency.count();
+		result.timeouts += command->second.timeouts;
+		result.errors += command->second.errors;
+	}
+
+}
+
+void LinkStats::reset() {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	commands_.clear();
+	bytes_in_.store(0, std::memory_order_relaxed);
+	bytes_out_.store(0, std::memory_order_relaxed);
+	start_ = std::chrono::steady_clock::now();
+
+}
+
+void LinkStats::startDump(std::ostream& out, std::chrono::milliseconds interval) {
+
+	stopDump();
+
+	dumping_ = true;
+	dump_thread_ = std::thread([this, &out, interval]() {
+		Link_statistics previous;
+		Link_statistics current;
+		snapshot(previous);
+		std::unique_lock<std::mutex> lock(dump_mutex_);
+		while(!dump_condition_.wait_for(lock, interval, [this]() { return !dumping_; })) {
+			snapshot(current);
+			// A reset in between would give negative rates
+			print(out, current, current.seconds > previous.seconds ? &previous : 0);
+			std::swap(previous, current);
+		}
+	});
+
+}
+
+void LinkStats::stopDump() {
+
+	{
+		std::lock_guard<std::mutex> lock(dump_mutex_);
+		dumping_ = false;
+	}
+	dump_condition_.notify_all();
+	if(dump_thread_.joinable())
+		dump_thread_.join();
+
+}
+
+void LinkStats::print(std::ostream& out, const Link_statistics& statistics, const Link_statistics* previous) {
+
+	double in = statistics.bytes_in_per_second;
+	double out_rate = statistics.bytes_out_per_second;
+	if(previous && statistics.seconds > previous->seconds) {
+		double seconds = statistics.seconds - previous->seconds;
+		in = (statistics.bytes_in - previous->bytes_in)/seconds;
+		out_rate = (statistics.bytes_out - previous->bytes_out)/seconds;
+	}
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1) << "link " << statistics.seconds << " s: in " << in << " B/s, out "
+				<< out_rate << " B/s, " << statistics.commands << " commands, " << statistics.timeouts << " timeouts, "
+				<< statistics.errors << " errors" << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+
+	for(size_t i = 0; i != statistics.per_command.size(); ++i) {
+		const Command_statistics& command = statistics.per_command[i];
+		const LatencyHistogram& latency = command.latency;
+		out << "  " << command.command << ": " << latency.count() << " x, p50 " << formatLatency(latency.percentile(0.5))
+					<< ", p99 " << formatLatency(latency.percentile(0.99)) << ", max " << formatLatency(latency.max());
+		if(command.timeouts || command.errors)
+			out << ", " << command.timeouts << " timeouts, " << command.errors << " errors";
+		out << std::endl;
+	}
+
+}
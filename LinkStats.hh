@@ -0,0 +1,152 @@
+#ifndef LINKSTATS_HH
+#define LINKSTATS_HH
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <condition_variable>
+#include <stdint.h>
+#include <boost/system/error_code.hpp>
+
+//! Histogram of latencies in nanoseconds with HDR style log-linear buckets: every power of two is split into
+//! 16 buckets, so a value is known with 1/16 (6%) precision over the whole range. Latencies up to 2^48 ns
+//! (78 hours) are kept, longer ones are counted in the last bucket.
+class LatencyHistogram {
+public:
+
+	LatencyHistogram();
+
+	void record(uint64_t nanoseconds);
+
+//! Add the values of another histogram
+	void merge(const LatencyHistogram& other);
+
+//! @return Amount of values recorded
+	uint64_t count() const;
+
+	uint64_t min() const;
+	uint64_t max() const;
+	double mean() const;
+
+//! @param fraction 0.5 for the median, 0.99 for the 99th percentile
+//! @return Upper limit of the bucket containing the percentile, 0 if the histogram is empty
+	uint64_t percentile(double fraction) const;
+
+private:
+
+	static const unsigned sub_bits_ = 4;
+	static const unsigned max_exponent_ = 47;
+	static const size_t buckets_ = (1 << sub_bits_)*(max_exponent_ - sub_bits_ + 2);
+
+	static size_t bucket(uint64_t nanoseconds);
+	static uint64_t upperLimit(size_t bucket);
+
+	std::vector<uint64_t> counts_;
+	uint64_t count_;
+	uint64_t min_;
+	uint64_t max_;
+	double sum_;
+
+};
+
+//! Statistics of one SCPI command (the command header, arguments left out)
+struct Command_statistics {
+
+	std::string command;
+//! Time from starting to send the command to receiving the end of its response
+	LatencyHistogram latency;
+	uint64_t timeouts;
+	uint64_t errors;
+
+	Command_statistics() : timeouts(0), errors(0) {}
+
+};
+
+//! Snapshot of LinkStats
+struct Link_statistics {
+
+//! Time the statistics were collected over, since they were created or reset
+	double seconds;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+//! Average rates over seconds
+	double bytes_in_per_second;
+	double bytes_out_per_second;
+	uint64_t commands;
+	uint64_t timeouts;
+	uint64_t errors;
+//! Commands in alphabetical order
+	std::vector<Command_statistics> per_command;
+
+	Link_statistics() : seconds(0.0), bytes_in(0), bytes_out(0), bytes_in_per_second(0.0), bytes_out_per_second(0.0),
+				commands(0), timeouts(0), errors(0) {}
+
+};
+
+//! Collects statistics of the link to a scope: the latency of every command, bytes moved and timeouts and errors.
+//! Byte counts are relaxed atomics, the command statistics are updated under a mutex once per command.
+//! Recording can be done from any thread, usually the io_service of the scope.
+class LinkStats {
+public:
+
+	LinkStats();
+
+//! Stops the periodic dump
+	~LinkStats();
+
+	void addBytesIn(size_t bytes) {
+		bytes_in_.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	void addBytesOut(size_t bytes) {
+		bytes_out_.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+//! Record a completed command
+//! @param command Command header
+//! @param nanoseconds Latency of the command
+//! @param error Error the command completed with, boost::asio::error::timed_out counts as a timeout
+	void recordCommand(const std::string& command, uint64_t nanoseconds, const boost::system::error_code& error);
+
+//! @param result Statistics collected so far, the memory is reused if it is big enough
+	void snapshot(Link_statistics& result) const;
+
+//! Forget the statistics collected so far
+	void reset();
+
+//! Print the statistics to out every interval from a thread of the LinkStats, replaces a running dump.
+//! The rates printed are over the interval.
+//! \note{out has to stay valid until the dump is stopped}
+	void startDump(std::ostream& out, std::chrono::milliseconds interval);
+	void stopDump();
+
+//! Print statistics, one line for the link and one for every command
+//! @param previous Statistics of the last print, the rates are computed over the time since it if given
+	static void print(std::ostream& out, const Link_statistics& statistics, const Link_statistics* previous = 0);
+
+private:
+
+	std::atomic<uint64_t> bytes_in_;
+	std::atomic<uint64_t> bytes_out_;
+
+	mutable std::mutex mutex_;
+	std::map<std::string, Command_statistics> commands_;
+	std::chrono::steady_clock::time_point start_;
+
+	std::thread dump_thread_;
+	std::mutex dump_mutex_;
+	std::condition_variable dump_condition_;
+	bool dumping_;
+
+//! Disable copying and assignment
+	LinkStats(const LinkStats&);
+	void operator=(const LinkStats&);
+
+};
+
+#endif
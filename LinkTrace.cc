@@ -0,0 +1,153 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string.h>
+#include "LinkTrace.hh"
+
+using namespace trace;
+
+namespace {
+
+const char file_magic[8] = {'R', 'G', 'L', 'T', 'R', 'C', '0', '1'};
+const uint32_t version = 1;
+
+static_assert(sizeof(File_header) == 24, "Trace file structures have to be packed");
+
+//! @return false if the varint does not fit before end
+bool readVarint(const uint8_t*& position, const uint8_t* end, uint64_t& value) {
+
+	value = 0;
+	for(unsigned shift = 0; position != end && shift < 64; shift += 7) {
+		uint8_t byte = *position++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if(!(byte & 0x80))
+			return true;
+	}
+	return false;
+
+}
+
+}
+
+TraceRecorder::TraceRecorder(const std::string& path) : file_(path.c_str(), std::ios::binary | std::ios::trunc),
+			path_(path), last_(std::chrono::steady_clock::now()), records_(0) {
+
+	if(!file_)
+		throw std::runtime_error("Could not create trace file " + path);
+
+	File_header header = {};
+	memcpy(header.magic, file_magic, sizeof(header.magic));
+	header.version = version;
+	header.start = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+	file_.write((const char*)&header, sizeof(header));
+
+}
+
+void TraceRecorder::record(Trace_direction direction, const void* data, size_t size) {
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	file_.put(direction);
+	writeVarint(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count());
+	writeVarint(size);
+	file_.write((const char*)data, size);
+	last_ = now;
+	++records_;
+
+}
+
+void TraceRecorder::flush() {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	file_.flush();
+	if(!file_)
+		throw std::runtime_error("Could not write trace file " + path_);
+
+}
+
+size_t TraceRecorder::size() const {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	return records_;
+
+}
+
+void TraceRecorder::writeVarint(uint64_t value) {
+
+	while(value >= 0x80) {
+		file_.put((char)(value | 0x80));
+		value >>= 7;
+	}
+	file_.put((char)value);
+
+}
+
+TraceReader::TraceReader(const std::string& path) {
+
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if(!file)
+		throw std::runtime_error("Could not open trace file " + path);
+	std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	File_header header;
+	if(contents.size() < sizeof(header))
+		throw std::runtime_error(path + " is not a trace file");
+	memcpy(&header, contents.data(), sizeof(header));
+	if(memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 || header.version != version)
+		throw std::runtime_error(path + " is not a trace file");
+	start_ = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+				std::chrono::nanoseconds(header.start)));
+
+	// The data of the records is moved to the front of the buffer, leaving out the headers
+	data_.swap(contents);
+	const uint8_t* position = data_.data() + sizeof(header);
+	const uint8_t* end = data_.data() + data_.size();
+	size_t offset = 0;
+	int64_t time = 0;
+	while(position != end) {
+		uint8_t direction = *position++;
+		uint64_t delay;
+		uint64_t size;
+		if(!readVarint(position, end, delay) || !readVarint(position, end, size) || size > (uint64_t)(end - position))
+			break;
+		if(direction != Trace_write && direction != Trace_read)
+			throw std::runtime_error(path + " has a corrupt record");
+
+		time += delay;
+		Trace_record record = {(Trace_direction)direction, time, offset, (size_t)size};
+		records_.push_back(record);
+		memmove(data_.data() + offset, position, size);
+		offset += size;
+		position += size;
+	}
+	data_.resize(offset);
+
+}
+
+size_t TraceReader::size() const {
+
+	return records_.size();
+
+}
+
+const Trace_record& TraceReader::operator[](size_t index) const {
+
+	return records_[index];
+
+}
+
+const uint8_t* TraceReader::data(const Trace_record& record) const {
+
+	return data_.data() + record.offset;
+
+}
+
+std::chrono::system_clock::time_point TraceReader::start() const {
+
+	return start_;
+
+}
@@ -0,0 +1,105 @@
+#ifndef LINKTRACE_HH
+#define LINKTRACE_HH
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Traces record the traffic with a scope, for replaying it with a ReplayTransport. Layout of a file:
+//!   File header
+//!   Records: direction (1 byte), nanoseconds since the previous record and the amount of data as
+//!   unsigned LEB128 varints, and the data
+//! A record is a single write or read completion, so a replay delivers the data in the chunks it came in.
+
+namespace trace {
+
+struct File_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+//! Nanoseconds since the epoch of std::chrono::system_clock when recording started
+	int64_t start;
+};
+
+}
+
+enum Trace_direction {Trace_write = 1, Trace_read = 2};
+
+//! Record in a trace
+struct Trace_record {
+
+	Trace_direction direction;
+//! Nanoseconds since the start of the recording
+	int64_t time;
+//! Location of the data in TraceReader::data()
+	size_t offset;
+	size_t size;
+
+};
+
+//! Writes a trace file
+class TraceRecorder {
+public:
+
+//! Create a trace file, an existing file is overwritten
+//! \note{Throws std::runtime_error if the file can not be created}
+	explicit TraceRecorder(const std::string& path);
+
+//! Append a record timestamped now, can be called from any thread
+	void record(Trace_direction direction, const void* data, size_t size);
+
+//! Write the buffered records to the file
+//! \note{Throws std::runtime_error on write errors}
+	void flush();
+
+//! @return Amount of records written
+	size_t size() const;
+
+private:
+
+	mutable std::mutex mutex_;
+	std::ofstream file_;
+	std::string path_;
+	std::chrono::steady_clock::time_point last_;
+	size_t records_;
+
+	void writeVarint(uint64_t value);
+
+//! Disable copying and assignment
+	TraceRecorder(const TraceRecorder&);
+	TraceRecorder& operator=(const TraceRecorder&);
+
+};
+
+//! Reads a whole trace file into memory
+class TraceReader {
+public:
+
+//! \note{Throws std::runtime_error if the file can not be read or is not a trace. A record cut short at the end
+//! of the file (a crashed recording) is left out.}
+	explicit TraceReader(const std::string& path);
+
+//! @return Amount of records
+	size_t size() const;
+
+	const Trace_record& operator[](size_t index) const;
+
+//! @return Data of a record
+	const uint8_t* data(const Trace_record& record) const;
+
+//! @return When recording started
+	std::chrono::system_clock::time_point start() const;
+
+private:
+
+	std::vector<Trace_record> records_;
+	std::vector<uint8_t> data_;
+	std::chrono::system_clock::time_point start_;
+
+};
+
+#endif
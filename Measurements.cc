@@ -0,0 +1,262 @@
+#include <vector>
+#include <limits>
+#include <math.h>
+#include "Measurements.hh"
+
+namespace {
+
+//! Fraction of the samples of a half of the histogram its mode (with the neighbouring values) needs
+//! for being taken as a flat top or base
+const float flat_fraction = 0.3f;
+//! Edges are not searched if top and base are closer than this many raw steps
+const int min_edge_amplitude = 3;
+
+//! Most common raw value in [first, last], or first if it is not common enough to be flat
+int flatLevel(const uint32_t* histogram, int first, int last) {
+
+	uint32_t total = 0;
+	int mode = first;
+	for(int i = first; i <= last; ++i) {
+		total += histogram[i];
+		if(histogram[i] > histogram[mode])
+			mode = i;
+	}
+
+	uint32_t around = histogram[mode];
+	if(mode > first)
+		around += histogram[mode - 1];
+	if(mode < last)
+		around += histogram[mode + 1];
+	return around >= flat_fraction*total ? mode : first;
+
+}
+
+//! Rising and falling edges found so far, times are in samples
+struct Edges {
+
+	size_t rising;
+	size_t falling;
+	double first_rise;
+	double last_rise;
+	double first_fall;
+	double last_fall;
+	double rise_time;
+	double fall_time;
+	double positive_width;
+	size_t positive_widths;
+	double negative_width;
+	size_t negative_widths;
+
+};
+
+//! Find the edges of samples going between the low and high levels in volts, the samples are converted with
+//! scaler on the fly
+void findEdges(const uint8_t* samples, size_t count, const SampleScaler& scaler, float low, float middle, float high,
+			Edges& edges) {
+
+	// 0 until the signal has been below low or above high, then -1 below low and 1 above high
+	int state = 0;
+	// Where the edge in progress left low or high, and where it crossed the middle
+	double leave = 0.0;
+	double cross = 0.0;
+
+	// Raw values at or below low and at or above high, for skipping the flat parts without converting. They come
+	// from the table, so the skipping agrees with the converted values. Bigger raw value is a smaller voltage.
+	int below = 256;
+	while(below > 0 && scaler(below - 1) <= low)
+		--below;
+	int above = -1;
+	while(above < 255 && scaler(above + 1) >= high)
+		++above;
+
+	for(size_t i = 1; i < count; ++i) {
+		if(state < 0) {
+			while(i < count && samples[i] >= below && samples[i - 1] >= below)
+				++i;
+		}
+		else if(state > 0) {
+			while(i < count && samples[i] <= above && samples[i - 1] <= above)
+				++i;
+		}
+		if(i == count)
+			break;
+
+		float previous = scaler(samples[i - 1]);
+		float value = scaler(samples[i]);
+		if(state < 0) {
+			if(previous <= low && value > low)
+				leave = i - 1 + (low - previous)/(value - previous);
+			if(previous < middle && value >= middle)
+				cross = i - 1 + (middle - previous)/(value - previous);
+			if(value >= high) {
+				double arrive = i - 1 + (high - previous)/(value - previous);
+				edges.rise_time += arrive - leave;
+				if(edges.falling != 0) {
+					edges.negative_width += cross - edges.last_fall;
+					++edges.negative_widths;
+				}
+				if(edges.rising++ == 0)
+					edges.first_rise = cross;
+				edges.last_rise = cross;
+				state = 1;
+			}
+		}
+		else if(state > 0) {
+			if(previous >= high && value < high)
+				leave = i - 1 + (previous - high)/(previous - value);
+			if(previous > middle && value <= middle)
+				cross = i - 1 + (previous - middle)/(previous - value);
+			if(value <= low) {
+				double arrive = i - 1 + (previous - low)/(previous - value);
+				edges.fall_time += arrive - leave;
+				if(edges.rising != 0) {
+					edges.positive_width += cross - edges.last_rise;
+					++edges.positive_widths;
+				}
+				if(edges.falling++ == 0)
+					edges.first_fall = cross;
+				edges.last_fall = cross;
+				state = -1;
+			}
+		}
+		else if(value <= low)
+			state = -1;
+		else if(value >= high)
+			state = 1;
+	}
+
+}
+
+}
+
+void MeasurementEngine::measure(const Waveform_frame& frame, Waveform_measurements& result) {
+
+	measure(frame.samples.data(), frame.samples.size(), frame.volt_offset, frame.volt_scale, frame.sample_interval,
+				result);
+
+}
+
+Waveform_measurements MeasurementEngine::measure(const Waveform_frame& frame) {
+
+	Waveform_measurements result;
+	measure(frame, result);
+	return result;
+
+}
+
+void MeasurementEngine::measure(const uint8_t* samples, size_t count, float volt_offset, float volt_scale,
+			float sample_interval, Waveform_measurements& result) {
+
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	result = Waveform_measurements();
+	result.max = result.min = result.peak_to_peak = result.top = result.base = result.amplitude = nan;
+	result.average = result.rms = result.frequency = result.period = result.rise_time = result.fall_time = nan;
+	result.positive_width = result.negative_width = result.duty_cycle = nan;
+	if(count == 0)
+		return;
+
+	// Four histograms so that consecutive equal samples do not wait for each other's increments
+	uint32_t partial[4][256] = {};
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		++partial[0][samples[i]];
+		++partial[1][samples[i + 1]];
+		++partial[2][samples[i + 2]];
+		++partial[3][samples[i + 3]];
+	}
+	for(; i != count; ++i)
+		++partial[0][samples[i]];
+
+	uint32_t histogram[256];
+	for(int value = 0; value != 256; ++value)
+		histogram[value] = partial[0][value] + partial[1][value] + partial[2][value] + partial[3][value];
+
+	scaler_.configure(volt_offset, volt_scale);
+
+	// Bigger raw value is a smaller voltage
+	int highest = 0;
+	while(histogram[highest] == 0)
+		++highest;
+	int lowest = 255;
+	while(histogram[lowest] == 0)
+		--lowest;
+
+	double sum = 0.0;
+	double squares = 0.0;
+	for(int value = highest; value <= lowest; ++value) {
+		double volts = scaler_(value);
+		sum += histogram[value]*volts;
+		squares += histogram[value]*volts*volts;
+	}
+
+	int middle = (highest + lowest)/2;
+	int top = flatLevel(histogram, highest, middle);
+	int base = lowest;
+	if(lowest > middle) {
+		// The mode of the lower half is searched from the bottom up
+		uint32_t reversed[256];
+		for(int value = middle + 1; value <= lowest; ++value)
+			reversed[lowest - value] = histogram[value];
+		base = lowest - flatLevel(reversed, 0, lowest - middle - 1);
+	}
+
+	result.max = scaler_(highest);
+	result.min = scaler_(lowest);
+	result.peak_to_peak = result.max - result.min;
+	result.top = scaler_(top);
+	result.base = scaler_(base);
+	result.amplitude = result.top - result.base;
+	result.average = sum/count;
+	result.rms = sqrt(squares/count);
+
+	// The levels of the edges are voltages, a channel without a volt scale has none
+	if(base - top < min_edge_amplitude || !(result.amplitude > 0))
+		return;
+
+	float amplitude = result.amplitude;
+	Edges edges = Edges();
+	findEdges(samples, count, scaler_, result.base + 0.1f*amplitude, result.base + 0.5f*amplitude,
+				result.base + 0.9f*amplitude, edges);
+	result.rising_edges = edges.rising;
+	result.falling_edges = edges.falling;
+	if(sample_interval <= 0.0f)
+		return;
+
+	if(edges.rising != 0)
+		result.rise_time = edges.rise_time/edges.rising*sample_interval;
+	if(edges.falling != 0)
+		result.fall_time = edges.fall_time/edges.falling*sample_interval;
+	if(edges.positive_widths != 0)
+		result.positive_width = edges.positive_width/edges.positive_widths*sample_interval;
+	if(edges.negative_widths != 0)
+		result.negative_width = edges.negative_width/edges.negative_widths*sample_interval;
+
+	if(edges.rising >= 2)
+		result.period = (edges.last_rise - edges.first_rise)/(edges.rising - 1)*sample_interval;
+	else if(edges.falling >= 2)
+		result.period = (edges.last_fall - edges.first_fall)/(edges.falling - 1)*sample_interval;
+	else if(edges.positive_widths != 0 && edges.negative_widths != 0)
+		result.period = result.positive_width + result.negative_width;
+	if(!isnan(result.period)) {
+		result.frequency = 1/result.period;
+		if(!isnan(result.positive_width))
+			result.duty_cycle = result.positive_width/result.period;
+		else if(!isnan(result.negative_width))
+			result.duty_cycle = 1 - result.negative_width/result.period;
+	}
+
+}
+
+void MeasurementEngine::measure(const Waveform_frame* frames, size_t count, Waveform_measurements* results) {
+
+	for(size_t i = 0; i != count; ++i)
+		measure(frames[i], results[i]);
+
+}
+
+void MeasurementEngine::measure(const std::vector<Waveform_frame>& frames, std::vector<Waveform_measurements>& results) {
+
+	results.resize(frames.size());
+	measure(frames.data(), frames.size(), results.data());
+
+}
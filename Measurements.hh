@@ -0,0 +1,84 @@
+#ifndef MEASUREMENTS_HH
+#define MEASUREMENTS_HH
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "WaveformFrame.hh"
+#include "SampleScaler.hh"
+
+//! Measurements of a frame, the same set the scope shows with :MEASURE. Voltages are in volts, times in seconds.
+//! Values that can not be measured from the frame (timing of a frame without two edges for example) are NaN.
+struct Waveform_measurements {
+
+	float max;
+	float min;
+	float peak_to_peak;
+//! Flat top and base of the signal, the max and min if the signal has no flat parts
+	float top;
+	float base;
+	float amplitude;
+	float average;
+	float rms;
+	float frequency;
+	float period;
+//! Average time from 10% to 90% of the amplitude over all the rising edges
+	float rise_time;
+//! Average time from 90% to 10% of the amplitude over all the falling edges
+	float fall_time;
+//! Average time between a rising and the next falling edge at 50% of the amplitude
+	float positive_width;
+	float negative_width;
+//! Positive width as a fraction of the period
+	float duty_cycle;
+	size_t rising_edges;
+	size_t falling_edges;
+
+};
+
+//! Computes the measurements from the raw samples on the host instead of querying them from the scope one by one.
+//! The amplitude measurements come from a histogram of the raw samples, so there is no conversion per sample,
+//! the edges are found in a second pass over the raw samples with hysteresis between the 10% and 90% levels
+//! and interpolated between samples. Timing needs a positive volt scale, it is NaN without.
+//! The engine keeps the lookup table of the last channel settings, reuse it for a stream of frames.
+class MeasurementEngine {
+public:
+
+//! Measure a frame
+//! @param frame Frame to measure, its settings are used for scaling
+//! @param result Measurements of the frame
+	void measure(const Waveform_frame& frame, Waveform_measurements& result);
+
+//! Measure a frame
+//! @param frame Frame to measure, its settings are used for scaling
+//! @return Measurements of the frame
+	Waveform_measurements measure(const Waveform_frame& frame);
+
+//! Measure raw samples, for frames mapped from a capture file for example
+//! @param samples Raw samples
+//! @param count Amount of samples
+//! @param volt_offset Voltage offset of the channel the samples are from
+//! @param volt_scale v/div of the channel the samples are from
+//! @param sample_interval Time between two samples in seconds
+//! @param result Measurements of the samples
+	void measure(const uint8_t* samples, size_t count, float volt_offset, float volt_scale, float sample_interval,
+				Waveform_measurements& result);
+
+//! Measure many frames
+//! @param frames Frames to measure
+//! @param count Amount of frames
+//! @param results Output buffer, has to have room for count measurements
+	void measure(const Waveform_frame* frames, size_t count, Waveform_measurements* results);
+
+//! Measure many frames
+//! @param frames Frames to measure
+//! @param results Measurements of each frame, the memory is reused if it is big enough
+	void measure(const std::vector<Waveform_frame>& frames, std::vector<Waveform_measurements>& results);
+
+private:
+
+	SampleScaler scaler_;
+
+};
+
+#endif
@@ -3,147 +3,130 @@
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <math.h>
 #include <map>
+#include <algorithm>
 #include <stdio.h>
 #include <pthread.h>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include "RigolScope.hh"
+#include "ScpiNumber.hh"
 
-template <class T>
-inline std::string convertToString(const T& t) {
+const size_t RigolScope::chunk_size_;
 
-	std::stringstream ss;
-	ss << t;
-	return ss.str();
+RigolScope::RigolScope(std::string device, Baud_rate rate) : RigolScope(std::unique_ptr<boost::asio::io_service>(
+				new boost::asio::io_service()), 0, device, rate) {
 
 }
 
-inline float convertToFloat(std::string const& s) {
-
-	std::istringstream i(s);
-	float x;
-	if (!(i >> x))
-		throw std::out_of_range("");
-	return x;
+RigolScope::RigolScope(boost::asio::io_service& io, std::string device, Baud_rate rate) : 
+				RigolScope(std::unique_ptr<boost::asio::io_service>(), &io, device, rate) {
 
 }
 
-inline size_t convertToSizeT(std::string const& s) {
+RigolScope::RigolScope(std::unique_ptr<boost::asio::io_service> own_io, boost::asio::io_service* io, 
+				const std::string& device, Baud_rate rate) : own_io_(std::move(own_io)), io_(io ? *io : *own_io_), 
+				strand_(io_), transport_(openTransport(io_, device, rate)), stream_(io_, *transport_), timer_(io_), 
+				handler_memory_(std::make_shared<HandlerMemory>()), timeout_(boost::posix_time::seconds(2)), 
+				timed_out_(false), operation_id_(0), jobs_(16), job_running_(false), address_(device), 
+				serial_rate_(rate), hardware_flow_(false), statistics_enabled_(false), command_open_(false), 
+				streaming_(false), streaming_timeouts_(0) {
 
-	std::istringstream i(s);
-	size_t x;
-	if (!(i >> x))
-		throw std::out_of_range("");
-	return x;
+	send_buffer_.reserve(256);
+	response_.reserve(256);
+	info_ = getInfo();
 
 }
 
-inline double convertToDouble(std::string const& s) {
+RigolScope::~RigolScope() {
 
-	std::istringstream i(s);
-	double x;
-	if (!(i >> x))
-		throw std::out_of_range("");
-	return x;
+	if(streaming_thread_.joinable()) {
+		streaming_ = false;
+		streaming_thread_.join();
+	}
+	transport_->close();
 
 }
 
-RigolScope::RigolScope(std::string device, Baud_rate rate) : io_(), port_(io_), timer_(io_), 
-				timeout_(boost::posix_time::seconds(2)), address_(device) {
-
-	channel_string_[CH1] = "CHAN1";
-	channel_string_[CH2] = "CHAN2";
+std::string RigolScope::getInfo() {
 
-	trigger_mode_string_[Edge] = "EDGE";
-	trigger_mode_string_[Pulse] = "PULSE";
-	trigger_mode_string_[Video] = "VIDEO";
-	trigger_mode_string_[Slope] = "SLOPE";
-	trigger_mode_string_[Pattern] = "PATTERN";
-	trigger_mode_string_[Duration] = "DURATION";
-	trigger_mode_string_[Alternation] = "ALTERNATION";
+	return std::string(query("*IDN?"));
 
-	trigger_source_string_[Source_CH1] = "CH1";
-	trigger_source_string_[Source_CH2] = "CH2";
-	trigger_source_string_[Source_Ext] = "EXT";
-	trigger_source_string_[Source_Acline] = "ACLINE";
+}
 
-	trigger_sweep_string_[Sweep_auto] = "AUTO";
-	trigger_sweep_string_[Sweep_normal] = "NORMAL";
-	trigger_sweep_string_[Sweep_single] = "SINGLE";
+void RigolScope::reset() {
 
-	trigger_coupling_string_[Trig_DC] = "DC";
-	trigger_coupling_string_[Trig_AC] = "AC";
-	trigger_coupling_string_[Trig_HF] = "HF";
-	trigger_coupling_string_[Trig_LF] = "LF";
+	write("*RST");
+	invalidateSettings();
 
-	trigger_status_string_[Run] = "RUN";
-	trigger_status_string_[Stop] = "STOP";
-	trigger_status_string_[Triggered] = "T'D";
-	trigger_status_string_[Wait] = "WAIT";
-	trigger_status_string_[Auto] = "AUTO";
+}
 
-	port_.open(address_);
-	configureSerial(rate);
+void RigolScope::invalidateSettings() {
 
-	if(port_.is_open()) {
-		info_ = getInfo();
+	for(size_t i = 0; i != 2; ++i) {
+		volt_scale_[i].valid = false;
+		volt_offset_[i].valid = false;
+		attenuation_[i].valid = false;
 	}
-	else
-		throw std::invalid_argument("Device does not exist");
+	timescale_.valid = false;
+	time_offset_.valid = false;
+	normal_points_mode_.valid = false;
 
 }
 
-RigolScope::~RigolScope() {
+void RigolScope::setRun(bool val) {
 
-	port_.close();
+	if(val)
+		write(":RUN");
+	else
+		write(":STOP");
 
 }
 
-std::string RigolScope::getInfo() {
+std::vector<float> RigolScope::getData(Channel chan) {
 
-	write("*IDN?");
-	return read();
+	std::vector<float> data;
+	getData(chan, data);
+	return data;
 
 }
 
-void RigolScope::reset() {
+void RigolScope::getData(Channel chan, std::vector<float>& data) {
 
-	write("*RST");
+	getRawData(chan, frame_);
+	formatData(frame_.samples, frame_.volt_offset, frame_.volt_scale, data);
 
 }
 
-void RigolScope::setRun(bool val) {
+void RigolScope::getRawData(Channel chan, Waveform_frame& frame) {
 
-	if(val)
-		write(":RUN");
-	else
-		write(":STOP");
+	runSync([this, chan, &frame](const Completion& done) {
+		startRawData(chan, &frame, done);
+	});
 
 }
 
-std::vector<float> RigolScope::getData(Channel chan) {
+boost::asio::io_service& RigolScope::getIoService() {
 
-	write(":WAV:POIN:MODE NOR");
-	write((":WAV:DATA? CHAN" + convertToString(chan)));
-	std::string raw_data = read();
-	return formatData(raw_data, getVoltOffset(chan), getVoltScale(chan));
+	return io_;
 
 }
 
 float RigolScope::getVoltScale(Channel chan) {
 
-	write(":CHAN" + convertToString(chan) + ":SCAL?");
-	return convertToFloat(read());
+	float scale = scpiToFloat(query(ScpiCommand(":CHAN", chan, ":SCAL?")));
+	volt_scale_[chan - 1].set(scale);
+	return scale;
 
 }
 
 void RigolScope::setVoltScale(Channel chan, float scale) {
 
-	if(scale >= 0.002 && scale <= 9000.0)
-		write(":CHAN" + convertToString(chan) + ":SCAL " + convertToString(scale));
+	if(scale >= 0.002 && scale <= 9000.0) {
+		write(ScpiCommand(":CHAN", chan, ":SCAL ", scale));
+		volt_scale_[chan - 1].valid = false;
+	}
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -151,15 +134,18 @@ void RigolScope::setVoltScale(Channel chan, float scale) {
 
 float RigolScope::getVoltOffset(Channel chan) {
 
-	write(":CHAN" + convertToString(chan) + ":OFFS?");
-	return convertToFloat(read());
+	float offset = scpiToFloat(query(ScpiCommand(":CHAN", chan, ":OFFS?")));
+	volt_offset_[chan - 1].set(offset);
+	return offset;
 
 }
 
 void RigolScope::setVoltOffset(Channel chan, float scale) {
 
-	if(scale >= -40000.0 && scale <= 40000.0)
-		write(":CHAN" + convertToString(chan) + ":OFFS " + convertToString(scale));
+	if(scale >= -40000.0 && scale <= 40000.0) {
+		write(ScpiCommand(":CHAN", chan, ":OFFS ", scale));
+		volt_offset_[chan - 1].valid = false;
+	}
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -167,15 +153,18 @@ void RigolScope::setVoltOffset(Channel chan, float scale) {
 
 float RigolScope::getTimescale() {
 
-	write(":TIM:SCAL?");
-	return convertToFloat(read());
+	float timescale = scpiToFloat(query(":TIM:SCAL?"));
+	timescale_.set(timescale);
+	return timescale;
 
 }
 
 void RigolScope::setTimescale(float timescale) {
 
-	if(timescale >= 0.000000002 && timescale <= 50.0)
-		write(":TIM:SCAL " + convertToString(timescale));
+	if(timescale >= 0.000000002 && timescale <= 50.0) {
+		write(ScpiCommand(":TIM:SCAL ", timescale));
+		timescale_.valid = false;
+	}
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -183,15 +172,18 @@ void RigolScope::setTimescale(float timescale) {
 
 float RigolScope::getTimeOffset() {
 
-	write(":TIM:OFFS?");
-	return convertToFloat(read());
+	float time_offset = scpiToFloat(query(":TIM:OFFS?"));
+	time_offset_.set(time_offset);
+	return time_offset;
 
 }
 
 void RigolScope::setTimeOffset(float time_offset) {
 
-	if(time_offset >= -300.0 && time_offset <= 300.0)
-		write(":TIM:OFFS " + convertToString(time_offset));
+	if(time_offset >= -300.0 && time_offset <= 300.0) {
+		write(ScpiCommand(":TIM:OFFS ", time_offset));
+		time_offset_.valid = false;
+	}
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -199,22 +191,27 @@ void RigolScope::setTimeOffset(float time_offset) {
 
 size_t RigolScope::getMemDepth(Channel chan) {
 
-	write(":CHAN" + convertToString(chan) + ":MEMD?");
-	return convertToSizeT(read());
+	return scpiToSizeT(query(ScpiCommand(":CHAN", chan, ":MEMD?")));
 
 }
 
 int RigolScope::getAttenuation(Channel chan) {
 
-	write(":CHAN" + convertToString(chan) + ":PROBE?");
-	return convertExponent(read(), 0);
+	int attenuation = lround(scpiToFloat(query(ScpiCommand(":CHAN", chan, ":PROBE?"))));
+	attenuation_[chan - 1].set(attenuation);
+	return attenuation;
 	
 }
 
 void RigolScope::setAttenuation(Channel chan, int attenuation) {
 
-	if(attenuation >= 1 && attenuation <= 1000)
-		write(":CHAN" + convertToString(chan) + ":PROBE " + convertToString(attenuation));
+	if(attenuation >= 1 && attenuation <= 1000) {
+		write(ScpiCommand(":CHAN", chan, ":PROBE ", attenuation));
+		// v/div and offset are reported as seen through the probe
+		attenuation_[chan - 1].valid = false;
+		volt_scale_[chan - 1].valid = false;
+		volt_offset_[chan - 1].valid = false;
+	}
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -222,15 +219,14 @@ void RigolScope::setAttenuation(Channel chan, int attenuation) {
 
 std::string RigolScope::getCoupling(Channel chan) {
 
-	write(":CHAN" + convertToString(chan) + ":COUPLING?");
-	return read();
+	return std::string(query(ScpiCommand(":CHAN", chan, ":COUPLING?")));
 	
 }
 
 void RigolScope::setCoupling(Channel chan, std::string coupling) {
 
 	if(coupling == "AC" || coupling == "DC" || coupling == "GND")
-		write(":CHAN" + convertToString(chan) + ":PROBE " + coupling);
+		write(ScpiCommand(":CHAN", chan, ":PROBE ", coupling));
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -254,13 +250,13 @@ void RigolScope::setTriggerForce() {
 void RigolScope::setAuto() {
 
 	write(":AUTO");
+	invalidateSettings();
 
 }
 
 bool RigolScope::getChannelEnable(Channel chan) {
 
-	write(":CHAN" + convertToString(chan) + ":DISP?");
-	if(read() == "ON")
+	if(query(ScpiCommand(":CHAN", chan, ":DISP?")) == "ON")
 		return true;
 	else
 		return false;
@@ -270,9 +266,9 @@ bool RigolScope::getChannelEnable(Channel chan) {
 void RigolScope::setChannelEnable(Channel chan, bool val) {
 
 	if(val == true)
-		write(":CHAN" + convertToString(chan) + ":DISP ON");
+		write(ScpiCommand(":CHAN", chan, ":DISP ON"));
 	else
-		write(":CHAN" + convertToString(chan) + ":DISP OFF");	
+		write(ScpiCommand(":CHAN", chan, ":DISP OFF"));	
 
 }
 
@@ -287,9 +283,7 @@ void RigolScope::setFreqCounter(bool val) {
 
 bool RigolScope::getFreqCounterEnable() {
 
-	write(":COUNter:ENABle?");
-	
-	if(read() == "ON")
+	if(query(":COUNter:ENABle?") == "ON")
 		return true;
 	else
 		return false;
@@ -298,17 +292,14 @@ bool RigolScope::getFreqCounterEnable() {
 
 float RigolScope::getFreqCounterValue() {
 
-	write(":COUNter:VALue?");
-	return convertExponent(read(), 5);
+	return scpiToFloat(query(":COUNter:VALue?"));
 
 }
 
 Trigger_mode RigolScope::getTriggerMode() {
 
-	write(":TRIG:MODE?");
-
 	try {
-		return (Trigger_mode)trigger_mode_string_[read()];
+		return stringEnum<Trigger_mode>(query(":TRIG:MODE?"));
 	}
 	catch(std::out_of_range) {
 		throw std::out_of_range("Scope returned something unexpected");
@@ -326,7 +317,7 @@ void RigolScope::setTriggerMode(Trigger_mode mode) {
 		case Pattern:
 		case Duration:
 		case Alternation:
-			write(":TRIG:MODE " + trigger_mode_string_[mode]);
+			write(ScpiCommand(":TRIG:MODE ", enumString(mode)));
 			break;
 		default:
 			throw std::out_of_range("Value out of range");
@@ -343,8 +334,7 @@ Trigger_source RigolScope::getTriggerSource(Trigger_mode mode) {
 		case Pattern:
 		case Duration:
 		case Alternation:
-			write(":TRIG:" + trigger_mode_string_[mode] + ":SOUR?");
-			return (Trigger_source)trigger_source_string_[read()];
+			return stringEnum<Trigger_source>(query(ScpiCommand(":TRIG:", enumString(mode), ":SOUR?")));
 		default:
 			throw std::out_of_range("Value out of range");
 	}
@@ -364,7 +354,7 @@ void RigolScope::setTriggerSource(Trigger_mode mode, Trigger_source source) {
 		case Slope:
 			if(source >= Source_Ext)
 				break;
-			write(":TRIG:" + trigger_mode_string_[mode] + ":SOUR " + trigger_source_string_[source]);
+			write(ScpiCommand(":TRIG:", enumString(mode), ":SOUR ", enumString(source)));
 			return;
 		default:
 			throw std::out_of_range("Value out of range");
@@ -379,8 +369,7 @@ float RigolScope::getTriggerLevel(Trigger_mode mode) {
 		case Edge:
 		case Pulse:
 		case Video:
-			write(":TRIG:" + trigger_mode_string_[mode] + ":LEV?");
-			return convertToFloat(read());
+			return scpiToFloat(query(ScpiCommand(":TRIG:", enumString(mode), ":LEV?")));
 		default:
 			throw std::out_of_range("Incorrect mode");
 	}
@@ -392,9 +381,9 @@ void RigolScope::setTriggerLevel(Trigger_mode mode, float level) {
 	float scale = 0;
 
 	if(getTriggerSource(mode) == Source_CH1)
-		scale = getVoltScale(CH1);
+		scale = cachedVoltScale(CH1);
 	else if(getTriggerSource(mode) == Source_CH2)
-		scale = getVoltScale(CH2);
+		scale = cachedVoltScale(CH2);
 	else if(getTriggerSource(mode) == Source_Ext)
 		scale = 0.2;
 
@@ -402,7 +391,7 @@ void RigolScope::setTriggerLevel(Trigger_mode mode, float level) {
 			throw std::out_of_range("Value out of range");
 
 	if(level >= -6.0*scale && level <= 6.0*scale)
-		write(":TRIG:" + trigger_mode_string_[mode] + ":LEV " + convertToString(level));
+		write(ScpiCommand(":TRIG:", enumString(mode), ":LEV ", level));
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -416,8 +405,7 @@ Trigger_sweep RigolScope::getTriggerSweep(Trigger_mode mode) {
 		case Slope:
 		case Pattern:
 		case Duration:
-			write(":TRIG:" + trigger_mode_string_[mode] + ":SWE?");
-			return (Trigger_sweep)trigger_sweep_string_[read()];
+			return stringEnum<Trigger_sweep>(query(ScpiCommand(":TRIG:", enumString(mode), ":SWE?")));
 		default:
 			throw std::out_of_range("Value out of range");
 	}
@@ -432,7 +420,7 @@ void RigolScope::setTriggerSweep(Trigger_mode mode, Trigger_sweep sweep) {
 		case Slope:
 		case Pattern:
 		case Duration:
-			write(":TRIG:" + trigger_mode_string_[mode] + ":SWE " + trigger_sweep_string_[sweep]);
+			write(ScpiCommand(":TRIG:", enumString(mode), ":SWE ", enumString(sweep)));
 			return;
 		default:
 			throw std::out_of_range("Value out of range");
@@ -442,8 +430,7 @@ void RigolScope::setTriggerSweep(Trigger_mode mode, Trigger_sweep sweep) {
 
 Trigger_coupling RigolScope::getTriggerCoupling(Trigger_mode mode) {
 
-	write(":TRIG:" + trigger_mode_string_[mode] + ":COUP?");
-	return (Trigger_coupling)trigger_coupling_string_[read()];
+	return stringEnum<Trigger_coupling>(query(ScpiCommand(":TRIG:", enumString(mode), ":COUP?")));
 
 }
 
@@ -453,11 +440,11 @@ void RigolScope::setTriggerCoupling(Trigger_mode mode, Trigger_coupling coupling
 		case Trig_DC:
 		case Trig_AC:
 		case Trig_HF:
-			write(":TRIG:" + trigger_mode_string_[mode] + ":COUP " + trigger_coupling_string_[coupling]);
+			write(ScpiCommand(":TRIG:", enumString(mode), ":COUP ", enumString(coupling)));
 			return;
 		case Trig_LF:
 			if(mode == Edge || mode == Pulse || mode == Slope) {
-				write(":TRIG:" + trigger_mode_string_[mode] + ":COUP " + trigger_coupling_string_[coupling]);
+				write(ScpiCommand(":TRIG:", enumString(mode), ":COUP ", enumString(coupling)));
 				return;
 			}
 			else
@@ -468,15 +455,14 @@ void RigolScope::setTriggerCoupling(Trigger_mode mode, Trigger_coupling coupling
 
 float RigolScope::getTriggerHoldoff() {
 
-	write(":TRIG:HOLD?");
-	return convertExponent(read(), 3);
+	return scpiToFloat(query(":TRIG:HOLD?"));
 
 }
 
 void RigolScope::setTriggerHoldoff(float hold_off) {
 
 	if(hold_off <= 1.5 && hold_off >= 0.0000005)
-		write(":TRIG:HOLD " + convertToString(hold_off));
+		write(ScpiCommand(":TRIG:HOLD ", hold_off));
 	else
 		throw std::out_of_range("Value out of range");
 
@@ -484,8 +470,7 @@ void RigolScope::setTriggerHoldoff(float hold_off) {
 
 Trigger_status RigolScope::getTriggerStatus() {
 
-	write(":TRIG:STATUS?");
-	return (Trigger_status)trigger_status_string_[read()];
+	return stringEnum<Trigger_status>(query(":TRIG:STATUS?"));
 
 }
 
@@ -498,8 +483,7 @@ void RigolScope::setTriggerHalf() {
 
 bool RigolScope::getEdgeTriggerSlope() {
 
-	write(":TRIG:EDGE:SLOP?");
-	if(read() == "POSITIVE")
+	if(query(":TRIG:EDGE:SLOP?") == "POSITIVE")
 		return true;
 	else
 		return false;
@@ -515,157 +499,1067 @@ void RigolScope::setEdgeTriggerSlope(bool slope) {
 
 }
 
-std::vector<float> RigolScope::getLongData(Channel chan) {
+void RigolScope::execute(Query_batch& batch) {
 
-	setRun(false);
-	sleep(1);
-	write(":WAVEFORM:POINTS:MODE MAXIMUM");
+	if(batch.queries_.empty())
+		return;
+
+	// Queries are separated with line ends, every query gets its own response line
+	std::string commands;
+	for(size_t i = 0; i != batch.queries_.size(); ++i) {
+		if(i != 0)
+			commands += "\n";
+		commands += batch.queries_[i].command;
+	}
+	std::vector<std::string> responses;
+	runSync([this, &commands, &responses, &batch](const Completion& done) {
+		asyncWrite(commands, [this, &responses, &batch, done](const boost::system::error_code& error) {
+			if(error)
+				done(error);
+			else
+				asyncReadLines(&responses, batch.queries_.size(), done);
+		});
+	});
+
+	convertBatch(batch, responses);
 
-	write(":WAVEFORM:DATA? " + convertToString(chan));
-	std::string raw_data = read();
-	return formatData(raw_data, getVoltOffset(chan), getVoltScale(chan));
-	
 }
 
-void RigolScope::setSerialSpeed(Baud_rate rate) {
+void RigolScope::convertBatch(Query_batch& batch, const std::vector<std::string>& responses) {
+
+	for(size_t i = 0; i != batch.queries_.size(); ++i) {
+		Query_batch::Query& query = batch.queries_[i];
+		const std::string& response = responses[i];
+
+		try {
+			switch(query.type) {
+				case Query_batch::Result_float:
+					*(float*)query.result = scpiToFloat(response);
+					break;
+				case Query_batch::Result_int:
+					*(int*)query.result = lround(scpiToFloat(response));
+					break;
+				case Query_batch::Result_size_t:
+					*(size_t*)query.result = scpiToSizeT(response);
+					break;
+				case Query_batch::Result_bool:
+					*(bool*)query.result = (response == "ON" || response == "POSITIVE");
+					break;
+				case Query_batch::Result_string:
+					*(std::string*)query.result = response;
+					break;
+				case Query_batch::Result_trigger_mode:
+					*(Trigger_mode*)query.result = stringEnum<Trigger_mode>(response);
+					break;
+				case Query_batch::Result_trigger_source:
+					*(Trigger_source*)query.result = stringEnum<Trigger_source>(response);
+					break;
+				case Query_batch::Result_trigger_sweep:
+					*(Trigger_sweep*)query.result = stringEnum<Trigger_sweep>(response);
+					break;
+				case Query_batch::Result_trigger_coupling:
+					*(Trigger_coupling*)query.result = stringEnum<Trigger_coupling>(response);
+					break;
+				case Query_batch::Result_trigger_status:
+					*(Trigger_status*)query.result = stringEnum<Trigger_status>(response);
+					break;
+			}
+		}
+		catch(std::out_of_range) {
+			throw std::out_of_range("Scope returned something unexpected to " + query.command);
+		}
+	}
 
-	std::cout << ":RS232:BAUD " << convertToString(rate) << std::endl;
-	write(":RS232:BAUD " + convertToString(rate));
-	write(":RS232:BAUD " + convertToString(rate));
-	//port_.open(address_);
-	//std::cout << address_ << std::endl;
-	
-	//configureSerial(rate);
-	//port_.close();
-	//sleep(1);
-	//port_.open(address_);
+}
 
-	configureSerial(rate);
+Scope_settings RigolScope::getSettings(Trigger_mode mode) {
 
-	while(true) {
-		try{
-			//write(":RS232:BAUD " + convertToString(rate));
-			write("*IDN?");
-			std::cout << read() << std::endl;
-		}
-		catch(timeout_exception) {
-			std::cout << "No answer" << std::endl;
+	Scope_settings settings;
+	Query_batch batch;
+
+	for(size_t i = 0; i != 2; ++i) {
+		std::string chan = ":CHAN" + std::to_string(i + 1);
+		Scope_settings::Channel_settings& channel = settings.channel[i];
+		batch.add(chan + ":DISP?", channel.enable);
+		batch.add(chan + ":MEMD?", channel.mem_depth);
+		batch.add(chan + ":SCAL?", channel.volt_scale);
+		batch.add(chan + ":OFFS?", channel.volt_offset);
+		batch.add(chan + ":PROBE?", channel.attenuation);
+		batch.add(chan + ":COUPLING?", channel.coupling);
+	}
+
+	batch.add(":TIM:SCAL?", settings.timescale);
+	batch.add(":TIM:OFFS?", settings.time_offset);
+	batch.add(":COUNter:ENABle?", settings.freq_counter_enable);
+	batch.add(":TRIG:MODE?", settings.trigger_mode);
+	batch.add(":TRIG:" + getEnumString(mode) + ":SOUR?", settings.trigger_source);
+	if(mode == Edge || mode == Pulse || mode == Video)
+		batch.add(":TRIG:" + getEnumString(mode) + ":LEV?", settings.trigger_level);
+	if(mode == Edge || mode == Pulse || mode == Slope || mode == Pattern || mode == Duration)
+		batch.add(":TRIG:" + getEnumString(mode) + ":SWE?", settings.trigger_sweep);
+	batch.add(":TRIG:" + getEnumString(mode) + ":COUP?", settings.trigger_coupling);
+	batch.add(":TRIG:HOLD?", settings.trigger_holdoff);
+	batch.add(":TRIG:STATUS?", settings.trigger_status);
+	batch.add(":TRIG:EDGE:SLOP?", settings.edge_trigger_slope);
+
+	execute(batch);
+
+	for(size_t i = 0; i != 2; ++i) {
+		volt_scale_[i].set(settings.channel[i].volt_scale);
+		volt_offset_[i].set(settings.channel[i].volt_offset);
+		attenuation_[i].set(settings.channel[i].attenuation);
+	}
+	timescale_.set(settings.timescale);
+	time_offset_.set(settings.time_offset);
+
+	return settings;
+
+}
+
+void RigolScope::getLongRawData(Channel chan, Waveform_frame& frame, const Progress_handler& progress,
+			const boost::posix_time::time_duration& trigger_timeout) {
+
+	runSync([this, chan, &frame, &progress, &trigger_timeout](const Completion& done) {
+		startLongRawData(chan, &frame, progress, trigger_timeout, done);
+	});
+
+}
+
+std::vector<float> RigolScope::getLongData(Channel chan, const Progress_handler& progress,
+			const boost::posix_time::time_duration& trigger_timeout) {
+
+	getLongRawData(chan, frame_, progress, trigger_timeout);
+	std::vector<float> data;
+	VoltageView(frame_).convert(data);
+	return data;
+
+}
+
+void RigolScope::startStreaming(FrameRing<Waveform_frame>& ring, const std::vector<Channel>& channels) {
+
+	if(streaming_thread_.joinable())
+		throw std::logic_error("Already streaming");
+	if(channels.empty())
+		throw std::invalid_argument("No channels to acquire");
+
+	streaming_error_ = std::exception_ptr();
+	streaming_ = true;
+	streaming_thread_ = std::thread(&RigolScope::streamingLoop, this, &ring, channels);
+
+}
+
+void RigolScope::stopStreaming() {
+
+	streaming_ = false;
+	if(streaming_thread_.joinable())
+		streaming_thread_.join();
+
+	if(streaming_error_) {
+		std::exception_ptr error = streaming_error_;
+		streaming_error_ = std::exception_ptr();
+		std::rethrow_exception(error);
+	}
+
+}
+
+bool RigolScope::isStreaming() const {
+
+	return streaming_;
+
+}
+
+uint64_t RigolScope::getStreamingTimeouts() const {
+
+	return streaming_timeouts_;
+
+}
+
+void RigolScope::discardStaleInput() {
+
+	runSync([this](const Completion& done) {
+		// Long enough for the rest of a normal frame, a line that stays busy longer is not just late
+		boost::posix_time::ptime deadline = boost::posix_time::pos_infin;
+		if(timeout_ != boost::posix_time::seconds(0))
+			deadline = boost::posix_time::microsec_clock::universal_time() + transferTimeout(normal_points_ + 16);
+		asyncDiscardUntilQuiet(deadline, done);
+	});
+
+}
+
+void RigolScope::streamingLoop(FrameRing<Waveform_frame>* ring, std::vector<Channel> channels) {
+
+	// Frame swapped in and out of the ring, its sample memory gets recycled
+	Waveform_frame frame;
+	bool stale = false;
+
+	try {
+		while(streaming_) {
+			for(size_t i = 0; i != channels.size() && streaming_; ++i) {
+				try {
+					// The rest of a frame that timed out may still arrive, it would be taken for the next one
+					if(stale) {
+						discardStaleInput();
+						stale = false;
+					}
+					getRawData(channels[i], frame);
+				}
+				catch(timeout_exception) {
+					++streaming_timeouts_;
+					stale = true;
+					continue;
+				}
+				ring->push(frame);
+			}
 		}
+		// Nor for the first frame of the next streaming or a query after stopStreaming()
+		if(stale)
+			discardStaleInput();
 	}
-	/*std::string temp = "";
-	while(temp == "") {
-		temp = read();
-		std::cout << "vittuuu" << std::endl;
-		std::cout << temp << std::endl;
-		write("*IDN?");
-		sleep(2);
-	}*/
-	
+	catch(...) {
+		streaming_error_ = std::current_exception();
+		streaming_ = false;
+	}
+
+}
+
+bool RigolScope::setSerialSpeed(Baud_rate rate, bool hardware_flow) {
+
+	Baud_rate previous_rate = serial_rate_;
+	bool previous_flow = hardware_flow_;
+
+	write(ScpiCommand(":RS232:BAUD ", rate));
+	configureSerial(rate, hardware_flow);
+	if(verifyLink())
+		return true;
+
+	// The scope may or may not have received the command, try the old rate first and then
+	// ask the scope to switch back in case it did change
+	configureSerial(previous_rate, previous_flow);
+	if(verifyLink())
+		return false;
+
+	configureSerial(rate, false);
+	write(ScpiCommand(":RS232:BAUD ", previous_rate));
+	configureSerial(previous_rate, previous_flow);
+	if(verifyLink())
+		return false;
+
+	throw timeout_exception("Serial link lost while changing the baud rate");
+
+}
+
+Baud_rate RigolScope::negotiateSerialSpeed(Baud_rate max_rate, bool hardware_flow) {
+
+	static const Baud_rate rates[] = {Baud_300, Baud_2400, Baud_4800, Baud_9600, Baud_19200, Baud_38400};
+
+	if(hardware_flow && !hardware_flow_)
+		setSerialSpeed(serial_rate_, true);
+
+	for(size_t i = 0; i != sizeof(rates)/sizeof(rates[0]); ++i) {
+		if(rates[i] <= serial_rate_ || rates[i] > max_rate)
+			continue;
+		if(!setSerialSpeed(rates[i], hardware_flow_))
+			break;
+	}
+
+	return serial_rate_;
+
+}
+
+Baud_rate RigolScope::getSerialSpeed() const {
+
+	return serial_rate_;
+
+}
+
+bool RigolScope::getHardwareFlowControl() const {
+
+	return hardware_flow_;
+
 }
 
 std::string RigolScope::getEnumString(Channel chan) {
 
-	return channel_string_[chan];
+	return std::string(enumString(chan));
 
 }
 
 std::string RigolScope::getEnumString(Trigger_mode mode) {
 
-	return trigger_mode_string_[mode];
+	return std::string(enumString(mode));
 
 }
 
 std::string RigolScope::getEnumString(Trigger_source source) {
 
-	return trigger_source_string_[source];
+	return std::string(enumString(source));
 
 }
 
 std::string RigolScope::getEnumString(Trigger_sweep sweep) {
 
-	return trigger_sweep_string_[sweep];
+	return std::string(enumString(sweep));
 
 }
 
 std::string RigolScope::getEnumString(Trigger_coupling coupling) {
 
-	return trigger_coupling_string_[coupling];
+	return std::string(enumString(coupling));
 
 }
 
 std::string RigolScope::getEnumString(Trigger_status status) {
 
-	return trigger_status_string_[status];
+	return std::string(enumString(status));
+
+}
+
+void RigolScope::write(std::string_view command) {
+
+	runSync([this, &command](const Completion& done) {
+		asyncWrite(command, done);
+	});
 
 }
 
-void RigolScope::write(std::string command) {
+std::string_view RigolScope::read() {
 
-	command += "\n";
-	boost::asio::write(port_, boost::asio::buffer(command.c_str(), command.size()));
+	// response_ belongs to the job running next, the response is copied for the caller in the job. The buffer
+	// is kept for the next calls of the thread, once it has grown to the longest response nothing is allocated.
+	thread_local std::string response;
+	runSync([this](const Completion& done) {
+		asyncReadLine(done);
+	}, &response);
+	return response;
 
 }
 
-std::string RigolScope::read() {
+std::string_view RigolScope::query(std::string_view command) {
+
+	thread_local std::string response;
+	runSync([this, &command](const Completion& done) {
+		asyncQuery(command, done);
+	}, &response);
+	return response;
+
+}
+
+void RigolScope::readBlock(std::vector<uint8_t>& data, size_t expected) {
+
+	runSync([this, &data, expected](const Completion& done) {
+		asyncReadBlock(&data, expected, done);
+	});
+
+}
+
+void RigolScope::enqueue(const Job& job) {
+
+	strand_.post(makePooledHandler(handler_memory_, [this, job]() {
+		if(jobs_.full())
+			jobs_.set_capacity(jobs_.capacity()*2);
+		jobs_.push_back(job);
+		if(!job_running_)
+			startNextJob();
+	}));
+
+}
 
-	boost::asio::async_read_until(port_, streambuffer_, "\n", boost::bind(&RigolScope::readCompleted, 
-			this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+void RigolScope::startNextJob() {
 
-	if(timeout_ != boost::posix_time::seconds(0)) {
-		timer_.expires_from_now(timeout_);
-		timer_.async_wait(boost::bind(&RigolScope::timeoutExpired, this, boost::asio::placeholders::error));
+	if(jobs_.empty()) {
+		job_running_ = false;
+		return;
 	}
 
-	result_ = resultInProgress;
-	bytes_transferred_ = 0;
+	job_running_ = true;
+	Job job = std::move(jobs_.front());
+	jobs_.pop_front();
 
-	for(;;) {
+	job([this](const boost::system::error_code&) {
+		finishJob();
+	});
 
-		io_.run_one();
-		switch(result_) {
-			case resultSuccess: {
-				timer_.cancel();
-				bytes_transferred_ -= 1;
-				std::istream is(&streambuffer_);
-				std::string result(bytes_transferred_,'\0');
-				is.read(&result[0], bytes_transferred_);
-				is.ignore(1);
-				return result;
+}
+
+void RigolScope::finishJob() {
+
+	finishCommand();
+	strand_.post(makePooledHandler(handler_memory_, [this]() {
+		startNextJob();
+	}));
+
+}
+
+void RigolScope::runSync(const Job& job, std::string* response) {
+
+	// The lambdas capture only pointers, so that std::function keeps them without allocating
+	struct Sync_call {
+		const Job* job;
+		std::string* response;
+		boost::system::error_code result;
+		bool done;
+	} call = {&job, response, boost::system::error_code(), false};
+
+	enqueue([this, &call](const Completion&) {
+		(*call.job)([this, &call](const boost::system::error_code& error) {
+			if(call.response && !error)
+				call.response->assign(response_);
+			{
+				std::lock_guard<std::mutex> lock(sync_mutex_);
+				call.result = error;
+				call.done = true;
 			}
-			case resultTimeoutExpired:
-				port_.cancel();
-				throw(timeout_exception("Timeout expired"));
-			case resultError:
-				timer_.cancel();
-				port_.cancel();
-				throw(boost::system::system_error(boost::system::error_code(), "Error while reading"));
-			case resultInProgress:;
+			sync_condition_.notify_all();
+			// The same as calling the Completion given to the job, which would have to be captured
+			finishJob();
+		});
+	});
+
+	if(own_io_) {
+		if(io_.stopped())
+			io_.restart();
+		while(!call.done)
+			io_.run_one();
+	}
+	else {
+		std::unique_lock<std::mutex> lock(sync_mutex_);
+		sync_condition_.wait(lock, [&call]() { return call.done; });
+	}
+
+	if(call.result == boost::asio::error::timed_out)
+		throw(timeout_exception("Timeout expired"));
+	if(call.result)
+		throw(boost::system::system_error(call.result, "Error while communicating with the scope"));
+
+}
+
+void RigolScope::armTimer() {
+
+	armTimer(timeout_);
+
+}
+
+void RigolScope::armTimer(const boost::posix_time::time_duration& timeout) {
+
+	unsigned id = ++operation_id_;
+	timed_out_ = false;
+
+	if(timeout != boost::posix_time::seconds(0)) {
+		timer_.expires_from_now(timeout);
+		timer_.async_wait(strand_.wrap(makePooledHandler(handler_memory_, 
+				[this, id](const boost::system::error_code& error) {
+			// A timer that fires after its operation already completed must not cancel the next one
+			if(error == boost::asio::error::operation_aborted || id != operation_id_)
+				return;
+			timed_out_ = true;
+			transport_->cancel();
+		})));
+	}
+
+}
+
+boost::posix_time::time_duration RigolScope::transferTimeout(size_t bytes) const {
+
+	// Zero timeout means waiting forever, and links other than serial are not limited by the baud rate
+	if(timeout_ == boost::posix_time::seconds(0) || !dynamic_cast<SerialTransport*>(transport_.get()))
+		return timeout_;
+
+	// A byte takes 10 bits on the line with the start and stop bits
+	return timeout_ + boost::posix_time::microseconds((int64_t)bytes*2*10*1000000/serial_rate_);
+
+}
+
+boost::system::error_code RigolScope::disarmTimer(const boost::system::error_code& error) {
+
+	++operation_id_;
+	timer_.cancel();
+
+	boost::system::error_code result = error;
+	if(error == boost::asio::error::operation_aborted && timed_out_)
+		result = boost::asio::error::timed_out;
+
+	if(command_open_) {
+		command_end_ = std::chrono::steady_clock::now();
+		if(!command_error_)
+			command_error_ = result;
+	}
+
+	return result;
+
+}
+
+void RigolScope::startCommand(std::string_view command) {
+
+	finishCommand();
+	if(!statistics_enabled_.load(std::memory_order_relaxed))
+		return;
+
+	// Arguments are left out so that the commands setting different values are counted together
+	command_name_.clear();
+	for(size_t begin = 0; begin < command.size(); ) {
+		size_t end = std::min(command.find(';', begin), command.size());
+		size_t space = command.find(' ', begin);
+		if(begin != 0)
+			command_name_ += ';';
+		command_name_.append(command, begin, std::min(space, end) - begin);
+		begin = end + 1;
+	}
+
+	command_open_ = true;
+	command_error_ = boost::system::error_code();
+	command_start_ = command_end_ = std::chrono::steady_clock::now();
+
+}
+
+void RigolScope::finishCommand() {
+
+	if(!command_open_)
+		return;
+	command_open_ = false;
+	statistics_.recordCommand(command_name_, 
+				std::chrono::duration_cast<std::chrono::nanoseconds>(command_end_ - command_start_).count(), command_error_);
+
+}
+
+void RigolScope::asyncWrite(std::string_view command, const Completion& handler) {
+
+	startWrite(command, handler);
+
+}
+
+void RigolScope::asyncReadLine(const Completion& handler) {
+
+	armTimer();
+	boost::asio::async_read_until(stream_, streambuffer_, '\n', strand_.wrap(makePooledHandler(handler_memory_,
+			[this, handler](const boost::system::error_code& error, size_t bytes_transferred) {
+		boost::system::error_code result = disarmTimer(error);
+		if(!result) {
+			const char* data = boost::asio::buffer_cast<const char*>(streambuffer_.data());
+			response_.assign(data, bytes_transferred - 1);
+			streambuffer_.consume(bytes_transferred);
 		}
+		handler(result);
+	})));
+
+}
+
+void RigolScope::asyncReadLines(std::vector<std::string>* responses, size_t count, const Completion& handler) {
+
+	if(responses->size() == count) {
+		handler(boost::system::error_code());
+		return;
 	}
+
+	asyncReadLine([this, responses, count, handler](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
+		}
+		responses->push_back(response_);
+		asyncReadLines(responses, count, handler);
+	});
+
 }
 
-void RigolScope::readCompleted(const boost::system::error_code& error, const size_t bytes_transferred_) {
+void RigolScope::asyncQuery(std::string_view command, const Completion& handler) {
 
-	if(error) {
-		if(error != boost::asio::error::operation_aborted) {
-			result_ = resultError;
+	// Not through asyncWrite(), a Completion holding handler would have to be allocated
+	startWrite(command, [this, handler](const boost::system::error_code& error) {
+		if(error)
+			handler(error);
+		else
+			asyncReadLine(handler);
+	});
+
+}
+
+void RigolScope::asyncReadBlock(std::vector<uint8_t>* data, size_t expected, const Completion& handler, 
+			const Progress_handler& progress) {
+
+	asyncFill(2, [this, data, expected, handler, progress](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
 		}
-	} 
-	else {
-		if(result_ != resultInProgress) return;
-		result_ = resultSuccess;
-		this->bytes_transferred_ = bytes_transferred_;
+
+		const char* header = boost::asio::buffer_cast<const char*>(streambuffer_.data());
+		if(header[0] != '#') {
+			asyncReadBlockData(data, expected, handler, progress);
+			return;
+		}
+
+		size_t digits = header[1] - '0';
+		if(digits > 9) {
+			handler(boost::system::errc::make_error_code(boost::system::errc::bad_message));
+			return;
+		}
+		streambuffer_.consume(2);
+
+		// "#0" is an indefinite length block, fall back to the expected length
+		if(digits == 0) {
+			asyncReadBlockData(data, expected, handler, progress);
+			return;
+		}
+
+		asyncFill(digits, [this, data, digits, handler, progress](const boost::system::error_code& error) {
+			if(error) {
+				handler(error);
+				return;
+			}
+
+			const char* header = boost::asio::buffer_cast<const char*>(streambuffer_.data());
+			size_t length = 0;
+			for(size_t i = 0; i != digits; ++i) {
+				if(header[i] < '0' || header[i] > '9') {
+					handler(boost::system::errc::make_error_code(boost::system::errc::bad_message));
+					return;
+				}
+				length = length*10 + (header[i] - '0');
+			}
+			streambuffer_.consume(digits);
+			asyncReadBlockData(data, length, handler, progress);
+		});
+	});
+
+}
+
+void RigolScope::asyncReadBlockData(std::vector<uint8_t>* data, size_t length, const Completion& handler,
+			const Progress_handler& progress) {
+
+	data->resize(length);
+
+	// Whatever already got buffered while reading the header is copied, the rest is read straight into data
+	size_t buffered = std::min(streambuffer_.size(), length);
+	boost::asio::buffer_copy(boost::asio::buffer(data->data(), buffered), streambuffer_.data());
+	streambuffer_.consume(buffered);
+
+	Completion terminator = [this, handler](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
+		}
+		asyncFill(1, [this, handler](const boost::system::error_code& error) {
+			if(!error && streambuffer_.sgetc() == '\n')
+				streambuffer_.consume(1);
+			handler(error);
+		});
+	};
+
+	if(progress)
+		asyncReadChunks(data, buffered, progress, terminator);
+	else if(buffered != length)
+		asyncReadExactly(data->data() + buffered, length - buffered, terminator);
+	else
+		terminator(boost::system::error_code());
+
+}
+
+void RigolScope::asyncReadChunks(std::vector<uint8_t>* data, size_t offset, const Progress_handler& progress, 
+			const Completion& handler) {
+
+	size_t total = data->size();
+	if(!progress(offset, total)) {
+		// The scope keeps sending the rest of the block and its line end
+		size_t rest = total - offset + 1;
+		// A full circular_buffer would drop the last job instead of growing
+		if(jobs_.full())
+			jobs_.set_capacity(jobs_.capacity()*2);
+		jobs_.push_front([this, rest](const Completion& done) {
+			asyncDiscard(rest, done);
+		});
+		handler(boost::asio::error::operation_aborted);
+		return;
+	}
+
+	if(offset == total) {
+		handler(boost::system::error_code());
+		return;
+	}
+
+	size_t size = std::min(chunk_size_, total - offset);
+	armTimer(transferTimeout(size));
+	boost::asio::async_read(stream_, boost::asio::buffer(data->data() + offset, size), strand_.wrap(
+			[this, data, offset, size, progress, handler](const boost::system::error_code& error, size_t) {
+		boost::system::error_code result = disarmTimer(error);
+		if(result)
+			handler(result);
+		else
+			asyncReadChunks(data, offset + size, progress, handler);
+	}));
+
+}
+
+void RigolScope::asyncDiscard(size_t size, const Completion& handler) {
+
+	size_t buffered = std::min(streambuffer_.size(), size);
+	streambuffer_.consume(buffered);
+	size -= buffered;
+	if(size == 0) {
+		handler(boost::system::error_code());
+		return;
+	}
+
+	armTimer(transferTimeout(std::min(size, chunk_size_)));
+	boost::asio::async_read(stream_, streambuffer_, boost::asio::transfer_at_least(1), strand_.wrap(
+			[this, size, handler](const boost::system::error_code& error, size_t) {
+		boost::system::error_code result = disarmTimer(error);
+		if(result)
+			handler(result);
+		else
+			asyncDiscard(size, handler);
+	}));
+
+}
+
+void RigolScope::asyncDiscardUntilQuiet(const boost::posix_time::ptime& deadline, const Completion& handler) {
+
+	streambuffer_.consume(streambuffer_.size());
+	if(boost::posix_time::microsec_clock::universal_time() >= deadline) {
+		handler(boost::asio::error::timed_out);
+		return;
+	}
+
+	armTimer(boost::posix_time::milliseconds(100));
+	boost::asio::async_read(stream_, streambuffer_, boost::asio::transfer_at_least(1), strand_.wrap(
+			[this, deadline, handler](const boost::system::error_code& error, size_t) {
+		boost::system::error_code result = disarmTimer(error);
+		if(!result) {
+			asyncDiscardUntilQuiet(deadline, handler);
+			return;
+		}
+		if(result != boost::asio::error::timed_out) {
+			handler(result);
+			return;
+		}
+		// Nothing arrived for the whole wait, drop what the driver may still hold
+		if(SerialTransport* serial = dynamic_cast<SerialTransport*>(transport_.get())) {
+			try {
+				serial->flushInput();
+			}
+			catch(boost::system::system_error& e) {
+				handler(e.code());
+				return;
+			}
+		}
+		streambuffer_.consume(streambuffer_.size());
+		handler(boost::system::error_code());
+	}));
+
+}
+
+void RigolScope::asyncFill(size_t size, const Completion& handler) {
+
+	if(streambuffer_.size() >= size) {
+		handler(boost::system::error_code());
+		return;
 	}
+
+	armTimer();
+	boost::asio::async_read(stream_, streambuffer_, boost::asio::transfer_at_least(size - streambuffer_.size()), 
+			strand_.wrap([this, handler](const boost::system::error_code& error, size_t) {
+		handler(disarmTimer(error));
+	}));
+
 }
 
-void RigolScope::timeoutExpired(const boost::system::error_code& error) {
+void RigolScope::asyncReadExactly(uint8_t* data, size_t size, const Completion& handler) {
 
-	if(result_ != resultInProgress) return;
+	armTimer();
+	boost::asio::async_read(stream_, boost::asio::buffer(data, size), strand_.wrap(
+			[this, handler](const boost::system::error_code& error, size_t) {
+		handler(disarmTimer(error));
+	}));
 
-	if(error != boost::asio::error::operation_aborted) {
-		result_ = resultTimeoutExpired;
+}
+
+void RigolScope::asyncCachedFloat(std::string_view command, Cached_value<float>* cache, const Completion& handler) {
+
+	if(cache->valid) {
+		handler(boost::system::error_code());
+		return;
 	}
 
+	asyncQuery(command, [this, cache, handler](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
+		}
+		try {
+			cache->set(scpiToFloat(response_));
+		}
+		catch(std::out_of_range) {
+			handler(boost::system::errc::make_error_code(boost::system::errc::bad_message));
+			return;
+		}
+		handler(error);
+	});
+
+}
+
+float RigolScope::toFloat(const std::string& response) {
+
+	return scpiToFloat(response);
+
+}
+
+int RigolScope::toInt(const std::string& response) {
+
+	return lround(scpiToFloat(response));
+
+}
+
+size_t RigolScope::toSizeT(const std::string& response) {
+
+	return scpiToSizeT(response);
+
+}
+
+bool RigolScope::toBool(const std::string& response) {
+
+	return response == "ON" || response == "POSITIVE";
+
+}
+
+void RigolScope::asyncFrameSettings(Channel chan, Waveform_frame* frame, const Completion& handler) {
+
+	Completion settings = [this, chan, frame, handler](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
+		}
+		frame->channel = chan;
+		frame->volt_scale = volt_scale_[chan - 1].value;
+		frame->volt_offset = volt_offset_[chan - 1].value;
+		frame->timescale = timescale_.value;
+		frame->time_offset = time_offset_.value;
+		handler(error);
+	};
+
+	// Settings missing from the cache are queried one after another
+	asyncCachedFloat(ScpiCommand(":CHAN", chan, ":SCAL?"), &volt_scale_[chan - 1], 
+			[this, chan, settings](const boost::system::error_code& error) {
+		if(error) {
+			settings(error);
+			return;
+		}
+		asyncCachedFloat(ScpiCommand(":CHAN", chan, ":OFFS?"), &volt_offset_[chan - 1], 
+				[this, settings](const boost::system::error_code& error) {
+			if(error) {
+				settings(error);
+				return;
+			}
+			asyncCachedFloat(":TIM:SCAL?", &timescale_, [this, settings](const boost::system::error_code& error) {
+				if(error)
+					settings(error);
+				else
+					asyncCachedFloat(":TIM:OFFS?", &time_offset_, settings);
+			});
+		});
+	});
+
+}
+
+void RigolScope::startRawData(Channel chan, Waveform_frame* frame, const Completion& handler) {
+
+	Completion data = [this, chan, frame, handler](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
+		}
+		frame->timestamp = std::chrono::system_clock::now();
+		asyncFrameSettings(chan, frame, [frame, handler](const boost::system::error_code& error) {
+			// Normal mode points cover the 12 horizontal divisions of the screen
+			if(!error)
+				frame->sample_interval = frame->samples.empty() ? 0.0 : frame->timescale*12/frame->samples.size();
+			handler(error);
+		});
+	};
+
+	Completion query = [this, chan, frame, data](const boost::system::error_code& error) {
+		if(error) {
+			data(error);
+			return;
+		}
+		normal_points_mode_.set(true);
+		asyncWrite(ScpiCommand(":WAV:DATA? CHAN", chan), [this, frame, data](const boost::system::error_code& error) {
+			if(error)
+				data(error);
+			else
+				asyncReadBlock(&frame->samples, normal_points_, data);
+		});
+	};
+
+	if(normal_points_mode_.valid && normal_points_mode_.value)
+		query(boost::system::error_code());
+	else
+		asyncWrite(":WAV:POIN:MODE NOR", query);
+
+}
+
+void RigolScope::asyncWaitStop(const boost::posix_time::ptime& deadline, const boost::posix_time::time_duration& delay,
+			bool stop_sent, const Completion& handler) {
+
+	asyncQuery(":TRIG:STATUS?", [this, deadline, delay, stop_sent, handler](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
+		}
+
+		Trigger_status status;
+		if(Enum_strings<Trigger_status>::table.fromString(response_, status) && status == Stop) {
+			handler(error);
+			return;
+		}
+
+		boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+		if(now >= deadline) {
+			if(stop_sent) {
+				handler(boost::asio::error::timed_out);
+				return;
+			}
+			// Not stopped on its own, stop it and give it the normal timeout for that
+			boost::posix_time::ptime stop_deadline = timeout_ == boost::posix_time::seconds(0) ? 
+						boost::posix_time::ptime(boost::posix_time::pos_infin) : now + timeout_;
+			asyncWrite(":STOP", [this, stop_deadline, handler](const boost::system::error_code& error) {
+				if(error)
+					handler(error);
+				else
+					asyncWaitStop(stop_deadline, boost::posix_time::milliseconds(10), true, handler);
+			});
+			return;
+		}
+
+		std::shared_ptr<boost::asio::deadline_timer> timer(new boost::asio::deadline_timer(io_, 
+					std::min(delay, deadline - now)));
+		timer->async_wait(strand_.wrap([this, timer, deadline, delay, stop_sent, handler](
+					const boost::system::error_code&) {
+			asyncWaitStop(deadline, std::min(delay*2, boost::posix_time::time_duration(boost::posix_time::milliseconds(500))), 
+						stop_sent, handler);
+		}));
+	});
+
+}
+
+void RigolScope::startLongRawData(Channel chan, Waveform_frame* frame, const Progress_handler& progress,
+			const boost::posix_time::time_duration& trigger_timeout, const Completion& handler) {
+
+	std::string channel = "CHAN" + std::to_string(chan);
+
+	Completion sample_rate = [this, channel, frame, handler](const boost::system::error_code& error) {
+		if(error) {
+			handler(error);
+			return;
+		}
+		asyncQuery(":ACQ:SAMP? " + channel, [this, frame, handler](const boost::system::error_code& error) {
+			if(error) {
+				handler(error);
+				return;
+			}
+			double rate;
+			if(!parseScpiNumber(response_.data(), response_.data() + response_.size(), rate)) {
+				handler(boost::system::errc::make_error_code(boost::system::errc::bad_message));
+				return;
+			}
+			frame->sample_interval = rate > 0 ? 1/rate : 0.0;
+			handler(error);
+		});
+	};
+
+	Completion data = [this, chan, frame, sample_rate](const boost::system::error_code& error) {
+		if(error) {
+			sample_rate(error);
+			return;
+		}
+		frame->timestamp = std::chrono::system_clock::now();
+		asyncFrameSettings(chan, frame, sample_rate);
+	};
+
+	// The memory depth is only needed if the scope sends the samples without a block header
+	Completion read = [this, channel, frame, progress, data](const boost::system::error_code& error) {
+		if(error) {
+			data(error);
+			return;
+		}
+		size_t depth;
+		if(!parseScpiNumber(response_.data(), response_.data() + response_.size(), depth)) {
+			data(boost::system::errc::make_error_code(boost::system::errc::bad_message));
+			return;
+		}
+		asyncWrite(":WAV:DATA? " + channel, [this, frame, depth, progress, data](const boost::system::error_code& error) {
+			if(error)
+				data(error);
+			else
+				asyncReadBlock(&frame->samples, depth, data, progress);
+		});
+	};
+
+	Completion stopped = [this, channel, read](const boost::system::error_code& error) {
+		if(error) {
+			read(error);
+			return;
+		}
+		normal_points_mode_.set(false);
+		asyncWrite(":WAV:POIN:MODE MAX", [this, channel, read](const boost::system::error_code& error) {
+			if(error)
+				read(error);
+			else
+				asyncQuery(":" + channel + ":MEMD?", read);
+		});
+	};
+
+	asyncWaitStop(boost::posix_time::microsec_clock::universal_time() + trigger_timeout, 
+				boost::posix_time::milliseconds(10), false, stopped);
+
+}
+
+void RigolScope::setStatisticsEnabled(bool enabled) {
+
+	statistics_enabled_.store(enabled, std::memory_order_relaxed);
+	stream_.setStats(enabled ? &statistics_ : 0);
+
+}
+
+bool RigolScope::getStatisticsEnabled() const {
+
+	return statistics_enabled_.load(std::memory_order_relaxed);
+
+}
+
+LinkStats& RigolScope::getStatistics() {
+
+	return statistics_;
+
+}
+
+void RigolScope::startRecording(const std::string& path) {
+
+	stopRecording();
+
+	// The recorder is changed in a job of its own, when no operation is pending on the stream
+	std::unique_ptr<TraceRecorder> recorder(new TraceRecorder(path));
+	TraceRecorder* pointer = recorder.get();
+	runSync([this, pointer](const Completion& done) {
+		stream_.setRecorder(pointer);
+		done(boost::system::error_code());
+	});
+	recorder_ = std::move(recorder);
+
+	info_ = getInfo();
+
+}
+
+void RigolScope::stopRecording() {
+
+	if(!recorder_)
+		return;
+
+	runSync([this](const Completion& done) {
+		stream_.setRecorder(0);
+		done(boost::system::error_code());
+	});
+	recorder_->flush();
+	recorder_.reset();
+
 }
 
 void RigolScope::setSerialTimeout(const boost::posix_time::time_duration& duration) {
@@ -674,40 +1568,114 @@ void RigolScope::setSerialTimeout(const boost::posix_time::time_duration& durati
 
 }
 
-std::vector<float> RigolScope::formatData(std::string raw_data, float volt_offset, float volt_scale) {
+float RigolScope::cachedVoltScale(Channel chan) {
 
-	std::vector<float> data;
+	if(volt_scale_[chan - 1].valid)
+		return volt_scale_[chan - 1].value;
+	return getVoltScale(chan);
 
-	for(size_t i = 0; i != raw_data.length(); i++) {
-		int temp = raw_data[i];
-		data.push_back((((temp*(-1)+255)-130.0-(volt_offset/volt_scale*25))/25*volt_scale));   // do some data scaling magic
-	}
-	return data;
 }
 
-float RigolScope::convertExponent(std::string number, size_t decimals) {
+float RigolScope::cachedVoltOffset(Channel chan) {
 
-		float base = 0.0;	
+	if(volt_offset_[chan - 1].valid)
+		return volt_offset_[chan - 1].value;
+	return getVoltOffset(chan);
 
-		if(decimals == 0)
-			base = convertToFloat(number.substr(0, (decimals + 1)));
-		else
-			base = convertToFloat(number.substr(0, (decimals + 2)));
+}
+
+void RigolScope::formatData(const std::vector<uint8_t>& raw_data, float volt_offset, float volt_scale, std::vector<float>& data) {
 
-		float exp = convertToDouble(number.substr((decimals + 4), 2));
+	scaler_.configure(volt_offset, volt_scale);
+	scaler_.convert(raw_data, data);
 
-		if(number.substr((decimals+3), 1) == "-")
-			exp = -1.0*exp;
+}
+
+void RigolScope::configureSerial(Baud_rate rate, bool hardware_flow) {
 
-		return base*pow(10, exp);
+	SerialTransport* serial = dynamic_cast<SerialTransport*>(transport_.get());
+	if(!serial)
+		throw std::logic_error("Scope is not connected through a serial port");
+
+	// Done as a job so that it is ordered with the writes before it
+	runSync([this, serial, rate, hardware_flow](const Completion& done) {
+		size_t pending;
+		try {
+			pending = serial->pendingOutput();
+		}
+		catch(boost::system::system_error& e) {
+			done(e.code());
+			return;
+		}
+		// Twice the time the output takes on the line, with RTS/CTS the scope may never let it through
+		boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + 
+					boost::posix_time::milliseconds(100) + 
+					boost::posix_time::microseconds((int64_t)pending*2*10*1000000/serial_rate_);
+		asyncWaitOutput(serial, deadline, [this, serial, rate, hardware_flow, done](
+					const boost::system::error_code& error) {
+			if(error) {
+				done(error);
+				return;
+			}
+			std::shared_ptr<boost::asio::deadline_timer> settle(new boost::asio::deadline_timer(io_, 
+						boost::posix_time::milliseconds(100)));
+			settle->async_wait(strand_.wrap([this, serial, settle, rate, hardware_flow, done](
+						const boost::system::error_code& error) {
+				try {
+					hardware_flow_ = serial->configure(rate, hardware_flow);
+					serial_rate_ = rate;
+					serial->flushInput();
+					streambuffer_.consume(streambuffer_.size());
+				}
+				catch(boost::system::system_error& e) {
+					done(e.code());
+					return;
+				}
+				done(error);
+			}));
+		});
+	});
 
 }
-void RigolScope::configureSerial(Baud_rate rate) {
 
-	port_.set_option(boost::asio::serial_port_base::baud_rate((int)rate));
-	port_.set_option(boost::asio::serial_port_base::character_size(8));
-	port_.set_option(boost::asio::serial_port_base::parity(boost::asio::serial_port_base::parity::none));
-	port_.set_option(boost::asio::serial_port_base::stop_bits(boost::asio::serial_port_base::stop_bits::one));
-	port_.set_option(boost::asio::serial_port_base::flow_control(boost::asio::serial_port_base::flow_control::none));
+void RigolScope::asyncWaitOutput(SerialTransport* serial, const boost::posix_time::ptime& deadline, 
+			const Completion& handler) {
+
+	try {
+		if(serial->pendingOutput() == 0) {
+			handler(boost::system::error_code());
+			return;
+		}
+		if(boost::posix_time::microsec_clock::universal_time() >= deadline) {
+			serial->flushOutput();
+			handler(boost::system::error_code());
+			return;
+		}
+	}
+	catch(boost::system::system_error& e) {
+		handler(e.code());
+		return;
+	}
+
+	std::shared_ptr<boost::asio::deadline_timer> timer(new boost::asio::deadline_timer(io_, 
+				boost::posix_time::milliseconds(10)));
+	timer->async_wait(strand_.wrap([this, timer, serial, deadline, handler](const boost::system::error_code&) {
+		asyncWaitOutput(serial, deadline, handler);
+	}));
+
+}
+
+bool RigolScope::verifyLink() {
+
+	// A few tries, the first answer may be cut by the rate change
+	for(int i = 0; i != 3; ++i) {
+		try {
+			if(query("*IDN?") == info_)
+				return true;
+		}
+		catch(timeout_exception) {
+		}
+	}
+	return false;
 
 }
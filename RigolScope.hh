@@ -3,50 +3,51 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <utility>
 #include <boost/asio.hpp>
-
-enum Channel {CH1 = 1, CH2};
-enum Trigger_mode {Edge, Pulse, Video, Slope, Pattern, Duration, Alternation};
-enum Trigger_source {Source_CH1, Source_CH2, Source_Ext, Source_Acline};
-enum Trigger_sweep {Sweep_auto, Sweep_normal, Sweep_single};
-enum Trigger_coupling {Trig_DC, Trig_AC, Trig_HF, Trig_LF};
-enum Trigger_status {Run, Stop, Triggered, Wait, Auto};
-enum Baud_rate {Baud_300 = 300, Baud_2400 = 2400, Baud_4800 = 4800, Baud_9600 = 9600, Baud_19200 = 19200, Baud_38400 = 38400};
+#include <boost/circular_buffer.hpp>
+#include "ScopeTypes.hh"
+#include "ScopeStrings.hh"
+#include "SampleScaler.hh"
+#include "WaveformFrame.hh"
+#include "FrameRing.hh"
+#include "Transport.hh"
+#include "LinkStats.hh"
+#include "ScpiCommand.hh"
+#include "HandlerMemory.hh"
 
 //! \todo{Doxygen spec on exceptions}
-//! \todo{Binary read?}
-//! \todo{USB support}
 //! \todo{Add const everywhere}
 //! \todo{check setTriggerMode() on how to make the functions with strings}
 //! \todo{typedef for trigger modes!!}
-//! \todo{Fix convertexponent for negative numbers!}
 //! \todo{think on this trigger setup}
 
-//! Little helper struct, for mapping strings coming from the scope to ints used inside the code, and vice versa
+//! Little helper struct for a setting cached from the scope. The blocking functions use it on the calling
+//! thread and the jobs on the io thread, so the value and the flag are atomic.
 template <class T>
-struct Bidirectional_map {
+struct Cached_value {
 
-	std::vector<std::string> strings;
+	std::atomic<T> value;
+	std::atomic<bool> valid;
 
-	std::string& operator[](const T& t) {
-		try {
-			return strings.at(t);
-		}
-		catch(std::out_of_range) {
-			strings.push_back("");
-			return strings.back();
-		}
-	}
+	Cached_value() : value(T()), valid(false) {}
 
-	int operator[](std::string string) {
-		for(size_t i = 0; i != strings.size(); ++i) {
-			if(strings[i] == string) return i;
-		}
-		throw std::out_of_range("Value does not exist");
+	void set(const T& t) {
+		value.store(t);
+		valid.store(true);
 	}
 
 };
@@ -58,15 +59,148 @@ public:
 
 };
 
+//! Queue of queries that RigolScope::execute() sends to the scope in a single write. The responses are
+//! converted to the type of the variable given with the query, the variables have to outlive the batch.
+class Query_batch {
+public:
+
+//! Add a query to the batch
+//! @param query Query to send, for example ":TIM:SCAL?"
+//! @param result Variable the response is stored to. Enums are converted from the strings the scope
+//! sends, bools are true for "ON" and "POSITIVE".
+	void add(const std::string& query, float& result) {
+		push(query, Result_float, &result);
+	}
+	void add(const std::string& query, int& result) {
+		push(query, Result_int, &result);
+	}
+	void add(const std::string& query, size_t& result) {
+		push(query, Result_size_t, &result);
+	}
+	void add(const std::string& query, bool& result) {
+		push(query, Result_bool, &result);
+	}
+	void add(const std::string& query, std::string& result) {
+		push(query, Result_string, &result);
+	}
+	void add(const std::string& query, Trigger_mode& result) {
+		push(query, Result_trigger_mode, &result);
+	}
+	void add(const std::string& query, Trigger_source& result) {
+		push(query, Result_trigger_source, &result);
+	}
+	void add(const std::string& query, Trigger_sweep& result) {
+		push(query, Result_trigger_sweep, &result);
+	}
+	void add(const std::string& query, Trigger_coupling& result) {
+		push(query, Result_trigger_coupling, &result);
+	}
+	void add(const std::string& query, Trigger_status& result) {
+		push(query, Result_trigger_status, &result);
+	}
+
+//! @return Amount of queries in the batch
+	size_t size() const {
+		return queries_.size();
+	}
+
+//! Remove all the queries from the batch
+	void clear() {
+		queries_.clear();
+	}
+
+private:
+
+	friend class RigolScope;
+
+	enum Result_type {Result_float, Result_int, Result_size_t, Result_bool, Result_string, Result_trigger_mode, 
+			Result_trigger_source, Result_trigger_sweep, Result_trigger_coupling, Result_trigger_status};
+
+	struct Query {
+		std::string command;
+		Result_type type;
+		void* result;
+	};
+
+	std::vector<Query> queries_;
+
+	void push(const std::string& command, Result_type type, void* result) {
+		Query query = {command, type, result};
+		queries_.push_back(query);
+	}
+
+};
+
+//! Snapshot of the scope settings, see RigolScope::getSettings()
+struct Scope_settings {
+
+	struct Channel_settings {
+		bool enable;
+		size_t mem_depth;
+		float volt_scale;
+		float volt_offset;
+		int attenuation;
+		std::string coupling;
+	};
+
+//! Settings of CH1 and CH2, index with (channel - 1)
+	Channel_settings channel[2];
+	float timescale;
+	float time_offset;
+	bool freq_counter_enable;
+	Trigger_mode trigger_mode;
+//! Trigger source, level, sweep and coupling are the ones of the mode given to getSettings(),
+//! level and sweep are left untouched if the mode has no such setting
+	Trigger_source trigger_source;
+	float trigger_level;
+	Trigger_sweep trigger_sweep;
+	Trigger_coupling trigger_coupling;
+	float trigger_holdoff;
+	Trigger_status trigger_status;
+	bool edge_trigger_slope;
+
+	Scope_settings() : timescale(0.0), time_offset(0.0), freq_counter_enable(false), trigger_mode(Edge), 
+				trigger_source(Source_CH1), trigger_level(0.0), trigger_sweep(Sweep_auto), trigger_coupling(Trig_DC),
+				trigger_holdoff(0.0), trigger_status(Stop), edge_trigger_slope(true) {
+		for(size_t i = 0; i != 2; ++i) {
+			channel[i].enable = false;
+			channel[i].mem_depth = 0;
+			channel[i].volt_scale = 0.0;
+			channel[i].volt_offset = 0.0;
+			channel[i].attenuation = 1;
+		}
+	}
+
+};
+
 //! \note{This class uses enums internally (for sanitizing input and making sure you can't input anything incorrect), 
 //! use getEnumString() functions if you want the enums as strings (for printing in software etc.)}
+//! \note{All communication goes through a queue of operations, so asynchronous operations (asyncGetRawData() for example)
+//! can be started at any time. The blocking functions run the private io_service of the object themselves, or wait
+//! for the threads running the io_service given to the constructor.}
 class RigolScope {
 public:
 
+//! Completion handler of the asynchronous operations, the error is boost::asio::error::timed_out on timeouts
+	typedef std::function<void(const boost::system::error_code&)> Completion;
+
+//! Called while a long frame is read with the amount of samples received so far and the total, return
+//! false to cancel the acquisition. Called from the thread running the io_service.
+	typedef std::function<bool(size_t received, size_t total)> Progress_handler;
+
 //! Constructor for a RigolScope object
-//! @param device Address of the device (ie. "/dev/ttyUSB0" for example)
+//! @param device Address of the device: a serial port ("/dev/ttyUSB0" for example), an usbtmc device
+//! ("/dev/usbtmc0" for example) or a TCP address ("tcp://host:port"), see openTransport()
+//! @param rate Baud rate, only used for serial ports
 	RigolScope(std::string device, Baud_rate rate);
 
+//! Constructor for a RigolScope object communicating through an io_service shared with other objects
+//! \note{io has to be run by other threads, the blocking functions wait for them to complete the operations}
+//! @param io io_service the communication is done on
+//! @param device Address of the device, see RigolScope(std::string device, Baud_rate rate)
+//! @param rate Baud rate, only used for serial ports
+	RigolScope(boost::asio::io_service& io, std::string device, Baud_rate rate);
+
 	~RigolScope();
 
 //! Gets the manufacturer, model number, serial number and the version of the firmware from the scope ("*IDN?" command)
@@ -76,15 +210,140 @@ public:
 //! Reset the scope ("*RST" command)
 	void reset();
 
+//! Forget all the settings cached from the scope. Call this if settings were changed from the front panel,
+//! the cache is invalidated automatically by reset() and setAuto()
+	void invalidateSettings();
+
 //! Put the scope in RUN or STOP mode (":RUN" and ":STOP" commands)
 //! @param val true for RUN and false for STOP
 	void setRun(bool val);
 
 //! Gets raw data from the scope, returns 600 points of data in mode ":WAVEFORM:POINTS:MODE NORMAL"
+//! \note{Volt scale and offset are taken from the settings cache, only the first call queries them from the scope}
 //! @param chan Number of channel (values CH1 or CH2)
 //! @return Scaled data points as volts
 	std::vector<float> getData(Channel chan);
 
+//! Gets 600 points of unscaled 8bit data from the scope, together with the channel and timebase settings
+//! (from the settings cache) needed for scaling it. Use VoltageView for converting the samples to volts.
+//! @param chan Number of channel (values CH1 or CH2)
+//! @param frame Frame to fill, memory of the samples gets reused between calls
+	void getRawData(Channel chan, Waveform_frame& frame);
+
+//! @return The io_service the communication with the scope is done on
+	boost::asio::io_service& getIoService();
+
+//! Asynchronous versions of the getters. They return immediately and take a boost::asio completion token:
+//! a callback (called from the io_service), boost::asio::use_future, or boost::asio::use_awaitable for
+//! co_await in C++20 coroutines. The result is passed as (boost::system::error_code, value), the error is
+//! boost::asio::error::timed_out on timeouts and boost::system::errc::bad_message if the response could not
+//! be converted. The operations are queued and done in order, the io_service has to be run for them to progress.
+
+//! Asynchronous getRawData(), signature void(boost::system::error_code)
+//! @param frame Frame to fill, has to stay valid until the operation completes
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code))
+	asyncGetRawData(Channel chan, Waveform_frame& frame, CompletionToken&& token);
+
+//! Asynchronous getLongRawData(), signature void(boost::system::error_code)
+//! @param frame Frame to fill, has to stay valid until the operation completes
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code))
+	asyncGetLongRawData(Channel chan, Waveform_frame& frame, const Progress_handler& progress,
+				const boost::posix_time::time_duration& trigger_timeout, CompletionToken&& token);
+
+//! Asynchronous getData(), signature void(boost::system::error_code, std::vector<float>)
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, std::vector<float>))
+	asyncGetData(Channel chan, CompletionToken&& token);
+
+//! Asynchronous execute(), signature void(boost::system::error_code)
+//! @param batch Queries to send, the batch and its result variables have to stay valid until the operation completes
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code))
+	asyncExecute(Query_batch& batch, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, std::string))
+	asyncGetInfo(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+	asyncGetVoltScale(Channel chan, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+	asyncGetVoltOffset(Channel chan, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+	asyncGetTimescale(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+	asyncGetTimeOffset(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, size_t))
+	asyncGetMemDepth(Channel chan, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, int))
+	asyncGetAttenuation(Channel chan, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, std::string))
+	asyncGetCoupling(Channel chan, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, bool))
+	asyncGetChannelEnable(Channel chan, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, bool))
+	asyncGetFreqCounterEnable(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+	asyncGetFreqCounterValue(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_mode))
+	asyncGetTriggerMode(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_source))
+	asyncGetTriggerSource(Trigger_mode mode, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+	asyncGetTriggerLevel(Trigger_mode mode, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_sweep))
+	asyncGetTriggerSweep(Trigger_mode mode, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_coupling))
+	asyncGetTriggerCoupling(Trigger_mode mode, CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+	asyncGetTriggerHoldoff(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_status))
+	asyncGetTriggerStatus(CompletionToken&& token);
+
+	template <class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, bool))
+	asyncGetEdgeTriggerSlope(CompletionToken&& token);
+
+//! Gets data from the scope like getData(Channel chan), into a buffer supplied by the caller
+//! @param chan Number of channel (values CH1 or CH2)
+//! @param data Scaled data points as volts, memory of the vector gets reused between calls
+	void getData(Channel chan, std::vector<float>& data);
+
 //! Gets v/div
 //! @param chan Number of channel (values CH1 or CH2)
 //! @return v/div as volts
@@ -252,10 +511,20 @@ public:
 //! @param slope true if the scope triggers on rising edge, and false if the scope triggers on the falling edge
 	void setEdgeTriggerSlope(bool slope);
 
+//! Send all the queries of a batch to the scope in a single write, then read and convert the responses in order
+//! @param batch Queries to send
+	void execute(Query_batch& batch);
+
+//! Get a snapshot of the channel, timebase and trigger settings with one batch of queries, see execute().
+//! Also refreshes the settings cache.
+//! @param mode Trigger mode whose source, level, sweep and coupling are read
+//! @return Settings snapshot
+	Scope_settings getSettings(Trigger_mode mode = Edge);
+
 //! Helper function for converting enums to a string you can print, overloaded for all the enum types used.
-//! \todo{These can be made in some neater way I'm sure, maybe with a template and traits...?}
+//! The strings come from the compile time tables in ScopeStrings.hh, see enumString() and stringEnum().
 //! @param chan Number of channel, values: CH1 or CH2
-//! @return Channel as a string, values: "CH1" or "CH2"
+//! @return Channel as a string, values: "CHAN1" or "CHAN2"
 	std::string getEnumString(Channel chan);
 //! @param mode Trigger mode, values: Edge, Pulse, Video, Slope, Pattern, Duration, Alternation
 //! @return Trigger mode as a string, values: "EDGE", "PULSE", "VIDEO", "SLOPE", "PATTERN", "DURATION", "ALTERNATION"
@@ -273,84 +542,665 @@ public:
 //! @return Trigger status, values: "RUN", "STOP", "T'D", "WAIT", "AUTO"
 	std::string getEnumString(Trigger_status status);
 
-//! Get long data from the channel, 2048 points of data. First acquisition is stopped, then one second wait,
-//! then ":WAVEFORM:POINTS:MODE MAXIMUM" is configured, then acquisition gets started, 
-//! then the function waits for the scope to be triggered and then it retrieves data.
-//! \note{Long mem does NOT work, I have no idea why, it just hangs and does not give a single value}
-//! \note{Trigger has to be in single sweep mode, otherwise you will just get 600 points of data!}
+//! Get the whole acquisition memory of the channel (up to a million points, see getMemDepth()) as raw
+//! samples. If the scope is running, waits up to trigger_timeout for it to stop on its own (a single sweep
+//! getting triggered), then stops it. The trigger status is polled with a delay growing from 10 ms to 500 ms.
+//! The samples are read in chunks, the timeout of every chunk is scaled to its size and the baud rate.
+//! The scope is left stopped.
+//! \note{Throws timeout_exception if the scope does not stop or stops answering, and boost::system::system_error
+//! with boost::asio::error::operation_aborted if progress cancels the acquisition}
 //! @param chan Number of channel (values CH1 or CH2)
-//! @return Scaled data points as volts
-	std::vector<float> getLongData(Channel chan);
+//! @param frame Frame to fill, sample_interval is the one reported by the scope
+//! @param progress Called after every chunk, may cancel the acquisition
+//! @param trigger_timeout How long to wait for the scope to stop on its own
+	void getLongRawData(Channel chan, Waveform_frame& frame, const Progress_handler& progress = Progress_handler(),
+				const boost::posix_time::time_duration& trigger_timeout = boost::posix_time::seconds(0));
 
-//! Function to set the serial speed connection rate
+//! Scaled version of getLongRawData()
+//! @return Scaled data points as volts
+	std::vector<float> getLongData(Channel chan, const Progress_handler& progress = Progress_handler(),
+				const boost::posix_time::time_duration& trigger_timeout = boost::posix_time::seconds(0));
+
+//! Start continuous acquisition on a background thread. The thread gets frames from the channels in turns
+//! with getRawData() and pushes them into ring, until stopStreaming() is called.
+//! \note{No other functions of the scope may be called while streaming}
+//! @param ring Ring the frames are pushed into, has to outlive the streaming
+//! @param channels Channels to acquire (values CH1 and/or CH2)
+	void startStreaming(FrameRing<Waveform_frame>& ring, const std::vector<Channel>& channels);
+
+//! Stop the continuous acquisition and wait for the acquisition thread to finish. If the acquisition
+//! thread stopped because of an error, the error is thrown from here.
+	void stopStreaming();
+
+//! @return true if the acquisition thread is running
+	bool isStreaming() const;
+
+//! @return Amount of frames lost to timeouts while streaming
+	uint64_t getStreamingTimeouts() const;
+
+//! Function to set the serial speed connection rate. The change is verified with *IDN?, if the scope does not
+//! answer at the new rate the old rate is restored.
+//! \note{Throws std::logic_error if the scope is not connected through a serial port, and timeout_exception if
+//! the link could not be restored to the old rate. No other operations should be in progress during the change.}
 //! @param rate Baud rate, accepted values listed in the enum list in the beginning of the class
-//! \todo{Does not work, baud rate change command is not received before set_option modifies serial port buffer contents}
-	void setSerialSpeed(Baud_rate rate);
+//! @param hardware_flow Use RTS/CTS flow control on the computers serial port
+//! @return true if the link works at the new rate, false if the old rate was restored
+	bool setSerialSpeed(Baud_rate rate, bool hardware_flow = false);
+
+//! Function to step the serial speed up to the highest rate the scope and the link sustain, see setSerialSpeed().
+//! RTS/CTS flow control is tried first at the current rate and left off if the link does not work with it.
+//! @param max_rate Highest rate to try
+//! @param hardware_flow Try RTS/CTS flow control
+//! @return The rate in use after the negotiation
+	Baud_rate negotiateSerialSpeed(Baud_rate max_rate = Baud_38400, bool hardware_flow = true);
+
+//! @return Current serial speed
+	Baud_rate getSerialSpeed() const;
+
+//! @return true if RTS/CTS flow control is in use
+	bool getHardwareFlowControl() const;
 
 //! Function to set the serial port timeout
 //! @param t Timeout as a time_duration object, create with "boost::posix_time::seconds(1)" for example
 //! \note{Does not work with timeout as zero, it will hang!}
 	void setSerialTimeout(const boost::posix_time::time_duration& duration);
 
+//! Collect statistics of the link: latency of every command from sending it to the end of its response,
+//! bytes read and written, timeouts and errors. Off by default, the cost when off is a relaxed atomic load
+//! per I/O operation.
+	void setStatisticsEnabled(bool enabled);
+	bool getStatisticsEnabled() const;
+
+//! @return Statistics collected while enabled, see LinkStats::snapshot(), reset() and startDump()
+	LinkStats& getStatistics();
+
+//! Record everything written to and read from the scope with nanosecond timestamps to a trace file, replaces
+//! a running recording. The trace starts with an *IDN? query like the one the constructor sends, so it can be
+//! replayed by opening the scope with the address "replay://<path>" and making the same calls again.
+//! \note{Throws std::runtime_error if the file can not be created}
+//! @param path Path of the trace file, an existing file is overwritten
+	void startRecording(const std::string& path);
+
+//! Stop recording and close the trace file
+	void stopRecording();
+
 private:
 
-	Bidirectional_map<Channel> channel_string_;
-	Bidirectional_map<Trigger_mode> trigger_mode_string_;
-	Bidirectional_map<Trigger_source> trigger_source_string_;
-	Bidirectional_map<Trigger_sweep> trigger_sweep_string_;
-	Bidirectional_map<Trigger_coupling> trigger_coupling_string_;
-	Bidirectional_map<Trigger_status> trigger_status_string_;
 
 	std::string info_;
 
-//! Private variables related to serial port communication
-	enum ReadResult {resultInProgress, resultSuccess, resultError, resultTimeoutExpired };
-	enum ReadResult result_;
-	boost::asio::io_service io_;
-	boost::asio::serial_port port_;
-    boost::asio::deadline_timer timer_;
+//! Private variables related to communication with the scope
+	typedef std::function<void(const Completion&)> Job;
+	std::unique_ptr<boost::asio::io_service> own_io_;
+	boost::asio::io_service& io_;
+	boost::asio::io_service::strand strand_;
+	std::unique_ptr<Transport> transport_;
+	Transport_stream stream_;
+	boost::asio::deadline_timer timer_;
+//! Memory of the handlers in the command path
+	std::shared_ptr<HandlerMemory> handler_memory_;
 	boost::posix_time::time_duration timeout_;
+	bool timed_out_;
+	unsigned operation_id_;
 	boost::asio::streambuf streambuffer_;
-	size_t bytes_transferred_;
+//! Reserved once, the commands and responses reuse the capacity
+	std::string send_buffer_;
+	std::string response_;
+//! Grows when full, a steady stream of jobs reuses the same slots
+	boost::circular_buffer<Job> jobs_;
+	bool job_running_;
+	std::mutex sync_mutex_;
+	std::condition_variable sync_condition_;
 	std::string address_;
+	Baud_rate serial_rate_;
+	bool hardware_flow_;
+	Waveform_frame frame_;
+	SampleScaler scaler_;
+
+//! Settings cache, filled by the getters and invalidated by the setters. The setters do not store
+//! the value they send, as the scope rounds some of them (v/div to 1-2-5 steps for example)
+	Cached_value<float> volt_scale_[2];
+	Cached_value<float> volt_offset_[2];
+	Cached_value<int> attenuation_[2];
+	Cached_value<float> timescale_;
+	Cached_value<float> time_offset_;
+	Cached_value<bool> normal_points_mode_;
+
+//! Link statistics. The command being measured is used only from the strand, it is the last command written
+//! and ends with the last I/O before the next write or the end of the job.
+	LinkStats statistics_;
+	std::atomic<bool> statistics_enabled_;
+	std::unique_ptr<TraceRecorder> recorder_;
+	bool command_open_;
+	std::string command_name_;
+	std::chrono::steady_clock::time_point command_start_;
+	std::chrono::steady_clock::time_point command_end_;
+	boost::system::error_code command_error_;
+
+//! Continuous acquisition
+	std::thread streaming_thread_;
+	std::atomic<bool> streaming_;
+	std::atomic<uint64_t> streaming_timeouts_;
+	std::exception_ptr streaming_error_;
+
+//! Amount of points the scope sends in ":WAVEFORM:POINTS:MODE NORMAL"
+	static const size_t normal_points_ = 600;
+//! Size of the chunks long frames are read in
+	static const size_t chunk_size_ = 16384;
+
+//! Constructor doing the actual work for both of the public constructors
+	RigolScope(std::unique_ptr<boost::asio::io_service> own_io, boost::asio::io_service* io, const std::string& device, 
+			Baud_rate rate);
 
 //! Function for writing to the scope
 //! \note{Appends line end ("\n") to the command automatically}
 //! @param command Command to be sent to the scope
-	void write(std::string command);
+	void write(std::string_view command);
+
+//! Function for reading a line from the scope
+//! @return Response without the line end, valid until the next read() or query() of the calling thread
+	std::string_view read();
+
+//! Function for sending a query and reading the response line, as one operation
+//! @param command Query to be sent to the scope
+//! @return Response without the line end, valid until the next read() or query() of the calling thread
+	std::string_view query(std::string_view command);
+
+//! Function for reading a binary block (for example the ":WAV:DATA?" response) from the scope.
+//! The length is taken from the IEEE-488.2 "#N<length>" header if the scope sends one, otherwise
+//! expected bytes are read. The trailing line end is consumed.
+//! @param data Buffer the block is read into, resized to the block length
+//! @param expected Block length to use if the scope does not send a header
+	void readBlock(std::vector<uint8_t>& data, size_t expected);
+
+//! Internal functions for the operation queue. A job gets started once the previous one has called
+//! the Completion given to it.
+	void enqueue(const Job& job);
+	void startNextJob();
+
+//! Internal function ending the running job and starting the next one
+	void finishJob();
+
+//! Internal function for queueing a job and blocking until it completes
+//! \note{Throws timeout_exception if the job times out, boost::system::system_error on other errors}
+//! @param response If not 0, response_ is copied here when the job succeeds
+	void runSync(const Job& job, std::string* response = 0);
+
+//! Internal functions for measuring the latency of commands, see statistics_
+	void startCommand(std::string_view command);
+	void finishCommand();
+
+//! Internal functions for the timeout of a single read or write. disarmTimer() turns the
+//! operation_aborted error of an operation cancelled by the timer into timed_out.
+	void armTimer();
+	void armTimer(const boost::posix_time::time_duration& timeout);
+//! @return Timeout for transferring bytes, timeout_ plus twice the time the bytes take on a serial line
+	boost::posix_time::time_duration transferTimeout(size_t bytes) const;
+	boost::system::error_code disarmTimer(const boost::system::error_code& error);
+
+//! Internal asynchronous building blocks for the jobs, these have to be called from the strand_ and only
+//! one of them may be in progress at a time. Responses read with asyncReadLine() and asyncQuery() are left
+//! in response_ for the handler.
+	void asyncWrite(std::string_view command, const Completion& handler);
+	void asyncReadLine(const Completion& handler);
+	void asyncReadLines(std::vector<std::string>* responses, size_t count, const Completion& handler);
+	void asyncQuery(std::string_view command, const Completion& handler);
+//! Write command and call handler with the error, for asyncWrite() and asyncQuery(). The handler is kept in
+//! handler_memory_, so it does not have to be turned into an allocated Completion.
+	template <class Handler>
+	void startWrite(std::string_view command, const Handler& handler);
+//! Read a binary block, in chunks if there is a progress handler
+	void asyncReadBlock(std::vector<uint8_t>* data, size_t expected, const Completion& handler,
+				const Progress_handler& progress = Progress_handler());
+	void asyncReadBlockData(std::vector<uint8_t>* data, size_t length, const Completion& handler,
+				const Progress_handler& progress);
+//! Read the rest of data from offset on in chunks. If progress cancels, the rest of the block is read away
+//! by a job put in front of the queue, so the next job gets its own response.
+	void asyncReadChunks(std::vector<uint8_t>* data, size_t offset, const Progress_handler& progress, 
+				const Completion& handler);
+//! Read and throw away size bytes
+	void asyncDiscard(size_t size, const Completion& handler);
+//! Read and throw away whatever arrives until the line has been quiet for 100 ms, then flush the input
+//! of a serial port. Fails with timed_out if the line is still busy at deadline.
+	void asyncDiscardUntilQuiet(const boost::posix_time::ptime& deadline, const Completion& handler);
+//! Make sure there are at least size bytes in the stream buffer
+	void asyncFill(size_t size, const Completion& handler);
+//! Read exactly size bytes, bypassing the stream buffer
+	void asyncReadExactly(uint8_t* data, size_t size, const Completion& handler);
+//! Query a setting unless it is already cached
+	void asyncCachedFloat(std::string_view command, Cached_value<float>* cache, const Completion& handler);
+//! Fill the channel and timebase settings of frame, querying the ones not cached
+	void asyncFrameSettings(Channel chan, Waveform_frame* frame, const Completion& handler);
+//! Acquire a frame, see getRawData()
+	void startRawData(Channel chan, Waveform_frame* frame, const Completion& handler);
+//! Poll the trigger status until the scope is stopped, with a delay doubling up to 500 ms. The scope
+//! is sent :STOP if it has not stopped by deadline.
+	void asyncWaitStop(const boost::posix_time::ptime& deadline, const boost::posix_time::time_duration& delay,
+				bool stop_sent, const Completion& handler);
+//! Poll the output queue of serial until it is empty, discarding what is left at deadline
+	void asyncWaitOutput(SerialTransport* serial, const boost::posix_time::ptime& deadline, const Completion& handler);
+//! Acquire the whole memory, see getLongRawData()
+	void startLongRawData(Channel chan, Waveform_frame* frame, const Progress_handler& progress,
+				const boost::posix_time::time_duration& trigger_timeout, const Completion& handler);
+
+//! Internal function for turning a completion handler of any type into a std::function. The handler is
+//! called through its associated executor (the one of the coroutine for use_awaitable for example).
+	template <class... Args, class Handler>
+	std::function<void(const boost::system::error_code&, Args...)> wrapHandler(Handler&& handler);
+
+//! Internal function for the asynchronous getters, queues query and converts the response with convert
+	template <class T, class CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, T))
+	asyncQueryAs(const ScpiCommand& command, const std::function<T(const std::string&)>& convert, CompletionToken&& token);
+
+//! Internal functions for converting responses in the asynchronous getters, throw std::out_of_range
+	float toFloat(const std::string& response);
+	int toInt(const std::string& response);
+	size_t toSizeT(const std::string& response);
+	bool toBool(const std::string& response);
+
+//! Internal function for storing the responses of a batch into its result variables
+	void convertBatch(Query_batch& batch, const std::vector<std::string>& responses);
+
+//! Function for configuring the (computers) serial interface. Waits until pending output has been sent
+//! and the scope has had time to switch, then discards whatever was received at the old rate. Output that
+//! is not sent in twice its time on the line (held back by a scope not asserting CTS) is discarded.
+//! \note{Throws std::logic_error if the scope is not connected through a serial port}
+//! @param rate Serial port baud rate
+//! @param hardware_flow Use RTS/CTS flow control
+	void configureSerial(Baud_rate rate, bool hardware_flow);
 
-//! Function for reading from the scope
-	std::string read();
+//! @return true if the scope answers *IDN? like it did when connecting
+	bool verifyLink();
 
-//! Internal function for handling asynchronous read timeouts
-//! @param error Error object
-	void timeoutExpired(const boost::system::error_code& error);
+//! Throw away the rest of a response that timed out, so the next command does not read it as its own
+//! \note{Throws timeout_exception if the line does not go quiet}
+	void discardStaleInput();
 
-//! Internal function for handling a completed read
-//! @param error Error object
-//! @param bytesTransferred Amount of bytes transferred
-	void readCompleted(const boost::system::error_code& error, const size_t bytesTransferred);
+//! Internal function run by the acquisition thread while streaming
+	void streamingLoop(FrameRing<Waveform_frame>* ring, std::vector<Channel> channels);
 
-//! Function for configuring the (computers) serial interface
-//! @param rate Serial port baud rate
-	void configureSerial(Baud_rate rate);
+//! Internal functions for getting a setting from the cache, or from the scope if it is not cached
+//! @param chan Number of channel (values CH1 or CH2)
+	float cachedVoltScale(Channel chan);
+	float cachedVoltOffset(Channel chan);
 
 //! Internal function for scaling/formatting the raw data from the scope
-//! @param raw_data Raw data read from the scope as big std::string clump
-//! \todo{Change to a binary data format + binary read}
+//! @param raw_data Raw 8bit samples read from the scope
 //! @param volt_offset Voltage offset of the channel where the data was read from
 //! @param volt_scale v/div of the channel where the data was read from
-//! @return Formatted and scaled data
-	std::vector<float> formatData(std::string raw_data, float volt_offset, float volt_scale);
-
-//! Internal function for converting data from "1.00000e+03" format to a float value
-//! @param decimals Number of decimals in the string format
-//! @return Converted value
-	float convertExponent(std::string number, size_t decimals);
+//! @param data Formatted and scaled data
+	void formatData(const std::vector<uint8_t>& raw_data, float volt_offset, float volt_scale, std::vector<float>& data);
 
 //! Disable copying and assignment
 	RigolScope(const RigolScope&);
 	void operator=(const RigolScope&);
 
 };
+template <class... Args, class Handler>
+std::function<void(const boost::system::error_code&, Args...)> RigolScope::wrapHandler(Handler&& handler) {
+
+	typedef typename std::decay<Handler>::type Handler_type;
+	// Handlers may be move only (use_awaitable), std::function needs something it can copy
+	std::shared_ptr<Handler_type> shared(new Handler_type(std::forward<Handler>(handler)));
+	boost::asio::io_service::executor_type executor = io_.get_executor();
+
+	return [shared, executor](const boost::system::error_code& error, Args... args) {
+		boost::asio::dispatch(boost::asio::get_associated_executor(*shared, executor), [shared, error, args...]() mutable {
+			(*shared)(error, std::move(args)...);
+		});
+	};
+
+}
+
+template <class Handler>
+void RigolScope::startWrite(std::string_view command, const Handler& handler) {
+
+	startCommand(command);
+	send_buffer_.assign(command.data(), command.size());
+	send_buffer_ += '\n';
+
+	armTimer();
+	boost::asio::async_write(stream_, boost::asio::buffer(send_buffer_), strand_.wrap(makePooledHandler(handler_memory_,
+			[this, handler](const boost::system::error_code& error, size_t) {
+		handler(disarmTimer(error));
+	})));
+
+}
+
+template <class T, class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, T))
+RigolScope::asyncQueryAs(const ScpiCommand& command, const std::function<T(const std::string&)>& convert, 
+			CompletionToken&& token) {
+
+	return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code, T)>(
+			[this, command, convert](auto&& handler) {
+		std::function<void(const boost::system::error_code&, T)> wrapped = wrapHandler<T>(std::move(handler));
+		enqueue([this, command, convert, wrapped](const Completion& done) {
+			asyncQuery(command, [this, convert, wrapped, done](const boost::system::error_code& error) {
+				boost::system::error_code result = error;
+				T value = T();
+				if(!result) {
+					try {
+						value = convert(response_);
+					}
+					catch(std::out_of_range) {
+						result = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+					}
+				}
+				done(result);
+				wrapped(result, value);
+			});
+		});
+	}, token);
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code))
+RigolScope::asyncGetRawData(Channel chan, Waveform_frame& frame, CompletionToken&& token) {
+
+	return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			[this, chan, &frame](auto&& handler) {
+		std::function<void(const boost::system::error_code&)> wrapped = wrapHandler<>(std::move(handler));
+		enqueue([this, chan, &frame, wrapped](const Completion& done) {
+			startRawData(chan, &frame, [wrapped, done](const boost::system::error_code& error) {
+				done(error);
+				wrapped(error);
+			});
+		});
+	}, token);
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code))
+RigolScope::asyncGetLongRawData(Channel chan, Waveform_frame& frame, const Progress_handler& progress,
+			const boost::posix_time::time_duration& trigger_timeout, CompletionToken&& token) {
+
+	return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			[this, chan, &frame, progress, trigger_timeout](auto&& handler) {
+		std::function<void(const boost::system::error_code&)> wrapped = wrapHandler<>(std::move(handler));
+		enqueue([this, chan, &frame, progress, trigger_timeout, wrapped](const Completion& done) {
+			startLongRawData(chan, &frame, progress, trigger_timeout, [wrapped, done](const boost::system::error_code& error) {
+				done(error);
+				wrapped(error);
+			});
+		});
+	}, token);
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, std::vector<float>))
+RigolScope::asyncGetData(Channel chan, CompletionToken&& token) {
+
+	return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code, std::vector<float>)>(
+			[this, chan](auto&& handler) {
+		std::function<void(const boost::system::error_code&, std::vector<float>)> wrapped = 
+				wrapHandler<std::vector<float> >(std::move(handler));
+		std::shared_ptr<Waveform_frame> frame(new Waveform_frame);
+		enqueue([this, chan, frame, wrapped](const Completion& done) {
+			startRawData(chan, frame.get(), [frame, wrapped, done](const boost::system::error_code& error) {
+				done(error);
+				std::vector<float> data;
+				if(!error)
+					VoltageView(*frame).convert(data);
+				wrapped(error, std::move(data));
+			});
+		});
+	}, token);
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code))
+RigolScope::asyncExecute(Query_batch& batch, CompletionToken&& token) {
+
+	return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			[this, &batch](auto&& handler) {
+		std::function<void(const boost::system::error_code&)> wrapped = wrapHandler<>(std::move(handler));
+		std::string commands;
+		for(size_t i = 0; i != batch.queries_.size(); ++i)
+			commands += (i != 0 ? "\n" : "") + batch.queries_[i].command;
+		std::shared_ptr<std::vector<std::string> > responses(new std::vector<std::string>);
+
+		enqueue([this, &batch, commands, responses, wrapped](const Completion& done) {
+			Completion converted = [this, &batch, responses, wrapped, done](const boost::system::error_code& error) {
+				boost::system::error_code result = error;
+				if(!result) {
+					try {
+						convertBatch(batch, *responses);
+					}
+					catch(std::out_of_range) {
+						result = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+					}
+				}
+				done(result);
+				wrapped(result);
+			};
+			if(batch.queries_.empty()) {
+				converted(boost::system::error_code());
+				return;
+			}
+			asyncWrite(commands, [this, &batch, responses, converted](const boost::system::error_code& error) {
+				if(error)
+					converted(error);
+				else
+					asyncReadLines(responses.get(), batch.queries_.size(), converted);
+			});
+		});
+	}, token);
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, std::string))
+RigolScope::asyncGetInfo(CompletionToken&& token) {
+
+	return asyncQueryAs<std::string>(ScpiCommand("*IDN?"), [](const std::string& response) { return response; }, 
+			std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+RigolScope::asyncGetVoltScale(Channel chan, CompletionToken&& token) {
+
+	return asyncQueryAs<float>(ScpiCommand(":CHAN", chan, ":SCAL?"), [this, chan](const std::string& response) {
+		float value = toFloat(response);
+		volt_scale_[chan - 1].set(value);
+		return value;
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+RigolScope::asyncGetVoltOffset(Channel chan, CompletionToken&& token) {
+
+	return asyncQueryAs<float>(ScpiCommand(":CHAN", chan, ":OFFS?"), [this, chan](const std::string& response) {
+		float value = toFloat(response);
+		volt_offset_[chan - 1].set(value);
+		return value;
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+RigolScope::asyncGetTimescale(CompletionToken&& token) {
+
+	return asyncQueryAs<float>(ScpiCommand(":TIM:SCAL?"), [this](const std::string& response) {
+		float value = toFloat(response);
+		timescale_.set(value);
+		return value;
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+RigolScope::asyncGetTimeOffset(CompletionToken&& token) {
+
+	return asyncQueryAs<float>(ScpiCommand(":TIM:OFFS?"), [this](const std::string& response) {
+		float value = toFloat(response);
+		time_offset_.set(value);
+		return value;
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, size_t))
+RigolScope::asyncGetMemDepth(Channel chan, CompletionToken&& token) {
+
+	return asyncQueryAs<size_t>(ScpiCommand(":CHAN", chan, ":MEMD?"), [this](const std::string& response) {
+		return toSizeT(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, int))
+RigolScope::asyncGetAttenuation(Channel chan, CompletionToken&& token) {
+
+	return asyncQueryAs<int>(ScpiCommand(":CHAN", chan, ":PROBE?"), [this, chan](const std::string& response) {
+		int value = toInt(response);
+		attenuation_[chan - 1].set(value);
+		return value;
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, std::string))
+RigolScope::asyncGetCoupling(Channel chan, CompletionToken&& token) {
+
+	return asyncQueryAs<std::string>(ScpiCommand(":CHAN", chan, ":COUPLING?"), [](const std::string& response) {
+		return response;
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, bool))
+RigolScope::asyncGetChannelEnable(Channel chan, CompletionToken&& token) {
+
+	return asyncQueryAs<bool>(ScpiCommand(":CHAN", chan, ":DISP?"), [this](const std::string& response) {
+		return toBool(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, bool))
+RigolScope::asyncGetFreqCounterEnable(CompletionToken&& token) {
+
+	return asyncQueryAs<bool>(ScpiCommand(":COUNter:ENABle?"), [this](const std::string& response) {
+		return toBool(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+RigolScope::asyncGetFreqCounterValue(CompletionToken&& token) {
+
+	return asyncQueryAs<float>(ScpiCommand(":COUNter:VALue?"), [this](const std::string& response) {
+		return toFloat(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_mode))
+RigolScope::asyncGetTriggerMode(CompletionToken&& token) {
+
+	return asyncQueryAs<Trigger_mode>(ScpiCommand(":TRIG:MODE?"), [this](const std::string& response) {
+		return stringEnum<Trigger_mode>(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_source))
+RigolScope::asyncGetTriggerSource(Trigger_mode mode, CompletionToken&& token) {
+
+	ScpiCommand command(":TRIG:", enumString(mode), ":SOUR?");
+	return asyncQueryAs<Trigger_source>(command, [this](const std::string& response) {
+		return stringEnum<Trigger_source>(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+RigolScope::asyncGetTriggerLevel(Trigger_mode mode, CompletionToken&& token) {
+
+	if(mode != Edge && mode != Pulse && mode != Video)
+		throw std::out_of_range("Incorrect mode");
+
+	ScpiCommand command(":TRIG:", enumString(mode), ":LEV?");
+	return asyncQueryAs<float>(command, [this](const std::string& response) {
+		return toFloat(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_sweep))
+RigolScope::asyncGetTriggerSweep(Trigger_mode mode, CompletionToken&& token) {
+
+	if(mode == Video || mode == Alternation)
+		throw std::out_of_range("Value out of range");
+
+	ScpiCommand command(":TRIG:", enumString(mode), ":SWE?");
+	return asyncQueryAs<Trigger_sweep>(command, [this](const std::string& response) {
+		return stringEnum<Trigger_sweep>(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_coupling))
+RigolScope::asyncGetTriggerCoupling(Trigger_mode mode, CompletionToken&& token) {
+
+	ScpiCommand command(":TRIG:", enumString(mode), ":COUP?");
+	return asyncQueryAs<Trigger_coupling>(command, [this](const std::string& response) {
+		return stringEnum<Trigger_coupling>(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, float))
+RigolScope::asyncGetTriggerHoldoff(CompletionToken&& token) {
+
+	return asyncQueryAs<float>(ScpiCommand(":TRIG:HOLD?"), [this](const std::string& response) {
+		return toFloat(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, Trigger_status))
+RigolScope::asyncGetTriggerStatus(CompletionToken&& token) {
+
+	return asyncQueryAs<Trigger_status>(ScpiCommand(":TRIG:STATUS?"), [this](const std::string& response) {
+		return stringEnum<Trigger_status>(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
+template <class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, bool))
+RigolScope::asyncGetEdgeTriggerSlope(CompletionToken&& token) {
+
+	return asyncQueryAs<bool>(ScpiCommand(":TRIG:EDGE:SLOP?"), [this](const std::string& response) {
+		return toBool(response);
+	}, std::forward<CompletionToken>(token));
+
+}
+
 #endif
@@ -0,0 +1,42 @@
+#include <vector>
+#include "SampleScaler.hh"
+
+SampleScaler::SampleScaler() : volt_offset_(0.0), volt_scale_(0.0), valid_(false) {
+
+}
+
+void SampleScaler::configure(float volt_offset, float volt_scale) {
+
+	if(valid_ && volt_offset == volt_offset_ && volt_scale == volt_scale_)
+		return;
+
+	for(int i = 0; i != 256; ++i)
+		table_[i] = toVolts(i, volt_offset, volt_scale);
+
+	volt_offset_ = volt_offset;
+	volt_scale_ = volt_scale;
+	valid_ = true;
+
+}
+
+void SampleScaler::convert(const uint8_t* raw, size_t size, float* data) const {
+
+	size_t i = 0;
+	for(; i + 4 <= size; i += 4) {
+		data[i] = table_[raw[i]];
+		data[i + 1] = table_[raw[i + 1]];
+		data[i + 2] = table_[raw[i + 2]];
+		data[i + 3] = table_[raw[i + 3]];
+	}
+	for(; i != size; ++i)
+		data[i] = table_[raw[i]];
+
+}
+
+void SampleScaler::convert(const std::vector<uint8_t>& raw, std::vector<float>& data) const {
+
+	data.resize(raw.size());
+	if(!raw.empty())
+		convert(raw.data(), raw.size(), data.data());
+
+}
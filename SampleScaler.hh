@@ -0,0 +1,69 @@
+#ifndef SAMPLESCALER_HH
+#define SAMPLESCALER_HH
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Converts raw 8bit samples from the scope to volts. All 256 possible sample values are converted once
+//! into a lookup table when the volt offset or scale changes, after that conversion is a table lookup per sample.
+//! The static functions are the scaling itself, everything converting between raw values and volts uses them.
+class SampleScaler {
+public:
+
+	SampleScaler();
+
+//! Scaling as volts = gain*raw + zero, for fractional raw values (averages for example). The scope sends the
+//! samples upside down, a bigger raw value is a smaller voltage so the gain is negative.
+//! @param volt_offset Voltage offset of the channel
+//! @param volt_scale v/div of the channel
+	static double gain(float volt_scale) {
+		return -volt_scale/25.0;
+	}
+
+	static double zero(float volt_offset, float volt_scale) {
+		return 125*volt_scale/25.0 - volt_offset;
+	}
+
+//! @return Voltage of a raw value
+	static double toVolts(double raw, float volt_offset, float volt_scale) {
+		return gain(volt_scale)*raw + zero(volt_offset, volt_scale);
+	}
+
+//! @return Raw value of a voltage, neither rounded nor limited to the range of the samples
+	static double toRaw(double volts, float volt_offset, float volt_scale) {
+		return (volts - zero(volt_offset, volt_scale))/gain(volt_scale);
+	}
+
+//! Set the channel settings the samples were acquired with, rebuilds the lookup table if they changed
+//! @param volt_offset Voltage offset of the channel
+//! @param volt_scale v/div of the channel
+	void configure(float volt_offset, float volt_scale);
+
+//! Convert samples to volts
+//! @param raw Raw samples from the scope
+//! @param size Amount of samples
+//! @param data Output buffer, has to have room for size values
+	void convert(const uint8_t* raw, size_t size, float* data) const;
+
+//! Convert samples to volts
+//! @param raw Raw samples from the scope
+//! @param data Output buffer, resized to the amount of samples (memory gets reused if it is big enough)
+	void convert(const std::vector<uint8_t>& raw, std::vector<float>& data) const;
+
+//! Convert a single sample to volts
+//! @param sample Raw sample from the scope
+//! @return Sample as volts
+	float operator()(uint8_t sample) const {
+		return table_[sample];
+	}
+
+private:
+
+	float table_[256];
+	float volt_offset_;
+	float volt_scale_;
+	bool valid_;
+
+};
+#endif
@@ -0,0 +1,566 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <boost/system/system_error.hpp>
+#include "ScpiNumber.hh"
+#include "ScopeEmulator.hh"
+
+namespace {
+
+//! Points sent in :WAV:POIN:MODE NOR, and while running in the other modes
+const size_t normal_points = 600;
+
+void throwErrno(const char* what) {
+
+	throw boost::system::system_error(errno, boost::system::system_category(), what);
+
+}
+
+//! @return Baud rate of a termios speed, 0 if it is not one the scope has
+unsigned termiosBaud(speed_t speed) {
+
+	switch(speed) {
+	case B300: return 300;
+	case B2400: return 2400;
+	case B4800: return 4800;
+	case B9600: return 9600;
+	case B19200: return 19200;
+	case B38400: return 38400;
+	default: return 0;
+	}
+
+}
+
+bool scopeBaud(size_t rate) {
+
+	return rate == 300 || rate == 2400 || rate == 4800 || rate == 9600 || rate == 19200 || rate == 38400;
+
+}
+
+std::string format(const char* format, double value) {
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), format, value);
+	return buffer;
+
+}
+
+//! @param phase Position in the period, 0 to 1
+//! @return Value of a shape of amplitude 1 peak to peak, rising through 0 at phase 0
+double shapeValue(Emulator_shape shape, double phase) {
+
+	switch(shape) {
+	case Shape_sine:
+		return 0.5*sin(2*M_PI*phase);
+	case Shape_square:
+		return phase < 0.5 ? 0.5 : -0.5;
+	case Shape_triangle:
+		return phase < 0.25 ? 2*phase : phase < 0.75 ? 1 - 2*phase : 2*phase - 2;
+	case Shape_sawtooth:
+		return phase < 0.5 ? phase : phase - 1;
+	default:
+		return 0.0;
+	}
+
+}
+
+}
+
+ScopeEmulator::ScopeEmulator(const Emulator_config& config) : master_(-1), slave_(-1), listener_(-1), config_(config), sent_(0),
+			sending_(false), baud_(config.baud), running_(true), random_(config.seed), commands_(0), bytes_in_(0),
+			bytes_out_(0) {
+
+	wake_[0] = wake_[1] = -1;
+	signals_[0] = config.signals[0];
+	signals_[1] = config.signals[1];
+	for(std::set<std::string>::const_iterator i = config.silent.begin(); i != config.silent.end(); ++i)
+		silent_.insert(shortHeader(*i));
+	reset();
+
+	if(config_.tcp)
+		openListener();
+	else {
+		master_ = posix_openpt(O_RDWR | O_NOCTTY);
+		if(master_ < 0)
+			throwErrno("posix_openpt");
+		if(grantpt(master_) != 0 || unlockpt(master_) != 0 || !ptsname(master_)) {
+			::close(master_);
+			throwErrno("unlockpt");
+		}
+		device_ = ptsname(master_);
+
+		slave_ = ::open(device_.c_str(), O_RDWR | O_NOCTTY);
+		termios settings;
+		if(slave_ < 0 || tcgetattr(slave_, &settings) != 0) {
+			::close(master_);
+			throwErrno("open");
+		}
+		cfmakeraw(&settings);
+		cfsetspeed(&settings, B9600);
+		tcsetattr(slave_, TCSANOW, &settings);
+		fcntl(master_, F_SETFL, fcntl(master_, F_GETFL) | O_NONBLOCK);
+	}
+
+	if(pipe(wake_) != 0) {
+		::close(slave_);
+		::close(master_);
+		::close(listener_);
+		throwErrno("pipe");
+	}
+
+}
+
+ScopeEmulator::~ScopeEmulator() {
+
+	stop();
+	::close(wake_[0]);
+	::close(wake_[1]);
+	::close(slave_);
+	::close(master_);
+	::close(listener_);
+
+}
+
+const std::string& ScopeEmulator::getDevice() const {
+
+	return device_;
+
+}
+
+void ScopeEmulator::start() {
+
+	if(thread_.joinable())
+		return;
+
+	// Drain a wake up left by an earlier stop()
+	char byte;
+	fcntl(wake_[0], F_SETFL, fcntl(wake_[0], F_GETFL) | O_NONBLOCK);
+	while(::read(wake_[0], &byte, 1) == 1);
+
+	thread_ = std::thread([this]() {
+		run();
+	});
+
+}
+
+void ScopeEmulator::stop() {
+
+	if(!thread_.joinable())
+		return;
+
+	char byte = 0;
+	while(::write(wake_[1], &byte, 1) < 0 && errno == EINTR);
+	thread_.join();
+
+}
+
+void ScopeEmulator::setSignal(Channel chan, const Emulator_signal& signal) {
+
+	std::lock_guard<std::mutex> lock(signal_mutex_);
+	signals_[chan - 1] = signal;
+
+}
+
+uint64_t ScopeEmulator::getCommands() const {
+
+	return commands_.load(std::memory_order_relaxed);
+
+}
+
+uint64_t ScopeEmulator::getBytesIn() const {
+
+	return bytes_in_.load(std::memory_order_relaxed);
+
+}
+
+uint64_t ScopeEmulator::getBytesOut() const {
+
+	return bytes_out_.load(std::memory_order_relaxed);
+
+}
+
+std::string ScopeEmulator::shortHeader(const std::string& header) {
+
+	std::string result;
+	size_t i = 0;
+	while(i != header.size()) {
+		if(header[i] == ':' || header[i] == '*' || header[i] == '?') {
+			result += header[i++];
+			continue;
+		}
+
+		size_t end = std::min(header.find_first_of(":*?", i), header.size());
+		std::string node = header.substr(i, end - i);
+		for(char& c : node)
+			c = toupper(c);
+
+		// The short form is the first four letters, or three if the fourth is a vowel. A numeric suffix
+		// ("CHANNEL1") is kept.
+		size_t letters = node.find_last_not_of("0123456789") + 1;
+		std::string name = node.substr(0, letters);
+		if(name.size() > 4)
+			name.resize(strchr("AEIOU", name[3]) ? 3 : 4);
+		result += name + node.substr(letters);
+		i = end;
+	}
+	return result;
+
+}
+
+void ScopeEmulator::reset() {
+
+	settings_.clear();
+	for(int chan = 1; chan <= 2; ++chan) {
+		std::string prefix = ":CHAN" + std::to_string(chan);
+		settings_[prefix + ":SCAL"] = "1.000e+00";
+		settings_[prefix + ":OFFS"] = "0.000e+00";
+		settings_[prefix + ":PROB"] = "1.000e+00";
+		settings_[prefix + ":MEMD"] = std::to_string(config_.memory_depth);
+		settings_[prefix + ":DISP"] = chan == 1 ? "ON" : "OFF";
+		settings_[prefix + ":COUP"] = "DC";
+	}
+	settings_[":TIM:SCAL"] = "1.000e-03";
+	settings_[":TIM:OFFS"] = "0.000e+00";
+	settings_[":TRIG:MODE"] = "EDGE";
+	settings_[":TRIG:HOLD"] = "5.000e-07";
+	settings_[":TRIG:EDGE:SOUR"] = "CH1";
+	settings_[":TRIG:EDGE:LEV"] = "0.000e+00";
+	settings_[":TRIG:EDGE:SWE"] = "AUTO";
+	settings_[":TRIG:EDGE:COUP"] = "DC";
+	settings_[":TRIG:EDGE:SLOP"] = "POSITIVE";
+	settings_[":COUN:ENAB"] = "OFF";
+	settings_[":WAV:POIN:MODE"] = "NOR";
+	settings_[":KEY:LOCK"] = "DISABLE";
+	running_ = true;
+
+}
+
+void ScopeEmulator::run() {
+
+	char buffer[4096];
+	while(true) {
+		Clock::time_point now = Clock::now();
+		bool blocked = false;
+		int timeout = master_ >= 0 ? transmit(now, blocked) : -1;
+
+		// In the TCP mode only the listening socket is waited on while no client is connected
+		int fd = master_ >= 0 ? master_ : listener_;
+		pollfd fds[2] = {{fd, (short)(POLLIN | (blocked ? POLLOUT : 0)), 0}, {wake_[0], POLLIN, 0}};
+		if(poll(fds, 2, blocked ? -1 : timeout) < 0) {
+			if(errno == EINTR)
+				continue;
+			return;
+		}
+		if(fds[1].revents)
+			return;
+
+		if(master_ < 0) {
+			if(fds[0].revents & POLLIN)
+				accept();
+			continue;
+		}
+
+		if(fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			ssize_t size = ::read(master_, buffer, sizeof(buffer));
+			if(size > 0) {
+				bytes_in_.fetch_add(size, std::memory_order_relaxed);
+				receive(buffer, size, Clock::now());
+			}
+			else if(listener_ >= 0 && (size == 0 || (errno != EAGAIN && errno != EINTR)))
+				disconnect();
+		}
+	}
+
+}
+
+void ScopeEmulator::openListener() {
+
+	listener_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(listener_ < 0)
+		throwErrno("socket");
+
+	int reuse = 1;
+	setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(config_.tcp_port);
+	socklen_t length = sizeof(address);
+	if(bind(listener_, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener_, 1) != 0 || 
+				getsockname(listener_, (sockaddr*)&address, &length) != 0) {
+		::close(listener_);
+		throwErrno("bind");
+	}
+	device_ = "tcp://127.0.0.1:" + std::to_string(ntohs(address.sin_port));
+
+}
+
+void ScopeEmulator::accept() {
+
+	master_ = accept4(listener_, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if(master_ < 0)
+		return;
+	// Answers go out as soon as they are due, like the bytes of a serial line
+	int no_delay = 1;
+	setsockopt(master_, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+}
+
+void ScopeEmulator::disconnect() {
+
+	// The settings stay, like those of a scope whose bridge lost the connection
+	::close(master_);
+	master_ = -1;
+	input_.clear();
+	output_.clear();
+	sent_ = 0;
+	sending_ = false;
+
+}
+
+void ScopeEmulator::receive(const char* data, size_t size, Clock::time_point now) {
+
+	input_.append(data, size);
+
+	size_t begin = 0;
+	size_t end;
+	while((end = input_.find('\n', begin)) != std::string::npos) {
+		std::string line = input_.substr(begin, end - begin);
+		begin = end + 1;
+		if(!line.empty() && line[line.size() - 1] == '\r')
+			line.resize(line.size() - 1);
+
+		// The bytes of the command took this long to arrive over the serial line
+		Clock::time_point ready = now;
+		if(config_.pace && baud_)
+			ready += std::chrono::microseconds((line.size() + 1)*10*1000000/baud_);
+
+		// A scope at a different rate than the computer receives garbage, except for the command changing the
+		// rate that was sent before the computer switched
+		if(config_.check_line_rate && shortHeader(line.substr(0, line.find(' '))) != ":RS232:BAUD") {
+			termios settings;
+			if(tcgetattr(slave_, &settings) == 0 && termiosBaud(cfgetospeed(&settings)) != baud_)
+				continue;
+		}
+
+		size_t start = 0;
+		while(start <= line.size()) {
+			size_t separator = std::min(line.find(';', start), line.size());
+			std::string command = line.substr(start, separator - start);
+			start = separator + 1;
+			if(command.empty())
+				continue;
+			commands_.fetch_add(1, std::memory_order_relaxed);
+			execute(command, ready);
+		}
+	}
+	input_.erase(0, begin);
+
+}
+
+void ScopeEmulator::execute(const std::string& command, Clock::time_point ready) {
+
+	size_t space = command.find(' ');
+	std::string header = shortHeader(command.substr(0, space));
+	std::string argument = space == std::string::npos ? std::string() : command.substr(space + 1);
+	for(char& c : argument)
+		c = toupper(c);
+
+	if(silent_.count(header))
+		return;
+
+	Clock::time_point response = ready + config_.latency;
+
+	if(header == "*IDN?")
+		respond(config_.identity, response);
+	else if(header == "*RST")
+		reset();
+	else if(header == ":RUN") {
+		running_ = true;
+		run_started_ = ready;
+	}
+	else if(header == ":STOP")
+		running_ = false;
+	else if(header == ":TRIG:STAT?")
+		respond(triggerStatus(ready), response);
+	else if(header == ":RS232:BAUD") {
+		size_t rate;
+		if(parseScpiNumber(argument.data(), argument.data() + argument.size(), rate) && scopeBaud(rate) &&
+					rate <= config_.max_baud)
+			baud_ = rate;
+	}
+	else if(header == ":ACQ:SAMP?")
+		respond(format("%.6e", sampleRate()), response);
+	else if(header == ":COUN:VAL?") {
+		std::lock_guard<std::mutex> lock(signal_mutex_);
+		respond(format("%.5e", signals_[0].frequency), response);
+	}
+	else if(header == ":WAV:DATA?") {
+		Channel chan = argument == "CHAN2" || argument == "CHANNEL2" ? CH2 : CH1;
+		bool normal = settings_[":WAV:POIN:MODE"].compare(0, 3, "NOR") == 0 || running_;
+		size_t points = normal ? normal_points : config_.memory_depth;
+		double interval = normal ? setting(":TIM:SCAL")*12/points : 1/sampleRate();
+
+		char length[16];
+		snprintf(length, sizeof(length), "#8%08zu", points);
+		std::string block = length;
+		waveform(chan, points, interval, block);
+		respond(block, ready + config_.data_latency);
+	}
+	else if(!header.empty() && header[header.size() - 1] == '?') {
+		std::map<std::string, std::string>::const_iterator value = settings_.find(header.substr(0, header.size() - 1));
+		// A real scope does not answer unknown queries either
+		if(value != settings_.end())
+			respond(value->second, response);
+	}
+	else if(!argument.empty()) {
+		// Numbers are reported back in the format of the scope, except for the integer settings
+		double number;
+		bool integer = header.size() > 5 && header.compare(header.size() - 5, 5, ":MEMD") == 0;
+		if(!integer && parseScpiNumber(argument.data(), argument.data() + argument.size(), number))
+			settings_[header] = format("%.3e", number);
+		else
+			settings_[header] = argument;
+	}
+
+}
+
+void ScopeEmulator::respond(const std::string& data, Clock::time_point ready) {
+
+	Response response;
+	response.data = data + "\n";
+	response.ready = ready;
+	output_.push_back(response);
+
+}
+
+int ScopeEmulator::transmit(Clock::time_point now, bool& blocked) {
+
+	// Bytes per second on the line, 8 data bits and a start and stop bit each
+	double rate = config_.pace ? baud_/10.0 : 0.0;
+
+	while(!output_.empty()) {
+		Response& response = output_.front();
+		if(!sending_) {
+			send_start_ = rate > 0 ? std::max(response.ready, line_free_) : response.ready;
+			sending_ = true;
+		}
+		if(now < send_start_)
+			return std::chrono::duration_cast<std::chrono::milliseconds>(send_start_ - now).count() + 1;
+
+		size_t due = response.data.size();
+		if(rate > 0)
+			due = std::min(due, (size_t)(std::chrono::duration<double>(now - send_start_).count()*rate) + 1);
+
+		if(due > sent_) {
+			// A client that went away must not raise SIGPIPE, it is noticed by the next read
+			ssize_t written = listener_ >= 0 ? send(master_, response.data.data() + sent_, due - sent_, MSG_NOSIGNAL) :
+						::write(master_, response.data.data() + sent_, due - sent_);
+			if(written < 0 && errno != EAGAIN && errno != EINTR)
+				return -1;
+			if(written > 0) {
+				sent_ += written;
+				bytes_out_.fetch_add(written, std::memory_order_relaxed);
+			}
+			if(sent_ != due) {
+				blocked = true;
+				return -1;
+			}
+		}
+
+		if(sent_ != response.data.size()) {
+			Clock::time_point next = send_start_ + std::chrono::duration_cast<Clock::duration>(
+						std::chrono::duration<double>(sent_/rate));
+			return std::max<long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count());
+		}
+
+		if(rate > 0)
+			line_free_ = send_start_ + std::chrono::duration_cast<Clock::duration>(
+						std::chrono::duration<double>(response.data.size()/rate));
+		output_.pop_front();
+		sent_ = 0;
+		sending_ = false;
+	}
+	return -1;
+
+}
+
+std::string ScopeEmulator::triggerStatus(Clock::time_point now) {
+
+	if(!running_)
+		return "STOP";
+
+	std::string sweep = settings_[shortHeader(":TRIG:" + settings_[":TRIG:MODE"] + ":SWE")];
+	if(sweep.compare(0, 4, "SING") != 0)
+		return sweep.compare(0, 4, "AUTO") == 0 ? "AUTO" : "T'D";
+	if(now - run_started_ < config_.acquisition_time)
+		return "WAIT";
+	running_ = false;
+	return "STOP";
+
+}
+
+double ScopeEmulator::sampleRate() const {
+
+	// The long memory covers the screen, up to the 1 GSa/s of the scope
+	return std::min(1e9, config_.memory_depth/(setting(":TIM:SCAL")*12));
+
+}
+
+void ScopeEmulator::waveform(Channel chan, size_t points, double interval, std::string& block) {
+
+	Emulator_signal signal;
+	{
+		std::lock_guard<std::mutex> lock(signal_mutex_);
+		signal = signals_[chan - 1];
+	}
+
+	std::string prefix = ":CHAN" + std::to_string((int)chan);
+	double scale = setting(prefix + ":SCAL");
+	double offset = setting(prefix + ":OFFS");
+	double time_offset = setting(":TIM:OFFS");
+	if(scale <= 0)
+		scale = 1.0;
+	std::normal_distribution<double> noise(0.0, signal.noise > 0 ? signal.noise : 1.0);
+
+	// The trigger point is in the middle of the memory, the raw value 125 is the center of the screen
+	// and a division is 25 values
+	size_t start = block.size();
+	block.resize(start + points);
+	for(size_t i = 0; i != points; ++i) {
+		double time = ((double)i - points/2.0)*interval + time_offset;
+		double phase = time*signal.frequency;
+		double volts = signal.offset + signal.amplitude*shapeValue(signal.shape, phase - floor(phase));
+		if(signal.noise > 0)
+			volts += noise(random_);
+		long raw = lround(125 - (volts + offset)*25/scale);
+		block[start + i] = (char)std::max(0L, std::min(255L, raw));
+	}
+
+}
+
+double ScopeEmulator::setting(const std::string& header) const {
+
+	std::map<std::string, std::string>::const_iterator value = settings_.find(header);
+	double result;
+	if(value == settings_.end() || !parseScpiNumber(value->second.data(), value->second.data() + value->second.size(),
+				result))
+		return 0.0;
+	return result;
+
+}
@@ -0,0 +1,196 @@
+#ifndef SCOPEEMULATOR_HH
+#define SCOPEEMULATOR_HH
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stddef.h>
+#include <stdint.h>
+#include "ScopeTypes.hh"
+
+enum Emulator_shape {Shape_sine, Shape_square, Shape_triangle, Shape_sawtooth, Shape_dc};
+
+//! Signal connected to an input of the emulated scope
+struct Emulator_signal {
+
+	Emulator_shape shape;
+//! Hz
+	double frequency;
+//! Peak to peak volts
+	double amplitude;
+//! DC level in volts
+	double offset;
+//! RMS volts of gaussian noise added to every sample
+	double noise;
+
+	Emulator_signal() : shape(Shape_sine), frequency(1000.0), amplitude(2.0), offset(0.0), noise(0.0) {}
+
+};
+
+//! Behaviour of a ScopeEmulator
+struct Emulator_config {
+
+//! Response to *IDN?
+	std::string identity;
+//! Baud rate the scope starts at, :RS232:BAUD changes it
+	unsigned baud;
+//! Pace the bytes at baud/10 per second (8N1) in both directions, otherwise responses are sent as fast as the
+//! pty takes them
+	bool pace;
+//! :RS232:BAUD above this rate is ignored, like a cable that does not work at higher rates
+	unsigned max_baud;
+//! Drop commands received while the baud rate of the pty differs from the rate of the scope, like a scope
+//! receiving garbage on a mismatched serial link
+	bool check_line_rate;
+//! Time from receiving a query to starting the response
+	std::chrono::microseconds latency;
+//! Time from receiving :WAV:DATA? to starting the block, instead of latency
+	std::chrono::microseconds data_latency;
+//! Time a single sweep started by :RUN takes to trigger and stop
+	std::chrono::microseconds acquisition_time;
+//! Memory depth reported by :CHAN<n>:MEMD? and sent in :WAV:POIN:MODE MAX or RAW when stopped
+	size_t memory_depth;
+//! Headers of queries that are never answered, for provoking timeouts. For example ":COUNter:VALue?"
+	std::set<std::string> silent;
+	Emulator_signal signals[2];
+//! Seed of the noise
+	unsigned seed;
+//! Listen for a TCP connection on 127.0.0.1 instead of opening a pseudo terminal, like a scope behind a serial
+//! to ethernet bridge. One client is served at a time, the next one can connect once it has disconnected.
+	bool tcp;
+//! Port to listen on with tcp, 0 for any free port
+	unsigned short tcp_port;
+
+	Emulator_config() : identity("Rigol Technologies,DS1102CD,EMULATOR,00.02.06"), baud(9600), pace(true), max_baud(38400),
+				check_line_rate(false), latency(0), data_latency(0), acquisition_time(0), memory_depth(16384), seed(1),
+				tcp(false), tcp_port(0) {}
+
+};
+
+//! Emulates a DS1000 series scope on a Linux pseudo terminal, for running RigolScope without hardware. The
+//! emulator speaks the SCPI subset RigolScope uses: the settings are kept and reported back, :WAV:DATA? sends
+//! blocks of synthetic waveforms scaled with the channel settings, and :RUN / :STOP / :TRIG:STATUS? follow the
+//! trigger sweep. Responses are paced at the baud rate after the configured latency, so the throughput and
+//! timeouts seen by RigolScope are those of a real serial link.
+//! The emulator runs on a thread of its own, open getDevice() as a serial port to talk to it, or connect to it
+//! with RigolScope when it listens on TCP (see Emulator_config::tcp).
+class ScopeEmulator {
+public:
+
+//! Opens the pseudo terminal, or the listening socket with Emulator_config::tcp
+//! \note{Throws boost::system::system_error if the pseudo terminal or the socket can not be opened}
+	explicit ScopeEmulator(const Emulator_config& config = Emulator_config());
+
+//! Stops the emulator
+	~ScopeEmulator();
+
+//! @return Address of the serial port of the emulator, "/dev/pts/3" for example, or "tcp://127.0.0.1:<port>"
+//! when it listens on TCP
+	const std::string& getDevice() const;
+
+//! Start answering commands from a thread of the emulator
+	void start();
+	void stop();
+
+//! Change the signal connected to an input, takes effect from the next waveform sent
+	void setSignal(Channel chan, const Emulator_signal& signal);
+
+//! @return Amount of commands received
+	uint64_t getCommands() const;
+	uint64_t getBytesIn() const;
+	uint64_t getBytesOut() const;
+
+//! Short form of a SCPI header in upper case, the form the settings are kept in: ":TIMebase:SCALe?" gives
+//! ":TIM:SCAL?" and ":CHANnel1:COUPling" ":CHAN1:COUP"
+	static std::string shortHeader(const std::string& header);
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Response {
+
+		std::string data;
+//! Earliest time to start sending
+		Clock::time_point ready;
+
+	};
+
+//! Pseudo terminal master, or the connected client with tcp (-1 while none is connected)
+	int master_;
+//! Kept open so the master does not hang up while no client has the device open
+	int slave_;
+//! Listening socket with tcp
+	int listener_;
+//! Written to by stop() to wake up the thread
+	int wake_[2];
+	std::string device_;
+	Emulator_config config_;
+	std::thread thread_;
+
+	std::mutex signal_mutex_;
+	Emulator_signal signals_[2];
+
+//! State used only by the thread of the emulator
+	std::map<std::string, std::string> settings_;
+	std::set<std::string> silent_;
+	std::string input_;
+	std::deque<Response> output_;
+	size_t sent_;
+	bool sending_;
+//! Time the first byte of the response in front of output_ is sent at
+	Clock::time_point send_start_;
+//! Time the line is free after the responses sent so far
+	Clock::time_point line_free_;
+	unsigned baud_;
+	bool running_;
+	Clock::time_point run_started_;
+	std::mt19937 random_;
+
+	std::atomic<uint64_t> commands_;
+	std::atomic<uint64_t> bytes_in_;
+	std::atomic<uint64_t> bytes_out_;
+
+	void reset();
+	void run();
+
+//! Internal functions for the TCP mode
+	void openListener();
+	void accept();
+	void disconnect();
+
+//! Internal function for handling received bytes
+	void receive(const char* data, size_t size, Clock::time_point now);
+	void execute(const std::string& command, Clock::time_point ready);
+	void respond(const std::string& data, Clock::time_point ready);
+
+//! Internal function for writing the bytes of the responses that are due
+//! @param blocked Set if the pty or the socket did not take all the bytes due
+//! @return Milliseconds to the next byte due, -1 if nothing is left to send
+	int transmit(Clock::time_point now, bool& blocked);
+
+//! @return Trigger status, a single sweep that has had time to trigger stops here
+	std::string triggerStatus(Clock::time_point now);
+
+//! @return Sample rate of the long memory of the current timebase
+	double sampleRate() const;
+
+//! Internal function for generating the raw samples of a channel
+	void waveform(Channel chan, size_t points, double interval, std::string& block);
+
+	double setting(const std::string& header) const;
+
+//! Disable copying and assignment
+	ScopeEmulator(const ScopeEmulator&);
+	void operator=(const ScopeEmulator&);
+
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include "ScopeManager.hh"
+
+namespace {
+
+//! State shared by the acquisitions of one ScopeManager::asyncAcquire() call
+struct Acquire_state {
+	Frame_set set;
+	std::atomic<size_t> remaining;
+	ScopeManager::Frame_set_handler handler;
+};
+
+}
+
+ScopeManager::ScopeManager(size_t threads) : work_(new boost::asio::io_service::work(io_)) {
+
+	if(threads == 0)
+		throw std::invalid_argument("At least one worker thread is needed");
+
+	for(size_t i = 0; i != threads; ++i)
+		threads_.push_back(std::thread([this]() { io_.run(); }));
+
+}
+
+ScopeManager::~ScopeManager() {
+
+	work_.reset();
+	io_.stop();
+	for(size_t i = 0; i != threads_.size(); ++i)
+		threads_[i].join();
+	scopes_.clear();
+
+}
+
+size_t ScopeManager::addScope(const std::string& device, Baud_rate rate) {
+
+	scopes_.push_back(std::unique_ptr<RigolScope>(new RigolScope(io_, device, rate)));
+	return scopes_.size() - 1;
+
+}
+
+RigolScope& ScopeManager::getScope(size_t index) {
+
+	return *scopes_.at(index);
+
+}
+
+size_t ScopeManager::getScopeCount() const {
+
+	return scopes_.size();
+
+}
+
+void ScopeManager::asyncAcquire(const std::vector<Acquisition>& acquisitions, const Frame_set_handler& handler) {
+
+	for(size_t i = 0; i != acquisitions.size(); ++i) {
+		if(acquisitions[i].scope >= scopes_.size())
+			throw std::out_of_range("No such scope");
+	}
+
+	std::shared_ptr<Acquire_state> state(new Acquire_state);
+	state->set.frames.resize(acquisitions.size());
+	state->set.errors.resize(acquisitions.size());
+	state->remaining = acquisitions.size();
+	state->handler = handler;
+	state->set.start = std::chrono::system_clock::now();
+
+	if(acquisitions.empty()) {
+		io_.post([state]() { state->handler(state->set); });
+		return;
+	}
+
+	for(size_t i = 0; i != acquisitions.size(); ++i) {
+		scopes_[acquisitions[i].scope]->asyncGetRawData(acquisitions[i].chan, state->set.frames[i], 
+				[state, i](const boost::system::error_code& error) {
+			state->set.errors[i] = error;
+			if(--state->remaining != 0)
+				return;
+
+			// Last acquisition to complete, all the frames are in place
+			Frame_set& set = state->set;
+			std::chrono::system_clock::time_point first = std::chrono::system_clock::time_point::max();
+			std::chrono::system_clock::time_point last = std::chrono::system_clock::time_point::min();
+			for(size_t j = 0; j != set.frames.size(); ++j) {
+				if(set.errors[j])
+					continue;
+				first = std::min(first, set.frames[j].timestamp);
+				last = std::max(last, set.frames[j].timestamp);
+			}
+			if(first <= last)
+				set.spread = last - first;
+			state->handler(set);
+		});
+	}
+
+}
+
+Frame_set ScopeManager::acquire(const std::vector<Acquisition>& acquisitions) {
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool done = false;
+	Frame_set result;
+
+	asyncAcquire(acquisitions, [&](const Frame_set& set) {
+		std::lock_guard<std::mutex> lock(mutex);
+		result = set;
+		done = true;
+		condition.notify_all();
+	});
+
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [&done]() { return done; });
+	return result;
+
+}
+
+std::vector<Acquisition> ScopeManager::allScopes(const std::vector<Channel>& channels) const {
+
+	std::vector<Acquisition> acquisitions;
+	for(size_t i = 0; i != scopes_.size(); ++i) {
+		for(size_t j = 0; j != channels.size(); ++j) {
+			Acquisition acquisition = {i, channels[j]};
+			acquisitions.push_back(acquisition);
+		}
+	}
+	return acquisitions;
+
+}
+
+boost::asio::io_service& ScopeManager::getIoService() {
+
+	return io_;
+
+}
@@ -0,0 +1,93 @@
+#ifndef SCOPEMANAGER_HH
+#define SCOPEMANAGER_HH
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <boost/asio.hpp>
+#include "RigolScope.hh"
+
+//! One acquisition of a ScopeManager::acquire() call, channel chan of the scope with index scope
+struct Acquisition {
+	size_t scope;
+	Channel chan;
+};
+
+//! Frames acquired by one ScopeManager::acquire() call, in the order of the acquisitions
+struct Frame_set {
+
+	std::vector<Waveform_frame> frames;
+//! Error of every acquisition, frames with an error are not valid
+	std::vector<boost::system::error_code> errors;
+//! Time when the acquisitions were started
+	std::chrono::system_clock::time_point start;
+//! Time between the earliest and the latest frame of the set
+	std::chrono::system_clock::duration spread;
+
+	Frame_set() : spread(0) {}
+
+};
+
+//! Runs several scopes on a shared io_service and a pool of worker threads, so acquisitions from all of them
+//! can be done at the same time without a thread per scope. Operations on one scope are done in order,
+//! operations on different scopes run concurrently.
+class ScopeManager {
+public:
+
+	typedef std::function<void(const Frame_set&)> Frame_set_handler;
+
+//! @param threads Amount of worker threads running the io_service
+	explicit ScopeManager(size_t threads = 2);
+
+//! Stops the worker threads, pending operations are abandoned
+	~ScopeManager();
+
+//! Open a scope on the shared io_service
+//! @param device Address of the device, see RigolScope(std::string device, Baud_rate rate)
+//! @param rate Baud rate, only used for serial ports
+//! @return Index of the scope
+	size_t addScope(const std::string& device, Baud_rate rate);
+
+//! @param index Index of the scope, as returned by addScope()
+//! @return The scope, its blocking functions can be used from any thread except the worker threads
+	RigolScope& getScope(size_t index);
+
+//! @return Amount of scopes
+	size_t getScopeCount() const;
+
+//! Start acquisitions on all the scopes at once, returns immediately. Every scope acquires its channels in order.
+//! @param acquisitions Channels to acquire
+//! @param handler Called from a worker thread with the frames once all the acquisitions have completed
+	void asyncAcquire(const std::vector<Acquisition>& acquisitions, const Frame_set_handler& handler);
+
+//! Blocking version of asyncAcquire()
+//! \note{Deadlocks if called from a worker thread (from a Frame_set_handler for example), the acquisitions are
+//! completed by the worker threads}
+//! @param acquisitions Channels to acquire
+//! @return Acquired frames
+	Frame_set acquire(const std::vector<Acquisition>& acquisitions);
+
+//! Acquisitions for the given channels of all the scopes
+//! @param channels Channels to acquire from every scope
+//! @return Acquisitions for acquire() and asyncAcquire()
+	std::vector<Acquisition> allScopes(const std::vector<Channel>& channels) const;
+
+//! @return The shared io_service
+	boost::asio::io_service& getIoService();
+
+private:
+
+	boost::asio::io_service io_;
+	std::unique_ptr<boost::asio::io_service::work> work_;
+	std::vector<std::thread> threads_;
+	std::vector<std::unique_ptr<RigolScope> > scopes_;
+
+//! Disable copying and assignment
+	ScopeManager(const ScopeManager&);
+	void operator=(const ScopeManager&);
+
+};
+#endif
@@ -0,0 +1,163 @@
+#ifndef SCOPESTRINGS_HH
+#define SCOPESTRINGS_HH
+
+#include <array>
+#include <string_view>
+#include <stdexcept>
+#include <stddef.h>
+#include <stdint.h>
+#include "ScopeTypes.hh"
+
+//! Compile time tables mapping the enums to the strings the scope uses and back. Enum to string is a
+//! scan of a handful of entries that the compiler folds for constant values. String to enum goes through
+//! a perfect hash searched at compile time, so it costs one hash of the response and a single compare.
+
+//! One enum value and its SCPI string
+template <class T>
+struct Enum_entry {
+
+	T value;
+	std::string_view string;
+
+};
+
+//! Hash used for the reverse lookup, FNV-1a with the seed as the offset basis. The high bits are folded
+//! down as the low bits of FNV-1a only depend on the low bits of the seed.
+constexpr uint32_t enumHash(std::string_view string, uint32_t seed) {
+
+	uint32_t hash = seed;
+	for(size_t i = 0; i != string.size(); ++i)
+		hash = (hash ^ (uint8_t)string[i])*16777619u;
+	return hash ^ (hash >> 16);
+
+}
+
+//! @return Amount of hash slots for n entries, a power of two at least twice n
+constexpr size_t enumSlots(size_t n) {
+
+	size_t slots = 1;
+	while(slots < 2*n)
+		slots *= 2;
+	return slots;
+
+}
+
+template <class T, size_t N>
+struct Enum_table {
+
+	static constexpr size_t slots = enumSlots(N);
+	static constexpr uint8_t empty = 0xff;
+
+	std::array<Enum_entry<T>, N> entries;
+	uint32_t seed;
+//! Index of the entry hashing to each slot, or empty
+	std::array<uint8_t, slots> index;
+
+//! @return The string of value, empty if value is not in the table
+	constexpr std::string_view toString(T value) const {
+		for(size_t i = 0; i != N; ++i)
+			if(entries[i].value == value)
+				return entries[i].string;
+		return std::string_view();
+	}
+
+//! @param string String to look up
+//! @param value Matching enum value, not modified if there is no match
+//! @return false if the string is not in the table
+	constexpr bool fromString(std::string_view string, T& value) const {
+		uint8_t i = index[enumHash(string, seed) & (slots - 1)];
+		if(i == empty || entries[i].string != string)
+			return false;
+		value = entries[i].value;
+		return true;
+	}
+
+};
+
+//! Build a table, searching for a seed that puts every string in its own slot
+template <class T, size_t N>
+constexpr Enum_table<T, N> makeEnumTable(const Enum_entry<T> (&entries)[N]) {
+
+	Enum_table<T, N> table = {};
+	for(size_t i = 0; i != N; ++i)
+		table.entries[i] = entries[i];
+
+	for(uint32_t seed = 2166136261u; ; ++seed) {
+		for(size_t slot = 0; slot != table.slots; ++slot)
+			table.index[slot] = table.empty;
+		bool collision = false;
+		for(size_t i = 0; i != N && !collision; ++i) {
+			size_t slot = enumHash(entries[i].string, seed) & (table.slots - 1);
+			if(table.index[slot] != table.empty)
+				collision = true;
+			else
+				table.index[slot] = i;
+		}
+		if(!collision) {
+			table.seed = seed;
+			return table;
+		}
+	}
+
+}
+
+//! The table of each enum type, specialized below
+template <class T>
+struct Enum_strings;
+
+template <>
+struct Enum_strings<Channel> {
+	static constexpr auto table = makeEnumTable<Channel>({{CH1, "CHAN1"}, {CH2, "CHAN2"}});
+};
+
+template <>
+struct Enum_strings<Trigger_mode> {
+	static constexpr auto table = makeEnumTable<Trigger_mode>({{Edge, "EDGE"}, {Pulse, "PULSE"}, {Video, "VIDEO"},
+			{Slope, "SLOPE"}, {Pattern, "PATTERN"}, {Duration, "DURATION"}, {Alternation, "ALTERNATION"}});
+};
+
+template <>
+struct Enum_strings<Trigger_source> {
+	static constexpr auto table = makeEnumTable<Trigger_source>({{Source_CH1, "CH1"}, {Source_CH2, "CH2"},
+			{Source_Ext, "EXT"}, {Source_Acline, "ACLINE"}});
+};
+
+template <>
+struct Enum_strings<Trigger_sweep> {
+	static constexpr auto table = makeEnumTable<Trigger_sweep>({{Sweep_auto, "AUTO"}, {Sweep_normal, "NORMAL"},
+			{Sweep_single, "SINGLE"}});
+};
+
+template <>
+struct Enum_strings<Trigger_coupling> {
+	static constexpr auto table = makeEnumTable<Trigger_coupling>({{Trig_DC, "DC"}, {Trig_AC, "AC"}, {Trig_HF, "HF"},
+			{Trig_LF, "LF"}});
+};
+
+template <>
+struct Enum_strings<Trigger_status> {
+	static constexpr auto table = makeEnumTable<Trigger_status>({{Run, "RUN"}, {Stop, "STOP"}, {Triggered, "T'D"},
+			{Wait, "WAIT"}, {Auto, "AUTO"}});
+};
+
+//! @return SCPI string of an enum value, empty if the value is not valid
+template <class T>
+constexpr std::string_view enumString(T value) {
+
+	return Enum_strings<T>::table.toString(value);
+
+}
+
+//! @return Enum value of a SCPI string
+//! \note{Throws std::out_of_range if the string does not match any value}
+template <class T>
+T stringEnum(std::string_view string) {
+
+	T value;
+	if(!Enum_strings<T>::table.fromString(string, value))
+		throw std::out_of_range("Value does not exist");
+	return value;
+
+}
+
+#endif
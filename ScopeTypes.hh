@@ -0,0 +1,11 @@
+#ifndef SCOPETYPES_HH
+#define SCOPETYPES_HH
+
+enum Channel {CH1 = 1, CH2};
+enum Trigger_mode {Edge, Pulse, Video, Slope, Pattern, Duration, Alternation};
+enum Trigger_source {Source_CH1, Source_CH2, Source_Ext, Source_Acline};
+enum Trigger_sweep {Sweep_auto, Sweep_normal, Sweep_single};
+enum Trigger_coupling {Trig_DC, Trig_AC, Trig_HF, Trig_LF};
+enum Trigger_status {Run, Stop, Triggered, Wait, Auto};
+enum Baud_rate {Baud_300 = 300, Baud_2400 = 2400, Baud_4800 = 4800, Baud_9600 = 9600, Baud_19200 = 19200, Baud_38400 = 38400};
+#endif
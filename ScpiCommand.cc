@@ -0,0 +1,61 @@
+#include <charconv>
+#include <stdexcept>
+#include <string.h>
+#include "ScpiCommand.hh"
+
+ScpiCommand& ScpiCommand::append(std::string_view text) {
+
+	if(text.size() > capacity_ - size_)
+		throw std::length_error("SCPI command too long");
+	memcpy(buffer_ + size_, text.data(), text.size());
+	size_ += text.size();
+	return *this;
+
+}
+
+ScpiCommand& ScpiCommand::append(int value) {
+
+	return appendNumber(value);
+
+}
+
+ScpiCommand& ScpiCommand::append(long value) {
+
+	return appendNumber(value);
+
+}
+
+ScpiCommand& ScpiCommand::append(unsigned value) {
+
+	return appendNumber(value);
+
+}
+
+ScpiCommand& ScpiCommand::append(unsigned long value) {
+
+	return appendNumber(value);
+
+}
+
+ScpiCommand& ScpiCommand::append(double value) {
+
+	// %g with the default precision of std::ostream, so the commands are the same as the ones built with streams
+	std::to_chars_result result = std::to_chars(buffer_ + size_, buffer_ + capacity_, value,
+				std::chars_format::general, 6);
+	if(result.ec != std::errc())
+		throw std::length_error("SCPI command too long");
+	size_ = result.ptr - buffer_;
+	return *this;
+
+}
+
+template <class T>
+ScpiCommand& ScpiCommand::appendNumber(T value) {
+
+	std::to_chars_result result = std::to_chars(buffer_ + size_, buffer_ + capacity_, value);
+	if(result.ec != std::errc())
+		throw std::length_error("SCPI command too long");
+	size_ = result.ptr - buffer_;
+	return *this;
+
+}
@@ -0,0 +1,49 @@
+#ifndef SCPICOMMAND_HH
+#define SCPICOMMAND_HH
+
+#include <string_view>
+#include <stddef.h>
+
+//! A command for the scope built in a fixed buffer, with the numbers formatted in place. Nothing is allocated,
+//! so a command costs no more than copying its parts:
+//!   ScpiCommand(":CHAN", chan, ":SCAL ", scale) gives ":CHAN1:SCAL 0.5"
+//! Text is copied as is, integers and enums are written in decimal and floating point numbers like
+//! std::ostream writes them (six significant digits).
+class ScpiCommand {
+public:
+
+//! \note{Throws std::length_error if the parts do not fit in capacity_ characters}
+	template <class... Parts>
+	explicit ScpiCommand(const Parts&... parts) : size_(0) {
+		(append(parts), ...);
+	}
+
+	ScpiCommand& append(std::string_view text);
+	ScpiCommand& append(int value);
+	ScpiCommand& append(long value);
+	ScpiCommand& append(unsigned value);
+	ScpiCommand& append(unsigned long value);
+	ScpiCommand& append(double value);
+
+	std::string_view view() const {
+		return std::string_view(buffer_, size_);
+	}
+
+	operator std::string_view() const {
+		return view();
+	}
+
+private:
+
+//! Longest command sent to the scope is well below this
+	static const size_t capacity_ = 96;
+
+	char buffer_[capacity_];
+	size_t size_;
+
+	template <class T>
+	ScpiCommand& appendNumber(T value);
+
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include <string>
+#include <stdexcept>
+#include <charconv>
+#include <math.h>
+#include "ScpiNumber.hh"
+
+namespace {
+
+inline bool isSpace(char c) {
+
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+
+}
+
+//! Strip whitespace and the plus sign std::from_chars does not accept. A plus sign
+//! followed by a minus sign is left for from_chars to reject.
+inline bool trim(const char*& begin, const char*& end) {
+
+	while(begin != end && isSpace(*begin))
+		++begin;
+	while(end != begin && isSpace(*(end - 1)))
+		--end;
+	if(begin != end && *begin == '+' && end - begin > 1 && *(begin + 1) != '-')
+		++begin;
+	return begin != end;
+
+}
+
+}
+
+bool parseScpiNumber(const char* begin, const char* end, double& value) {
+
+	if(!trim(begin, end))
+		return false;
+
+	double result;
+	std::from_chars_result parsed = std::from_chars(begin, end, result, std::chars_format::general);
+	if(parsed.ec != std::errc() || parsed.ptr != end)
+		return false;
+
+	value = result;
+	return true;
+
+}
+
+bool parseScpiNumber(const char* begin, const char* end, size_t& value) {
+
+	if(!trim(begin, end))
+		return false;
+
+	size_t result;
+	std::from_chars_result parsed = std::from_chars(begin, end, result);
+	if(parsed.ec == std::errc() && parsed.ptr == end) {
+		value = result;
+		return true;
+	}
+
+	// The scope answers some integer queries in NR3 form
+	double real;
+	if(!parseScpiNumber(begin, end, real) || real < 0 || real != floor(real) || real >= 18446744073709551616.0)
+		return false;
+
+	value = (size_t)real;
+	return true;
+
+}
+
+double scpiToDouble(std::string_view response) {
+
+	double value;
+	if(!parseScpiNumber(response.data(), response.data() + response.size(), value))
+		throw std::out_of_range("Not a number: " + std::string(response));
+	return value;
+
+}
+
+float scpiToFloat(std::string_view response) {
+
+	return scpiToDouble(response);
+
+}
+
+size_t scpiToSizeT(std::string_view response) {
+
+	size_t value;
+	if(!parseScpiNumber(response.data(), response.data() + response.size(), value))
+		throw std::out_of_range("Not a number: " + std::string(response));
+	return value;
+
+}
@@ -0,0 +1,28 @@
+#ifndef SCPINUMBER_HH
+#define SCPINUMBER_HH
+
+#include <string>
+#include <string_view>
+#include <stddef.h>
+
+//! Parsers for numeric responses of the scope. All SCPI forms are accepted: NR1 ("16384", "-3"),
+//! NR2 ("-1.20", "+.5") and NR3 ("1.000e+03", "5.0E-7", exponents of any width). Leading and trailing
+//! whitespace (the line end of the response for example) is skipped, anything else makes the parse fail.
+//! Nothing is allocated, the text is parsed in place.
+
+//! @param begin First character of the response
+//! @param end One past the last character of the response
+//! @param value Parsed value, not modified if parsing fails
+//! @return false if the response is not a number
+bool parseScpiNumber(const char* begin, const char* end, double& value);
+
+//! Same as above, for unsigned integers. NR2 and NR3 responses are accepted if they have an integer value.
+bool parseScpiNumber(const char* begin, const char* end, size_t& value);
+
+//! Convert a response to a number
+//! \note{Throws std::out_of_range if the response is not a number}
+double scpiToDouble(std::string_view response);
+float scpiToFloat(std::string_view response);
+size_t scpiToSizeT(std::string_view response);
+
+#endif
@@ -0,0 +1,250 @@
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "SoftwareTrigger.hh"
+
+namespace {
+
+//! Raw value range [low, high], the condition is met by samples inside it, or outside it if inside is false
+struct Band {
+
+	int low;
+	int high;
+	bool inside;
+
+	bool contains(uint8_t sample) const {
+		return (sample >= low && sample <= high) == inside;
+	}
+
+};
+
+//! Converts levels of a frame to raw value limits. The scope sends the samples upside down, a bigger raw value
+//! is a smaller voltage.
+class Raw_levels {
+public:
+
+	explicit Raw_levels(const Waveform_frame& frame) : volt_offset_(frame.volt_offset), volt_scale_(frame.volt_scale) {}
+
+//! @return Biggest raw value at or above volts
+	int atOrAbove(double volts) const {
+		return clamp(floor(SampleScaler::toRaw(volts, volt_offset_, volt_scale_)));
+	}
+
+//! @return Smallest raw value at or below volts
+	int atOrBelow(double volts) const {
+		return clamp(ceil(SampleScaler::toRaw(volts, volt_offset_, volt_scale_)));
+	}
+
+//! Samples at or past level in the direction of an edge, at or above for rising, at or below for falling
+	Band past(double volts, bool rising) const {
+		if(rising)
+			return Band{0, atOrAbove(volts), true};
+		return Band{atOrBelow(volts), 255, true};
+	}
+
+//! Samples not yet at level in the direction of an edge, below for rising, above for falling
+	Band before(double volts, bool rising) const {
+		Band band = past(volts, rising);
+		band.inside = false;
+		return band;
+	}
+
+private:
+
+//! Values beyond the raw range stay one past it so the comparisons keep working
+	static int clamp(double value) {
+		return std::min(256.0, std::max(-1.0, value));
+	}
+
+	float volt_offset_;
+	float volt_scale_;
+
+};
+
+inline size_t find(const uint8_t* samples, size_t begin, size_t end, const Band& band) {
+
+	return findRawRange(samples, begin, end, band.low, band.high, band.inside);
+
+}
+
+//! A negative hysteresis makes the arm band overlap the band that fires, the sample of an edge would arm and
+//! fire again without the search moving on
+const Soft_trigger& checked(const Soft_trigger& trigger) {
+
+	if(!(trigger.hysteresis >= 0))
+		throw std::invalid_argument("Trigger hysteresis has to be zero or positive");
+	return trigger;
+
+}
+
+}
+
+size_t findRawRange(const uint8_t* samples, size_t begin, size_t end, int low, int high, bool inside) {
+
+	low = std::max(low, 0);
+	high = std::min(high, 255);
+	if(begin >= end)
+		return end;
+	if(low > high)
+		return inside ? end : begin;
+
+	size_t i = begin;
+#ifdef __SSE2__
+	// Unsigned range check with min/max since SSE2 only has signed byte comparisons
+	__m128i lower = _mm_set1_epi8((char)low);
+	__m128i upper = _mm_set1_epi8((char)high);
+	int flip = inside ? 0 : 0xffff;
+	for(; i + 16 <= end; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(samples + i));
+		__m128i in = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, lower), x), _mm_cmpeq_epi8(_mm_min_epu8(x, upper), x));
+		int mask = _mm_movemask_epi8(in) ^ flip;
+		if(mask)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for(; i != end; ++i)
+		if((samples[i] >= low && samples[i] <= high) == inside)
+			return i;
+	return end;
+
+}
+
+SoftwareTrigger::SoftwareTrigger(const Soft_trigger& trigger) : trigger_(checked(trigger)) {
+
+}
+
+void SoftwareTrigger::setTrigger(const Soft_trigger& trigger) {
+
+	trigger_ = checked(trigger);
+
+}
+
+const Soft_trigger& SoftwareTrigger::getTrigger() const {
+
+	return trigger_;
+
+}
+
+size_t SoftwareTrigger::scan(const Waveform_frame& frame, std::vector<Trigger_event>& events, size_t index) const {
+
+	if(frame.channel != trigger_.source || frame.samples.empty())
+		return 0;
+	if(!(frame.volt_scale > 0))
+		throw std::invalid_argument("Frame has no volt scale");
+
+	const uint8_t* samples = frame.samples.data();
+	size_t size = frame.samples.size();
+	double interval = frame.sample_interval;
+	size_t holdoff = interval > 0 ? ceil(trigger_.holdoff/interval) : 0;
+	size_t found = 0;
+
+	auto emit = [&](size_t sample, size_t begin) -> size_t {
+		Trigger_event event;
+		event.type = trigger_.type;
+		event.channel = frame.channel;
+		event.frame = index;
+		event.sample = sample;
+		event.begin = begin;
+		event.width = (sample - begin)*interval;
+		event.time = (sample - 0.5*size)*interval + frame.time_offset;
+		event.timestamp = frame.timestamp + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+					std::chrono::duration<double>(sample*interval));
+		events.push_back(event);
+		++found;
+		// The search goes on after the holdoff, conditions met during it are ignored
+		return sample + holdoff;
+	};
+
+	Raw_levels levels(frame);
+	bool rising = trigger_.rising;
+	double hysteresis = rising ? -trigger_.hysteresis : trigger_.hysteresis;
+	size_t position = 0;
+
+	switch(trigger_.type) {
+		case Soft_edge: {
+			Band arm = levels.before(trigger_.level + hysteresis, rising);
+			Band fire = levels.past(trigger_.level, rising);
+			while(true) {
+				size_t armed = find(samples, position, size, arm);
+				size_t edge = find(samples, armed, size, fire);
+				if(edge == size)
+					break;
+				position = emit(edge, edge);
+			}
+			break;
+		}
+		case Soft_pulse: {
+			Band arm = levels.before(trigger_.level + hysteresis, rising);
+			Band start = levels.past(trigger_.level, rising);
+			Band stop = levels.before(trigger_.level, rising);
+			while(true) {
+				size_t armed = find(samples, position, size, arm);
+				size_t begin = find(samples, armed, size, start);
+				size_t end = find(samples, begin, size, stop);
+				if(end == size)
+					break;
+				double width = (end - begin)*interval;
+				if((trigger_.min_width <= 0 || width >= trigger_.min_width) &&
+							(trigger_.max_width <= 0 || width <= trigger_.max_width))
+					position = emit(end, begin);
+				else
+					position = end;
+			}
+			break;
+		}
+		case Soft_runt: {
+			// A positive runt rises over the lower level and falls back under it without reaching the upper
+			// level, a negative one falls under the upper level and rises back over it without reaching the lower
+			double from = rising ? trigger_.level : trigger_.upper_level;
+			double to = rising ? trigger_.upper_level : trigger_.level;
+			Band arm = levels.before(from, rising);
+			Band start = levels.past(from, rising);
+			Band reached = levels.past(to, rising);
+			// Either back before the first level or past the second one
+			Band decided = rising ? Band{reached.high + 1, arm.high, false} : Band{arm.low, reached.low - 1, false};
+			while(true) {
+				size_t armed = find(samples, position, size, arm);
+				size_t begin = find(samples, armed, size, start);
+				size_t end = find(samples, begin, size, decided);
+				if(end == size)
+					break;
+				if(arm.contains(samples[end]))
+					position = emit(end, begin);
+				else
+					position = end;
+			}
+			break;
+		}
+		case Soft_window: {
+			Band inside = {levels.atOrBelow(trigger_.upper_level), levels.atOrAbove(trigger_.level), true};
+			Band outside = {inside.low, inside.high, false};
+			// Rising is entering the window, otherwise leaving it
+			Band arm = rising ? outside : inside;
+			Band fire = rising ? inside : outside;
+			while(true) {
+				size_t armed = find(samples, position, size, arm);
+				size_t crossing = find(samples, armed, size, fire);
+				if(crossing == size)
+					break;
+				position = emit(crossing, crossing);
+			}
+			break;
+		}
+	}
+
+	return found;
+
+}
+
+size_t SoftwareTrigger::scan(const std::vector<Waveform_frame>& frames, std::vector<Trigger_event>& events) const {
+
+	size_t found = 0;
+	for(size_t i = 0; i != frames.size(); ++i)
+		found += scan(frames[i], events, i);
+	return found;
+
+}
@@ -0,0 +1,99 @@
+#ifndef SOFTWARETRIGGER_HH
+#define SOFTWARETRIGGER_HH
+
+#include <vector>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include "WaveformFrame.hh"
+
+enum Soft_trigger_type {Soft_edge, Soft_pulse, Soft_runt, Soft_window};
+
+//! Condition searched by SoftwareTrigger. Levels are in volts, times in seconds.
+struct Soft_trigger {
+
+	Soft_trigger_type type;
+//! Only frames of this channel are searched
+	Channel source;
+//! Edge: rising or falling edge. Pulse and runt: positive or negative pulse. Window: entering or leaving the window.
+	bool rising;
+//! Edge and pulse: the level crossed. Runt and window: the lower level.
+	float level;
+//! Runt and window: the upper level
+	float upper_level;
+//! Edge and pulse: how far the signal has to go back over the level before the next edge counts, rejects noise.
+//! Zero or positive.
+	float hysteresis;
+//! Pulse: shortest width that triggers, 0 for no limit
+	double min_width;
+//! Pulse: longest width that triggers, 0 for no limit
+	double max_width;
+//! Minimum time from one event to the next in the same frame
+	double holdoff;
+
+	Soft_trigger() : type(Soft_edge), source(CH1), rising(true), level(0.0), upper_level(0.0), hysteresis(0.0),
+				min_width(0.0), max_width(0.0), holdoff(0.0) {}
+
+};
+
+//! Place in a frame where the trigger condition was met
+struct Trigger_event {
+
+	Soft_trigger_type type;
+	Channel channel;
+//! Index of the frame in the frames searched
+	size_t frame;
+//! First sample meeting the condition: the sample after the edge, the end of the pulse or runt, or the
+//! first sample inside or outside the window
+	size_t sample;
+//! First sample of the pulse or runt, the same as sample for edges and windows
+	size_t begin;
+//! Width of the pulse or runt in seconds, 0 for edges and windows
+	double width;
+//! Time of sample relative to the trigger point of the frame (the middle of the screen) in seconds
+	double time;
+//! Time of sample, counting the frame timestamp as the time of its first sample
+	std::chrono::system_clock::time_point timestamp;
+
+};
+
+//! Searches frames for trigger conditions on the host, so the condition can be changed without reconfiguring
+//! the scope. The levels are converted to raw sample values once per frame and the samples are searched as raw
+//! bytes 16 at a time with SSE2 for the next sample changing the state of the condition. The state starts
+//! over in every frame since consecutive frames are not continuous.
+class SoftwareTrigger {
+public:
+
+//! \note{Throws std::invalid_argument if the hysteresis of trigger is negative}
+	explicit SoftwareTrigger(const Soft_trigger& trigger = Soft_trigger());
+
+//! \note{Throws std::invalid_argument if the hysteresis of trigger is negative}
+	void setTrigger(const Soft_trigger& trigger);
+	const Soft_trigger& getTrigger() const;
+
+//! Search a frame, frames of other channels than the source are skipped
+//! \note{Throws std::invalid_argument if the volt scale of the frame is not positive}
+//! @param frame Frame to search
+//! @param events Events found are appended here
+//! @param index Index of the frame stored in the events
+//! @return Amount of events found
+	size_t scan(const Waveform_frame& frame, std::vector<Trigger_event>& events, size_t index = 0) const;
+
+//! Search many frames, see scan() above
+//! @param frames Frames to search, the index of a frame in the vector is stored in its events
+//! @param events Events found are appended here
+//! @return Amount of events found
+	size_t scan(const std::vector<Waveform_frame>& frames, std::vector<Trigger_event>& events) const;
+
+private:
+
+	Soft_trigger trigger_;
+
+};
+
+//! Index of the first sample in [begin, end) inside (or outside) the raw value range [low, high]
+//! @param inside Search for a sample inside the range if true, outside it if false
+//! @return end if there is no such sample
+size_t findRawRange(const uint8_t* samples, size_t begin, size_t end, int low, int high, bool inside);
+
+#endif
@@ -0,0 +1,276 @@
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <math.h>
+#include "Spectrum.hh"
+
+namespace {
+
+//! Power below this is shown as -200 dBV instead of -inf
+const float power_floor = 1e-20f;
+
+//! a*b without the NaN handling of std::complex multiplication
+inline std::complex<float> multiply(const std::complex<float>& a, const std::complex<float>& b) {
+
+	return std::complex<float>(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+
+}
+
+double windowCoefficient(Fft_window window, size_t i, size_t size) {
+
+	// Periodic windows, the coefficient after the last sample would be the first one
+	double phase = 2*M_PI*i/size;
+	switch(window) {
+		case Window_hann:
+			return 0.5 - 0.5*cos(phase);
+		case Window_blackman:
+			return 0.42 - 0.5*cos(phase) + 0.08*cos(2*phase);
+		case Window_flat_top:
+			return 0.21557895 - 0.41663158*cos(phase) + 0.277263158*cos(2*phase) - 0.083578947*cos(3*phase) +
+						0.006947368*cos(4*phase);
+		default:
+			return 1.0;
+	}
+
+}
+
+}
+
+std::shared_ptr<const FftPlan> FftPlan::get(size_t size) {
+
+	if(size < 2 || (size & (size - 1)) != 0)
+		throw std::invalid_argument("FFT length has to be a power of two");
+
+	static std::mutex mutex;
+	static std::map<size_t, std::shared_ptr<const FftPlan> > plans;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<const FftPlan>& plan = plans[size];
+	if(!plan)
+		plan.reset(new FftPlan(size));
+	return plan;
+
+}
+
+FftPlan::FftPlan(size_t size) : size_(size), reversed_(size/2), twiddles_(size/2) {
+
+	size_t half = size/2;
+	unsigned bits = 0;
+	while(((size_t)1 << bits) < half)
+		++bits;
+	for(size_t i = 0; i != half; ++i) {
+		uint32_t reversed = 0;
+		for(unsigned bit = 0; bit != bits; ++bit)
+			if(i & ((size_t)1 << bit))
+				reversed |= 1u << (bits - 1 - bit);
+		reversed_[i] = reversed;
+	}
+
+	for(size_t k = 0; k != half; ++k)
+		twiddles_[k] = std::complex<float>(cos(2*M_PI*k/size), -sin(2*M_PI*k/size));
+
+}
+
+size_t FftPlan::size() const {
+
+	return size_;
+
+}
+
+void FftPlan::transform(const float* input, std::complex<float>* output) const {
+
+	// The even samples are the real parts and the odd ones the imaginary parts of a complex input of half the length
+	size_t half = size_/2;
+	for(size_t i = 0; i != half; ++i)
+		output[reversed_[i]] = std::complex<float>(input[2*i], input[2*i + 1]);
+
+	for(size_t length = 2; length <= half; length *= 2) {
+		size_t step = size_/length;
+		for(size_t start = 0; start != half; start += length) {
+			std::complex<float>* a = output + start;
+			std::complex<float>* b = a + length/2;
+			for(size_t j = 0; j != length/2; ++j) {
+				std::complex<float> t = multiply(b[j], twiddles_[j*step]);
+				b[j] = a[j] - t;
+				a[j] += t;
+			}
+		}
+	}
+
+	// Separate the spectra of the even and odd samples, X[k] = E[k] + e^(-2*pi*i*k/size)*O[k]. Bins k and
+	// half - k are computed together so the output can be overwritten in place.
+	std::complex<float> first = output[0];
+	output[0] = std::complex<float>(first.real() + first.imag(), 0.0f);
+	output[half] = std::complex<float>(first.real() - first.imag(), 0.0f);
+	for(size_t k = 1; k <= half/2; ++k) {
+		std::complex<float> z = output[k];
+		std::complex<float> mirror = std::conj(output[half - k]);
+		std::complex<float> even = 0.5f*(z + mirror);
+		std::complex<float> odd = 0.5f*(z - mirror);
+		odd = std::complex<float>(odd.imag(), -odd.real());
+		std::complex<float> mirror_even = std::conj(even);
+		std::complex<float> mirror_odd = std::conj(odd);
+		output[k] = even + multiply(twiddles_[k], odd);
+		if(k != half - k)
+			output[half - k] = mirror_even + multiply(twiddles_[half - k], mirror_odd);
+	}
+
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer(Fft_window window) : window_(window), gain_(0.0) {
+
+}
+
+Fft_window SpectrumAnalyzer::getWindow() const {
+
+	return window_;
+
+}
+
+void SpectrumAnalyzer::prepare(size_t samples) {
+
+	if(samples < 2)
+		throw std::invalid_argument("Frame needs at least two samples for a spectrum");
+
+	if(samples == coefficients_.size())
+		return;
+
+	size_t size = 2;
+	while(size < samples)
+		size *= 2;
+	plan_ = FftPlan::get(size);
+
+	coefficients_.resize(samples);
+	double sum = 0.0;
+	for(size_t i = 0; i != samples; ++i) {
+		coefficients_[i] = windowCoefficient(window_, i, samples);
+		sum += coefficients_[i];
+	}
+	gain_ = 1/(sum*sum);
+
+	// The padding stays zero, only the samples get overwritten
+	input_.assign(size, 0.0f);
+	output_.resize(size/2 + 1);
+
+}
+
+float SpectrumAnalyzer::power(const Waveform_frame& frame, std::vector<float>& power) {
+
+	size_t samples = frame.samples.size();
+	prepare(samples);
+
+	scaler_.configure(frame.volt_offset, frame.volt_scale);
+	for(size_t i = 0; i != samples; ++i)
+		input_[i] = scaler_(frame.samples[i])*coefficients_[i];
+
+	plan_->transform(input_.data(), output_.data());
+
+	// A sine of amplitude A on bin k gives |X[k]| = A*sum/2, its mean square is A^2/2. DC and Nyquist are not mirrored.
+	size_t bins = output_.size();
+	power.resize(bins);
+	for(size_t k = 0; k != bins; ++k)
+		power[k] = std::norm(output_[k])*gain_*(k == 0 || k == bins - 1 ? 1 : 2);
+
+	return frame.sample_interval > 0 ? 1/(plan_->size()*frame.sample_interval) : 0.0f;
+
+}
+
+void SpectrumAnalyzer::transform(const Waveform_frame& frame, Spectrum& result) {
+
+	result.bin_width = power(frame, result.magnitude);
+	for(size_t k = 0; k != result.magnitude.size(); ++k)
+		result.magnitude[k] = 10*log10f(std::max(result.magnitude[k], power_floor));
+	result.channel = frame.channel;
+	result.frames = 1;
+	result.timestamp = frame.timestamp;
+
+}
+
+void SpectrumAnalyzer::transform(const std::vector<Waveform_frame>& frames, std::vector<Spectrum>& results,
+			unsigned threads) {
+
+	results.resize(frames.size());
+	if(threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min<size_t>(threads, frames.size());
+	if(threads <= 1) {
+		for(size_t i = 0; i != frames.size(); ++i)
+			transform(frames[i], results[i]);
+		return;
+	}
+
+	// Every thread takes a contiguous range of frames, the first exception is rethrown after all threads finished
+	std::vector<std::thread> workers;
+	std::vector<std::exception_ptr> errors(threads);
+	for(unsigned t = 0; t != threads; ++t) {
+		size_t begin = frames.size()*t/threads;
+		size_t end = frames.size()*(t + 1)/threads;
+		workers.emplace_back([this, &frames, &results, &errors, t, begin, end]() {
+			try {
+				SpectrumAnalyzer analyzer(window_);
+				for(size_t i = begin; i != end; ++i)
+					analyzer.transform(frames[i], results[i]);
+			}
+			catch(...) {
+				errors[t] = std::current_exception();
+			}
+		});
+	}
+	for(size_t t = 0; t != workers.size(); ++t)
+		workers[t].join();
+	for(size_t t = 0; t != errors.size(); ++t)
+		if(errors[t])
+			std::rethrow_exception(errors[t]);
+
+}
+
+SpectrumAverager::SpectrumAverager(Fft_window window) : analyzer_(window), bin_width_(0.0), frames_(0), channel_(CH1) {
+
+}
+
+void SpectrumAverager::add(const Waveform_frame& frame) {
+
+	float bin_width = analyzer_.power(frame, power_);
+	if(frames_ == 0) {
+		sum_.assign(power_.size(), 0.0);
+		bin_width_ = bin_width;
+	}
+	else if(power_.size() != sum_.size() || bin_width != bin_width_)
+		throw std::invalid_argument("Frame does not match the frames averaged before it");
+
+	for(size_t k = 0; k != sum_.size(); ++k)
+		sum_[k] += power_[k];
+	++frames_;
+	channel_ = frame.channel;
+	timestamp_ = frame.timestamp;
+
+}
+
+void SpectrumAverager::reset() {
+
+	frames_ = 0;
+	sum_.clear();
+
+}
+
+size_t SpectrumAverager::size() const {
+
+	return frames_;
+
+}
+
+void SpectrumAverager::spectrum(Spectrum& result) const {
+
+	result.magnitude.resize(sum_.size());
+	for(size_t k = 0; k != sum_.size(); ++k)
+		result.magnitude[k] = 10*log10f(std::max<float>(sum_[k]/frames_, power_floor));
+	result.bin_width = bin_width_;
+	result.frames = frames_;
+	result.channel = channel_;
+	result.timestamp = timestamp_;
+
+}
@@ -0,0 +1,141 @@
+#ifndef SPECTRUM_HH
+#define SPECTRUM_HH
+
+#include <vector>
+#include <complex>
+#include <memory>
+#include <chrono>
+#include <stddef.h>
+#include "WaveformFrame.hh"
+#include "SampleScaler.hh"
+
+enum Fft_window {Window_rectangular, Window_hann, Window_blackman, Window_flat_top};
+
+//! Precomputed tables for a real input FFT of one length. The real input of length n is transformed as a complex
+//! FFT of length n/2 (iterative radix-2) followed by a pass separating the spectra of the even and odd samples.
+//! Plans are immutable and shared, get() builds the plan of a length once and returns the cached one after that.
+class FftPlan {
+public:
+
+//! @param size Length of the input, a power of two, at least 2
+//! \note{Throws std::invalid_argument if size is not a power of two}
+//! @return The plan for size, shared by all the users of the length
+	static std::shared_ptr<const FftPlan> get(size_t size);
+
+//! @return Length of the input
+	size_t size() const;
+
+//! Transform real input
+//! @param input size() samples
+//! @param output size()/2 + 1 bins, from DC to the Nyquist frequency
+	void transform(const float* input, std::complex<float>* output) const;
+
+private:
+
+	explicit FftPlan(size_t size);
+
+	size_t size_;
+//! Bit reversed index of every element of the complex FFT
+	std::vector<uint32_t> reversed_;
+//! e^(-2*pi*i*k/size) for k in [0, size/2)
+	std::vector<std::complex<float> > twiddles_;
+
+};
+
+//! Power spectrum of a frame, or the average of the spectra of several frames
+struct Spectrum {
+
+	Channel channel;
+//! RMS voltage of the signal in every bin in dBV, from DC to the Nyquist frequency
+	std::vector<float> magnitude;
+//! Frequency difference of two bins in Hz
+	float bin_width;
+//! Amount of frames averaged into the spectrum
+	size_t frames;
+//! Timestamp of the last frame
+	std::chrono::system_clock::time_point timestamp;
+
+	Spectrum() : channel(CH1), bin_width(0.0), frames(0) {}
+
+};
+
+//! Computes spectra of frames. The samples are scaled to volts with the channel settings of the frame, windowed
+//! and zero padded to the next power of two. The magnitudes are corrected for the coherent gain of the window, so a
+//! sine on a bin shows its RMS voltage. The analyzer keeps its buffers and the window of the last frame length,
+//! so the same analyzer should be reused for a stream of frames.
+//! \note{An analyzer may only be used by one thread at a time, use the batch version of transform() for using
+//! several cores}
+class SpectrumAnalyzer {
+public:
+
+	explicit SpectrumAnalyzer(Fft_window window = Window_hann);
+
+//! @return Window the samples are multiplied with
+	Fft_window getWindow() const;
+
+//! Power spectrum of a frame
+//! @param frame Frame with at least two samples
+//! @param power Mean square voltage of every bin, the memory is reused if it is big enough
+//! @return Frequency difference of two bins in Hz
+	float power(const Waveform_frame& frame, std::vector<float>& power);
+
+//! Spectrum of a frame
+//! @param frame Frame with at least two samples
+//! @param result Spectrum of the frame, the memory of the magnitudes is reused if it is big enough
+	void transform(const Waveform_frame& frame, Spectrum& result);
+
+//! Spectra of many frames, the frames are divided between threads that each have their own analyzer
+//! @param frames Frames to transform
+//! @param results Spectrum of each frame, the memory is reused if it is big enough
+//! @param threads Amount of threads, 0 uses all the cores
+	void transform(const std::vector<Waveform_frame>& frames, std::vector<Spectrum>& results, unsigned threads = 0);
+
+private:
+
+	void prepare(size_t samples);
+
+	Fft_window window_;
+	std::shared_ptr<const FftPlan> plan_;
+	SampleScaler scaler_;
+//! Window coefficients for frames of coefficients_.size() samples
+	std::vector<float> coefficients_;
+//! Power correction of the window, 1/(sum of the coefficients)^2
+	float gain_;
+	std::vector<float> input_;
+	std::vector<std::complex<float> > output_;
+
+};
+
+//! Averages the power spectra of frames, the average is computed from the mean square voltages before
+//! converting to dBV so noise averages to its real level.
+class SpectrumAverager {
+public:
+
+	explicit SpectrumAverager(Fft_window window = Window_hann);
+
+//! Add a frame to the average
+//! \note{Throws std::invalid_argument if the frame gives a different spectrum than the frames before it}
+	void add(const Waveform_frame& frame);
+
+//! Forget the frames added so far
+	void reset();
+
+//! @return Amount of frames added
+	size_t size() const;
+
+//! @param result Average of the spectra added so far
+	void spectrum(Spectrum& result) const;
+
+private:
+
+	SpectrumAnalyzer analyzer_;
+	std::vector<float> power_;
+	std::vector<double> sum_;
+	float bin_width_;
+	size_t frames_;
+	Channel channel_;
+	std::chrono::system_clock::time_point timestamp_;
+
+};
+
+#endif
@@ -0,0 +1,469 @@
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <linux/usb/tmc.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <boost/asio.hpp>
+#include "Transport.hh"
+
+SerialTransport::SerialTransport(boost::asio::io_service& io, const std::string& device) : port_(io), 
+			memory_(std::make_shared<HandlerMemory>()) {
+
+	port_.open(device);
+
+}
+
+bool SerialTransport::configure(Baud_rate rate, bool hardware_flow) {
+
+	port_.set_option(boost::asio::serial_port_base::baud_rate((int)rate));
+	port_.set_option(boost::asio::serial_port_base::character_size(8));
+	port_.set_option(boost::asio::serial_port_base::parity(boost::asio::serial_port_base::parity::none));
+	port_.set_option(boost::asio::serial_port_base::stop_bits(boost::asio::serial_port_base::stop_bits::one));
+
+	if(hardware_flow) {
+		boost::system::error_code error;
+		port_.set_option(boost::asio::serial_port_base::flow_control(
+				boost::asio::serial_port_base::flow_control::hardware), error);
+		if(!error)
+			return true;
+	}
+	port_.set_option(boost::asio::serial_port_base::flow_control(boost::asio::serial_port_base::flow_control::none));
+	return false;
+
+}
+
+size_t SerialTransport::pendingOutput() {
+
+	int pending;
+	if(ioctl(port_.native_handle(), TIOCOUTQ, &pending) != 0)
+		throw boost::system::system_error(errno, boost::system::system_category(), "ioctl TIOCOUTQ");
+	return pending;
+
+}
+
+void SerialTransport::flushOutput() {
+
+	if(tcflush(port_.native_handle(), TCOFLUSH) != 0)
+		throw boost::system::system_error(errno, boost::system::system_category(), "tcflush");
+
+}
+
+void SerialTransport::flushInput() {
+
+	if(tcflush(port_.native_handle(), TCIFLUSH) != 0)
+		throw boost::system::system_error(errno, boost::system::system_category(), "tcflush");
+
+}
+
+void SerialTransport::asyncWriteSome(const void* data, size_t size, Handler handler) {
+
+	port_.async_write_some(boost::asio::buffer(data, size), makePooledHandler(memory_, std::move(handler)));
+
+}
+
+void SerialTransport::asyncReadSome(void* data, size_t size, Handler handler) {
+
+	port_.async_read_some(boost::asio::buffer(data, size), makePooledHandler(memory_, std::move(handler)));
+
+}
+
+void SerialTransport::cancel() {
+
+	port_.cancel();
+
+}
+
+void SerialTransport::close() {
+
+	if(port_.is_open())
+		port_.close();
+
+}
+
+TcpTransport::TcpTransport(boost::asio::io_service& io, const std::string& host, const std::string& port) : socket_(io),
+			memory_(std::make_shared<HandlerMemory>()) {
+
+	boost::asio::ip::tcp::resolver resolver(io);
+	boost::asio::connect(socket_, resolver.resolve(host, port));
+	// Commands are short and every one of them waits for an answer, do not let Nagle hold them back
+	socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+
+}
+
+void TcpTransport::asyncWriteSome(const void* data, size_t size, Handler handler) {
+
+	socket_.async_write_some(boost::asio::buffer(data, size), makePooledHandler(memory_, std::move(handler)));
+
+}
+
+void TcpTransport::asyncReadSome(void* data, size_t size, Handler handler) {
+
+	socket_.async_read_some(boost::asio::buffer(data, size), makePooledHandler(memory_, std::move(handler)));
+
+}
+
+void TcpTransport::cancel() {
+
+	socket_.cancel();
+
+}
+
+void TcpTransport::close() {
+
+	if(socket_.is_open())
+		socket_.close();
+
+}
+
+UsbtmcTransport::UsbtmcTransport(boost::asio::io_service& io, const std::string& device) : io_(io), 
+				fd_(-1), wake_(-1), blocking_(false), stopping_(false), running_(false) {
+
+	fd_ = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if(fd_ < 0)
+		throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()), 
+				"Could not open " + device);
+	wake_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(wake_ < 0) {
+		int error = errno;
+		::close(fd_);
+		throw boost::system::system_error(error, boost::system::system_category(), "eventfd");
+	}
+
+	// Only the usbtmc driver knows its timeout
+	unsigned timeout;
+	blocking_ = ioctl(fd_, USBTMC_IOCTL_GET_TIMEOUT, &timeout) == 0;
+
+	worker_ = std::thread(&UsbtmcTransport::work, this);
+
+}
+
+UsbtmcTransport::~UsbtmcTransport() {
+
+	close();
+
+}
+
+void UsbtmcTransport::asyncWriteSome(const void* data, size_t size, Handler handler) {
+
+	queue(false, const_cast<void*>(data), size, handler);
+
+}
+
+void UsbtmcTransport::asyncReadSome(void* data, size_t size, Handler handler) {
+
+	queue(true, data, size, handler);
+
+}
+
+void UsbtmcTransport::cancel() {
+
+	std::deque<Operation> cancelled;
+	Handler running;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		cancelled.swap(jobs_);
+		if(running_) {
+			running_ = false;
+			running = std::move(running_handler_);
+		}
+	}
+
+	uint64_t one = 1;
+	if(::write(wake_, &one, sizeof(one)) < 0) {
+		// Only fails if the counter is full, the worker is woken up anyway then
+	}
+
+	if(running)
+		complete(running, boost::asio::error::operation_aborted, 0);
+	for(Operation& operation : cancelled)
+		complete(operation.handler, boost::asio::error::operation_aborted, 0);
+
+}
+
+void UsbtmcTransport::close() {
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(fd_ < 0)
+			return;
+		stopping_ = true;
+	}
+	cancel();
+	condition_.notify_one();
+	if(worker_.joinable())
+		worker_.join();
+
+	::close(fd_);
+	::close(wake_);
+	fd_ = -1;
+	wake_ = -1;
+
+}
+
+void UsbtmcTransport::queue(bool read, void* data, size_t size, Handler handler) {
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(!stopping_) {
+			io_.get_executor().on_work_started();
+			jobs_.push_back(Operation{read, data, size, handler});
+			condition_.notify_one();
+			return;
+		}
+	}
+	io_.post(std::bind(handler, boost::asio::error::bad_descriptor, 0));
+
+}
+
+void UsbtmcTransport::work() {
+
+	for(;;) {
+		Operation operation;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while(jobs_.empty() && !stopping_)
+				condition_.wait(lock);
+			if(stopping_)
+				return;
+			operation = std::move(jobs_.front());
+			jobs_.pop_front();
+
+			// The data of a write is taken now, the caller may free it as soon as the operation is cancelled
+			buffer_.resize(std::max(buffer_.size(), operation.size));
+			if(!operation.read)
+				memcpy(buffer_.data(), operation.data, operation.size);
+			running_ = true;
+			running_handler_ = std::move(operation.handler);
+		}
+
+		boost::system::error_code error;
+		size_t transferred = transfer(operation.read, operation.size, error);
+
+		Handler handler;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			// Already completed by cancel()
+			if(!running_)
+				continue;
+			running_ = false;
+			handler = std::move(running_handler_);
+			if(operation.read && transferred)
+				memcpy(operation.data, buffer_.data(), transferred);
+		}
+		complete(handler, error, transferred);
+	}
+
+}
+
+void UsbtmcTransport::complete(Handler& handler, const boost::system::error_code& error, size_t transferred) {
+
+	io_.post(std::bind(std::move(handler), error, transferred));
+	io_.get_executor().on_work_finished();
+
+}
+
+size_t UsbtmcTransport::transfer(bool read, size_t size, boost::system::error_code& error) {
+
+	while(!blocking_) {
+		pollfd fds[2] = {{fd_, (short)(read ? POLLIN : POLLOUT), 0}, {wake_, POLLIN, 0}};
+		if(poll(fds, 2, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			error = boost::system::error_code(errno, boost::system::system_category());
+			return 0;
+		}
+		if(fds[1].revents) {
+			uint64_t count;
+			if(::read(wake_, &count, sizeof(count)) < 0) {
+				// Nothing to reset if another wakeup took it already
+			}
+			// The wakeup may be left from a cancel() before this operation started
+			std::lock_guard<std::mutex> lock(mutex_);
+			if(!running_ || stopping_) {
+				error = boost::asio::error::operation_aborted;
+				return 0;
+			}
+		}
+		if(fds[0].revents)
+			break;
+	}
+
+	ssize_t result = read ? ::read(fd_, buffer_.data(), size) : ::write(fd_, buffer_.data(), size);
+	if(result < 0) {
+		error = boost::system::error_code(errno, boost::system::system_category());
+		return 0;
+	}
+	if(result == 0 && read && size != 0)
+		error = boost::asio::error::eof;
+	return result;
+
+}
+
+ReplayTransport::ReplayTransport(boost::asio::io_service& io, const std::string& path, double speed) : io_(io),
+			trace_(path), speed_(speed), timer_(io), record_(0), offset_(0), played_(Clock::now()), played_time_(0),
+			mismatches_(0), reading_(false), read_data_(0), read_size_(0), memory_(std::make_shared<HandlerMemory>()) {
+
+}
+
+void ReplayTransport::asyncWriteSome(const void* data, size_t size, Handler handler) {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// The write is taken whole, going through as many recorded writes as it covers
+	const uint8_t* bytes = (const uint8_t*)data;
+	size_t left = size;
+	bool mismatch = false;
+	while(left && record_ != trace_.size() && trace_[record_].direction == Trace_write) {
+		const Trace_record& record = trace_[record_];
+		size_t count = std::min(left, record.size - offset_);
+		if(memcmp(bytes, trace_.data(record) + offset_, count) != 0)
+			mismatch = true;
+		bytes += count;
+		left -= count;
+		offset_ += count;
+		if(offset_ == record.size) {
+			played_time_ = record.time;
+			++record_;
+			offset_ = 0;
+		}
+	}
+	if(mismatch || left)
+		++mismatches_;
+	played_ = Clock::now();
+
+	io_.post(makePooledHandler(memory_, std::bind(handler, boost::system::error_code(), size)));
+	deliver();
+
+}
+
+void ReplayTransport::asyncReadSome(void* data, size_t size, Handler handler) {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	reading_ = true;
+	read_data_ = (uint8_t*)data;
+	read_size_ = size;
+	read_handler_ = handler;
+	deliver();
+
+}
+
+void ReplayTransport::deliver() {
+
+	if(!reading_)
+		return;
+
+	if(record_ == trace_.size()) {
+		reading_ = false;
+		io_.post(makePooledHandler(memory_, std::bind(read_handler_, boost::asio::error::eof, 0)));
+		return;
+	}
+
+	// A read waits for the writes recorded before it
+	const Trace_record& record = trace_[record_];
+	if(record.direction != Trace_read)
+		return;
+
+	// The rest of a record cut by a small read buffer is due right away
+	Clock::time_point now = Clock::now();
+	Clock::time_point due = played_;
+	if(offset_ == 0 && speed_ > 0)
+		due += std::chrono::duration_cast<Clock::duration>(
+					std::chrono::duration<double, std::nano>((record.time - played_time_)/speed_));
+	if(due > now) {
+		timer_.expires_at(due);
+		timer_.async_wait(makePooledHandler(memory_, [this](const boost::system::error_code& error) {
+			if(error)
+				return;
+			std::lock_guard<std::mutex> lock(mutex_);
+			deliver();
+		}));
+		return;
+	}
+
+	size_t count = std::min(read_size_, record.size - offset_);
+	memcpy(read_data_, trace_.data(record) + offset_, count);
+	offset_ += count;
+	if(offset_ == record.size) {
+		played_time_ = record.time;
+		++record_;
+		offset_ = 0;
+	}
+	played_ = now;
+	reading_ = false;
+	io_.post(makePooledHandler(memory_, std::bind(read_handler_, boost::system::error_code(), count)));
+
+}
+
+void ReplayTransport::cancel() {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	timer_.cancel();
+	if(reading_) {
+		reading_ = false;
+		io_.post(makePooledHandler(memory_, std::bind(read_handler_, boost::asio::error::operation_aborted, 0)));
+	}
+
+}
+
+void ReplayTransport::close() {
+
+	cancel();
+
+}
+
+size_t ReplayTransport::getMismatches() const {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	return mismatches_;
+
+}
+
+bool ReplayTransport::finished() const {
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	return record_ == trace_.size();
+
+}
+
+std::unique_ptr<Transport> openTransport(boost::asio::io_service& io, const std::string& address, Baud_rate rate) {
+
+	const std::string tcp_prefix = "tcp://";
+	const std::string usbtmc_prefix = "/dev/usbtmc";
+	const std::string replay_prefix = "replay://";
+
+	if(address.compare(0, tcp_prefix.size(), tcp_prefix) == 0) {
+		std::string host = address.substr(tcp_prefix.size());
+		size_t colon = host.rfind(':');
+		if(colon == std::string::npos)
+			throw std::invalid_argument("TCP address has to be of the form tcp://host:port");
+		return std::unique_ptr<Transport>(new TcpTransport(io, host.substr(0, colon), host.substr(colon + 1)));
+	}
+
+	if(address.compare(0, replay_prefix.size(), replay_prefix) == 0) {
+		std::string path = address.substr(replay_prefix.size());
+		double speed = 1.0;
+		size_t option = path.rfind("?speed=");
+		if(option != std::string::npos) {
+			speed = atof(path.c_str() + option + 7);
+			path.resize(option);
+		}
+		return std::unique_ptr<Transport>(new ReplayTransport(io, path, speed));
+	}
+
+	if(address.compare(0, usbtmc_prefix.size(), usbtmc_prefix) == 0)
+		return std::unique_ptr<Transport>(new UsbtmcTransport(io, address));
+
+	SerialTransport* serial = new SerialTransport(io, address);
+	std::unique_ptr<Transport> transport(serial);
+	serial->configure(rate);
+	return transport;
+
+}
@@ -0,0 +1,377 @@
+#ifndef TRANSPORT_HH
+#define TRANSPORT_HH
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <boost/asio.hpp>
+#include "ScopeTypes.hh"
+#include "LinkStats.hh"
+#include "LinkTrace.hh"
+#include "HandlerMemory.hh"
+
+//! Interface for the link to the scope. Implementations do their I/O asynchronously and call the completion
+//! handlers from the io_service given to them, like the boost::asio "some" operations.
+class Transport {
+public:
+
+	typedef std::function<void(const boost::system::error_code&, size_t)> Handler;
+
+	virtual ~Transport() {}
+
+//! Start writing at least one byte
+//! @param data Data to write, has to stay valid until the handler is called
+//! @param size Amount of bytes to write
+//! @param handler Called with the amount of bytes written
+	virtual void asyncWriteSome(const void* data, size_t size, Handler handler) = 0;
+
+//! Start reading at least one byte
+//! @param data Buffer to read into, has to stay valid until the handler is called
+//! @param size Size of the buffer
+//! @param handler Called with the amount of bytes read
+	virtual void asyncReadSome(void* data, size_t size, Handler handler) = 0;
+
+//! Cancel the pending operations, their handlers get called with boost::asio::error::operation_aborted
+	virtual void cancel() = 0;
+
+//! Close the link
+	virtual void close() = 0;
+
+};
+
+//! Adapter for using a Transport with the boost::asio composed operations (async_read, async_read_until, async_write).
+//! Like with the boost::asio streams, one read and one write may be in progress at a time. The handler of an
+//! operation is kept in memory from its allocation hooks, so the Transport gets a handler that only points at
+//! the stream and a link whose handlers have pooled memory (see HandlerMemory.hh) does not allocate per operation.
+class Transport_stream {
+public:
+
+	typedef boost::asio::io_service::executor_type executor_type;
+
+	Transport_stream(boost::asio::io_service& io, Transport& transport) : io_(io), transport_(&transport), stats_(0), 
+				recorder_(0), read_(), write_() {}
+
+//! Destroys the handlers of the operations still in progress
+	~Transport_stream() {
+		read_.destroy();
+		write_.destroy();
+	}
+
+//! Count the bytes read and written in stats, 0 to stop counting
+	void setStats(LinkStats* stats) {
+		stats_.store(stats, std::memory_order_relaxed);
+	}
+
+//! Record the data read and written with recorder, 0 to stop recording
+//! \note{Operations completing after this are recorded, change it only when nothing is pending}
+	void setRecorder(TraceRecorder* recorder) {
+		recorder_.store(recorder, std::memory_order_relaxed);
+	}
+
+	executor_type get_executor() {
+		return io_.get_executor();
+	}
+
+	template <class MutableBufferSequence, class ReadHandler>
+	void async_read_some(const MutableBufferSequence& buffers, ReadHandler handler) {
+		boost::asio::mutable_buffer buffer = *boost::asio::buffer_sequence_begin(buffers);
+		read_.store(handler, buffer.data());
+		transport_->asyncReadSome(buffer.data(), buffer.size(), [this](const boost::system::error_code& error, 
+					size_t bytes) {
+			LinkStats* stats = stats_.load(std::memory_order_relaxed);
+			TraceRecorder* recorder = recorder_.load(std::memory_order_relaxed);
+			if(stats)
+				stats->addBytesIn(bytes);
+			if(recorder && bytes)
+				recorder->record(Trace_read, read_.data, bytes);
+			read_.complete(error, bytes);
+		});
+	}
+
+	template <class ConstBufferSequence, class WriteHandler>
+	void async_write_some(const ConstBufferSequence& buffers, WriteHandler handler) {
+		boost::asio::const_buffer buffer = *boost::asio::buffer_sequence_begin(buffers);
+		write_.store(handler, buffer.data());
+		transport_->asyncWriteSome(buffer.data(), buffer.size(), [this](const boost::system::error_code& error, 
+					size_t bytes) {
+			LinkStats* stats = stats_.load(std::memory_order_relaxed);
+			TraceRecorder* recorder = recorder_.load(std::memory_order_relaxed);
+			if(stats)
+				stats->addBytesOut(bytes);
+			if(recorder && bytes)
+				recorder->record(Trace_write, write_.data, bytes);
+			write_.complete(error, bytes);
+		});
+	}
+
+private:
+
+//! Type erased handler of the operation in progress in one direction
+	struct Pending_operation {
+
+		void* handler;
+		void (*invoke)(void* handler, const boost::system::error_code& error, size_t bytes);
+		void (*release)(void* handler);
+	//! Buffer of the operation, for the recorder
+		const void* data;
+
+		template <class Handler>
+		void store(Handler& h, const void* buffer) {
+			void* memory = boost_asio_handler_alloc_helpers::allocate(sizeof(Handler), h);
+			handler = new(memory) Handler(std::move(h));
+			invoke = &invokeHandler<Handler>;
+			release = &releaseHandler<Handler>;
+			data = buffer;
+		}
+
+		void complete(const boost::system::error_code& error, size_t bytes) {
+			void* h = handler;
+			handler = 0;
+			invoke(h, error, bytes);
+		}
+
+		void destroy() {
+			if(handler)
+				release(handler);
+			handler = 0;
+		}
+
+	//! The memory is given back before the call, so the next operation started by the handler can reuse it
+		template <class Handler>
+		static void invokeHandler(void* pointer, const boost::system::error_code& error, size_t bytes) {
+			Handler* stored = static_cast<Handler*>(pointer);
+			Handler handler(std::move(*stored));
+			stored->~Handler();
+			boost_asio_handler_alloc_helpers::deallocate(pointer, sizeof(Handler), handler);
+			handler(error, bytes);
+		}
+
+		template <class Handler>
+		static void releaseHandler(void* pointer) {
+			Handler* stored = static_cast<Handler*>(pointer);
+			Handler handler(std::move(*stored));
+			stored->~Handler();
+			boost_asio_handler_alloc_helpers::deallocate(pointer, sizeof(Handler), handler);
+		}
+
+	};
+
+	boost::asio::io_service& io_;
+	Transport* transport_;
+	std::atomic<LinkStats*> stats_;
+	std::atomic<TraceRecorder*> recorder_;
+	Pending_operation read_;
+	Pending_operation write_;
+
+};
+
+//! RS232 link through a serial port ("/dev/ttyUSB0" for example)
+class SerialTransport : public Transport {
+public:
+
+//! @param io io_service the handlers are called from
+//! @param device Address of the serial port
+	SerialTransport(boost::asio::io_service& io, const std::string& device);
+
+//! Configure the (computers) serial port, 8 data bits, no parity and one stop bit
+//! @param rate Serial port baud rate
+//! @param hardware_flow Use RTS/CTS flow control, falls back to no flow control if the port does not support it
+//! @return true if RTS/CTS flow control is in use
+	bool configure(Baud_rate rate, bool hardware_flow = false);
+
+//! @return Amount of bytes written but not transmitted yet
+	size_t pendingOutput();
+
+//! Discard data written but not transmitted yet
+	void flushOutput();
+
+//! Discard data received but not read yet
+	void flushInput();
+
+	void asyncWriteSome(const void* data, size_t size, Handler handler);
+	void asyncReadSome(void* data, size_t size, Handler handler);
+	void cancel();
+	void close();
+
+private:
+
+	boost::asio::serial_port port_;
+//! Memory of the read and write operations
+	std::shared_ptr<HandlerMemory> memory_;
+
+};
+
+//! Raw TCP socket link, for scopes behind a serial to ethernet bridge for example
+class TcpTransport : public Transport {
+public:
+
+//! Connects to host, blocks until the connection is made
+//! @param io io_service the handlers are called from
+//! @param host Host name or address
+//! @param port Port number or service name
+	TcpTransport(boost::asio::io_service& io, const std::string& host, const std::string& port);
+
+	void asyncWriteSome(const void* data, size_t size, Handler handler);
+	void asyncReadSome(void* data, size_t size, Handler handler);
+	void cancel();
+	void close();
+
+private:
+
+	boost::asio::ip::tcp::socket socket_;
+//! Memory of the read and write operations
+	std::shared_ptr<HandlerMemory> memory_;
+
+};
+
+//! USB link through the Linux usbtmc driver character device ("/dev/usbtmc0" for example).
+//! The driver does not report readiness for plain reads, so the reads and writes are done blocking on
+//! a worker thread of the transport and their handlers are posted to the io_service. The worker transfers
+//! through a buffer of its own, so cancel() and close() can complete the operations right away: queued
+//! ones are not started and the one in progress gets its handler called without waiting for the worker.
+//! Devices that do report readiness (ptys and sockets) are waited on with poll() together with an eventfd,
+//! which cancel() signals to stop the wait.
+//! \note{A cancelled read of the usbtmc driver keeps the worker busy until the driver times out (5 seconds
+//! by default), operations queued after it wait for that}
+class UsbtmcTransport : public Transport {
+public:
+
+//! @param io io_service the handlers are called from
+//! @param device Address of the usbtmc device
+	UsbtmcTransport(boost::asio::io_service& io, const std::string& device);
+	~UsbtmcTransport();
+
+	void asyncWriteSome(const void* data, size_t size, Handler handler);
+	void asyncReadSome(void* data, size_t size, Handler handler);
+	void cancel();
+	void close();
+
+private:
+
+//! Read or write waiting for the worker
+	struct Operation {
+
+		bool read;
+		void* data;
+		size_t size;
+		Handler handler;
+
+	};
+
+	boost::asio::io_service& io_;
+	int fd_;
+//! eventfd waking the worker from poll() when operations are cancelled
+	int wake_;
+//! The device does not report readiness for reads, the usbtmc driver
+	bool blocking_;
+
+	std::thread worker_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::deque<Operation> jobs_;
+	bool stopping_;
+//! Set while the worker is transferring, cleared by cancel() when it completes the operation itself
+	bool running_;
+	Handler running_handler_;
+//! Data of the operation in progress, only touched by the worker
+	std::vector<uint8_t> buffer_;
+
+//! Internal function for queueing a blocking read or write for the worker thread. The io_service counts the
+//! operation as work until complete() posts its handler, so it does not run out of work meanwhile.
+	void queue(bool read, void* data, size_t size, Handler handler);
+	void complete(Handler& handler, const boost::system::error_code& error, size_t transferred);
+
+//! Internal function run by the worker thread
+	void work();
+
+//! Internal function doing the transfer of the worker, sets error to operation_aborted if it was cancelled
+//! @return Amount of bytes transferred
+	size_t transfer(bool read, size_t size, boost::system::error_code& error);
+
+//! Disable copying and assignment
+	UsbtmcTransport(const UsbtmcTransport&);
+	void operator=(const UsbtmcTransport&);
+
+};
+
+//! Plays back a trace recorded with RigolScope::startRecording(), for running the same calls again without the
+//! scope. Reads get the data recorded in the chunks it was recorded in, each after the delay it had from the
+//! record before it (divided by the speed). Writes are checked against the recorded writes and the trace
+//! advances past them, a write that differs is counted in getMismatches() but does not stop the replay.
+//! Reads past the end of the trace fail with boost::asio::error::eof.
+//! \note{RigolScope does not lengthen its timeout for long transfers on replays, set a longer timeout for
+//! replaying long serial transfers at the original speed}
+class ReplayTransport : public Transport {
+public:
+
+//! \note{Throws std::runtime_error if the trace can not be read}
+//! @param io io_service the handlers are called from
+//! @param path Path of the trace file
+//! @param speed 1 for the original timing, 10 for ten times faster, 0 for no delays at all
+	ReplayTransport(boost::asio::io_service& io, const std::string& path, double speed = 1.0);
+
+	void asyncWriteSome(const void* data, size_t size, Handler handler);
+	void asyncReadSome(void* data, size_t size, Handler handler);
+	void cancel();
+	void close();
+
+//! @return Amount of writes that differed from the trace
+	size_t getMismatches() const;
+
+//! @return true if every record of the trace has been played
+	bool finished() const;
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	boost::asio::io_service& io_;
+	TraceReader trace_;
+	double speed_;
+	boost::asio::steady_timer timer_;
+
+	mutable std::mutex mutex_;
+//! Record played next and how much of it has been played
+	size_t record_;
+	size_t offset_;
+//! When the last record was played, and its time in the trace
+	Clock::time_point played_;
+	int64_t played_time_;
+	size_t mismatches_;
+
+//! The read waiting for its record
+	bool reading_;
+	uint8_t* read_data_;
+	size_t read_size_;
+	Handler read_handler_;
+
+//! Memory of the posted handlers and the timer
+	std::shared_ptr<HandlerMemory> memory_;
+
+//! Internal function for completing the pending read if its record is due, called with mutex_ locked
+	void deliver();
+
+//! Disable copying and assignment
+	ReplayTransport(const ReplayTransport&);
+	void operator=(const ReplayTransport&);
+
+};
+
+//! Open a transport based on the address of the scope:
+//! "tcp://host:port" opens a TcpTransport, "/dev/usbtmc<n>" an UsbtmcTransport, "replay://<trace>[?speed=<speed>]"
+//! a ReplayTransport and anything else a SerialTransport
+//! @param io io_service the transport calls its handlers from
+//! @param address Address of the scope
+//! @param rate Baud rate, only used for serial ports
+//! @return The opened transport
+std::unique_ptr<Transport> openTransport(boost::asio::io_service& io, const std::string& address, Baud_rate rate);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef WAVEFORMFRAME_HH
+#define WAVEFORMFRAME_HH
+
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include "ScopeTypes.hh"
+#include "SampleScaler.hh"
+
+//! One acquisition from a channel, kept as the raw 8bit samples the scope sent together with the
+//! channel and timebase settings needed for scaling them
+struct Waveform_frame {
+
+	Channel channel;
+	std::vector<uint8_t> samples;
+	float volt_scale;
+	float volt_offset;
+	float timescale;
+	float time_offset;
+//! Time between two samples in seconds
+	float sample_interval;
+//! Time when the data was received from the scope
+	std::chrono::system_clock::time_point timestamp;
+
+	Waveform_frame() : channel(CH1), volt_scale(0.0), volt_offset(0.0), timescale(0.0), time_offset(0.0),
+				sample_interval(0.0) {}
+
+};
+
+//! Lightweight view of a Waveform_frame as volts. Samples are converted only when they are accessed,
+//! the view does not copy the samples so the frame has to outlive it.
+class VoltageView {
+public:
+
+	explicit VoltageView(const Waveform_frame& frame) : frame_(&frame), gain_(SampleScaler::gain(frame.volt_scale)),
+				zero_(SampleScaler::zero(frame.volt_offset, frame.volt_scale)) {}
+
+//! @return Amount of samples in the frame
+	size_t size() const {
+		return frame_->samples.size();
+	}
+
+//! Convert a single sample to volts
+//! @param i Index of the sample
+//! @return Sample as volts
+	float operator[](size_t i) const {
+		return gain_*frame_->samples[i] + zero_;
+	}
+
+//! @param i Index of the sample
+//! @return Time of the sample relative to the trigger point (the middle of the screen) in seconds
+	float time(size_t i) const {
+		return (i - 0.5f*frame_->samples.size())*frame_->sample_interval + frame_->time_offset;
+	}
+
+//! Convert all the samples to volts
+//! @param data Output buffer, resized to the amount of samples (memory gets reused if it is big enough)
+	void convert(std::vector<float>& data) const {
+		SampleScaler scaler;
+		scaler.configure(frame_->volt_offset, frame_->volt_scale);
+		scaler.convert(frame_->samples, data);
+	}
+
+private:
+
+	const Waveform_frame* frame_;
+	float gain_;
+	float zero_;
+
+};
+#endif
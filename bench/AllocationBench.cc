@@ -0,0 +1,176 @@
+// Heap allocations of the command path against a ScopeEmulator, counted with a replaced operator new on the
+// threads doing the I/O (the emulator thread is left out). Polling the settings and the trigger status and
+// sending settings has to allocate nothing once the buffers have grown, over the pty of the emulator and over
+// TCP, the program fails if it does. getData() is reported for reference.
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "RigolScope.hh"
+#include "ScopeEmulator.hh"
+#include "BenchReport.hh"
+
+namespace {
+
+std::atomic<bool> counting(false);
+std::atomic<size_t> allocations(0);
+//! Set on the threads whose allocations are counted
+thread_local bool counted = false;
+
+volatile double sink;
+
+//! Memory of the replaced operator new, released through release(). Kept out of line so that g++ does not see
+//! free() inlined into the callers of operator delete, next to memory it only knows from operator new.
+__attribute__((noinline)) void* allocate(size_t size) {
+
+	if(counted && counting.load(std::memory_order_relaxed))
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	void* pointer = std::malloc(size ? size : 1);
+	if(!pointer)
+		throw std::bad_alloc();
+	return pointer;
+
+}
+
+__attribute__((noinline)) void release(void* pointer) {
+
+	std::free(pointer);
+
+}
+
+//! @return Allocations per call of function, after warming up
+template <class Function>
+double allocationsPerCall(Function function) {
+
+	const size_t calls = 1000;
+	for(size_t i = 0; i != 100; ++i)
+		function();
+
+	allocations = 0;
+	counting = true;
+	for(size_t i = 0; i != calls; ++i)
+		function();
+	counting = false;
+	return (double)allocations/calls;
+
+}
+
+//! @return false if polling allocated
+bool polling(BenchReport& report, RigolScope& scope, const std::string& name) {
+
+	double status = allocationsPerCall([&]() {
+		sink = scope.getTriggerStatus();
+	});
+	report.add("getTriggerStatus", name, status, "allocs/call");
+
+	double volt_scale = allocationsPerCall([&]() {
+		sink = scope.getVoltScale(CH1);
+	});
+	report.add("getVoltScale", name, volt_scale, "allocs/call");
+
+	double set_scale = allocationsPerCall([&]() {
+		scope.setVoltScale(CH1, 0.5);
+	});
+	report.add("setVoltScale", name, set_scale, "allocs/call");
+
+	std::vector<float> data;
+	double get_data = allocationsPerCall([&]() {
+		scope.getData(CH1, data);
+		sink = data[0];
+	});
+	report.add("getData", name, get_data, "allocs/call");
+
+	return status == 0 && volt_scale == 0 && set_scale == 0;
+
+}
+
+}
+
+void* operator new(size_t size) {
+
+	return allocate(size);
+
+}
+
+void* operator new[](size_t size) {
+
+	return allocate(size);
+
+}
+
+void operator delete(void* pointer) noexcept {
+
+	release(pointer);
+
+}
+
+void operator delete[](void* pointer) noexcept {
+
+	release(pointer);
+
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+
+	release(pointer);
+
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+
+	release(pointer);
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("allocation", argc, argv);
+	counted = true;
+
+	Emulator_config config;
+	config.pace = false;
+	ScopeEmulator emulator(config);
+	emulator.start();
+
+	bool passed;
+	{
+		RigolScope scope(emulator.getDevice(), Baud_38400);
+		passed = polling(report, scope, "own io_service");
+		scope.setStatisticsEnabled(true);
+		passed = polling(report, scope, "with statistics") && passed;
+	}
+	{
+		boost::asio::io_service io;
+		boost::asio::io_service::work work(io);
+		std::thread thread([&io]() {
+			counted = true;
+			io.run();
+		});
+		{
+			RigolScope scope(io, emulator.getDevice(), Baud_38400);
+			passed = polling(report, scope, "shared io_service") && passed;
+		}
+		io.stop();
+		thread.join();
+	}
+	{
+		Emulator_config tcp_config;
+		tcp_config.pace = false;
+		tcp_config.tcp = true;
+		ScopeEmulator tcp_emulator(tcp_config);
+		tcp_emulator.start();
+		RigolScope scope(tcp_emulator.getDevice(), Baud_38400);
+		passed = polling(report, scope, "tcp") && passed;
+	}
+
+	if(!passed) {
+		report.note("Polling the scope allocated");
+		return 1;
+	}
+	return 0;
+
+}
@@ -0,0 +1,177 @@
+#ifndef BENCHREPORT_HH
+#define BENCHREPORT_HH
+
+// Reporting shared by the benchmarks. The results are printed as text as they come, and written when the
+// benchmark ends to the files given with the options
+//   --json <file>  replaces the file with a json object of the results
+//   --csv <file>   appends a row per result to the file, with a header if the file is empty
+// A file of "-" is the standard output, the text is left out then. Other arguments are left for the benchmark
+// in arguments().
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
+
+//! One measured value
+struct Bench_result {
+
+	std::string benchmark;
+	std::string name;
+	double value;
+//! Unit of value, "ns/sample" or "frames/s" for example
+	std::string unit;
+
+};
+
+class BenchReport {
+public:
+
+//! @param suite Name of the benchmark program, "pipeline" for example
+	BenchReport(const std::string& suite, int argc, char** argv) : suite_(suite) {
+
+		for(int i = 1; i < argc; ++i) {
+			std::string argument = argv[i];
+			if(argument == "--json" && i + 1 < argc)
+				json_ = argv[++i];
+			else if(argument == "--csv" && i + 1 < argc)
+				csv_ = argv[++i];
+			else
+				arguments_.push_back(argument);
+		}
+		text_ = json_ != "-" && csv_ != "-";
+
+	}
+
+//! Writes the json and csv reports
+	~BenchReport() {
+
+		if(!json_.empty()) {
+			std::ofstream file;
+			if(json_ != "-")
+				file.open(json_.c_str(), std::ios::trunc);
+			if(json_ != "-" && !file)
+				std::cerr << "Can not open " << json_ << std::endl;
+			writeJson(json_ == "-" ? std::cout : file);
+		}
+		if(!csv_.empty()) {
+			std::ofstream file;
+			if(csv_ != "-")
+				file.open(csv_.c_str(), std::ios::app);
+			if(csv_ != "-" && !file)
+				std::cerr << "Can not open " << csv_ << std::endl;
+			writeCsv(csv_ == "-" ? std::cout : file, csv_ == "-" || file.tellp() == 0);
+		}
+
+	}
+
+	void add(const std::string& benchmark, const std::string& name, double value, const std::string& unit) {
+
+		Bench_result result = {benchmark, name, value, unit};
+		results_.push_back(result);
+		if(text_)
+			std::cout << std::left << std::setw(20) << benchmark << " " << std::setw(24) << name << std::right
+						<< std::setw(12) << value << " " << unit << std::endl;
+
+	}
+
+//! Print a note for a human reader, left out of json and csv
+	void note(const std::string& text) {
+
+		(text_ ? std::cout : std::cerr) << text << std::endl;
+
+	}
+
+//! @return Arguments that are not options of the report
+	const std::vector<std::string>& arguments() const {
+
+		return arguments_;
+
+	}
+
+private:
+
+	std::string suite_;
+	std::string json_;
+	std::string csv_;
+	bool text_;
+	std::vector<std::string> arguments_;
+	std::vector<Bench_result> results_;
+
+	void writeCsv(std::ostream& out, bool header) const {
+
+		out << std::setprecision(6);
+		if(header)
+			out << "suite,benchmark,name,value,unit" << std::endl;
+		for(const Bench_result& result : results_)
+			out << csv(suite_) << "," << csv(result.benchmark) << "," << csv(result.name) << "," << result.value << ","
+						<< csv(result.unit) << std::endl;
+
+	}
+
+	void writeJson(std::ostream& out) const {
+
+		out << std::setprecision(6);
+		std::time_t now = std::time(0);
+		char timestamp[32];
+		std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+		out << "{\"suite\": " << json(suite_) << ", \"timestamp\": \"" << timestamp << "\", \"compiler\": "
+					<< json(__VERSION__) << ", \"results\": [";
+		for(size_t i = 0; i != results_.size(); ++i)
+			out << (i ? "," : "") << "\n  {\"benchmark\": " << json(results_[i].benchmark) << ", \"name\": "
+						<< json(results_[i].name) << ", \"value\": " << results_[i].value << ", \"unit\": "
+						<< json(results_[i].unit) << "}";
+		out << "\n]}" << std::endl;
+
+	}
+
+	static std::string json(const std::string& text) {
+
+		std::string result = "\"";
+		for(char c : text) {
+			if(c == '"' || c == '\\')
+				result += '\\';
+			result += c;
+		}
+		return result + "\"";
+
+	}
+
+	static std::string csv(const std::string& text) {
+
+		if(text.find_first_of(",\"") == std::string::npos)
+			return text;
+		std::string result = "\"";
+		for(char c : text) {
+			if(c == '"')
+				result += '"';
+			result += c;
+		}
+		return result + "\"";
+
+	}
+
+};
+
+//! Call function until at least min_seconds have passed, after one call to warm up
+//! @return Seconds per call
+template <class Function>
+double secondsPerCall(Function function, double min_seconds = 0.2) {
+
+	function();
+	size_t calls = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::duration<double> elapsed(0.0);
+	while(elapsed.count() < min_seconds) {
+		function();
+		++calls;
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+	return elapsed.count()/calls;
+
+}
+
+#endif
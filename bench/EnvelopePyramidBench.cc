@@ -0,0 +1,163 @@
+// Envelopes per second of the min/max pyramid against scanning the samples of a long frame, with a check of
+// ranges and envelopes against a brute force min/max
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "EnvelopePyramid.hh"
+#include "BenchReport.hh"
+#include "SyntheticFrames.hh"
+
+namespace {
+
+Min_max bruteRange(const std::vector<uint8_t>& samples, size_t begin, size_t end) {
+
+	std::pair<std::vector<uint8_t>::const_iterator, std::vector<uint8_t>::const_iterator> result =
+				std::minmax_element(samples.begin() + begin, samples.begin() + end);
+	Min_max min_max = {*result.first, *result.second};
+	return min_max;
+
+}
+
+//! Buckets as documented by EnvelopePyramid::envelope(), by scanning every sample
+void bruteEnvelope(const std::vector<uint8_t>& samples, size_t begin, size_t end, size_t buckets,
+			std::vector<Min_max>& result) {
+
+	result.resize(buckets);
+	uint64_t width = end - begin;
+	for(size_t i = 0; i != buckets; ++i) {
+		size_t first = begin + width*i/buckets;
+		size_t last = begin + width*(i + 1)/buckets;
+		result[i] = bruteRange(samples, first, std::max(last, first + 1));
+	}
+
+}
+
+bool same(const Min_max& a, const Min_max& b) {
+
+	return a.min == b.min && a.max == b.max;
+
+}
+
+//! @return Range of random length, from single samples to the whole frame, at a random place
+std::pair<size_t, size_t> randomRange(std::mt19937& random, size_t size) {
+
+	size_t length = std::max<size_t>(1, exp2(std::uniform_real_distribution<double>(0.0, log2(size))(random)));
+	size_t begin = std::uniform_int_distribution<size_t>(0, size - length)(random);
+	return std::make_pair(begin, begin + length);
+
+}
+
+//! @return Description of the first difference to the brute force min/max, empty if there is none
+std::string check(const std::vector<uint8_t>& samples) {
+
+	// Chunks of random length, most of them not a multiple of the block size
+	std::mt19937 random(1);
+	EnvelopePyramid pyramid;
+	for(size_t done = 0; done != samples.size(); ) {
+		size_t count = std::min<size_t>(samples.size() - done, random() % 5000);
+		pyramid.append(samples.data() + done, count);
+		done += count;
+	}
+	EnvelopePyramid assigned;
+	assigned.assign(samples);
+	if(pyramid.samples() != samples || assigned.size() != samples.size())
+		return "samples differ";
+
+	for(int r = 0; r != 5000; ++r) {
+		std::pair<size_t, size_t> range = randomRange(random, samples.size());
+		Min_max expected = bruteRange(samples, range.first, range.second);
+		if(!same(pyramid.range(range.first, range.second), expected) ||
+					!same(assigned.range(range.first, range.second), expected))
+			return "range " + std::to_string(range.first) + " to " + std::to_string(range.second) + " differs";
+	}
+
+	// Fewer buckets than samples, and more so buckets get the sample they start at
+	std::vector<Min_max> envelope;
+	std::vector<Min_max> expected;
+	std::vector<float> min;
+	std::vector<float> max;
+	for(int r = 0; r != 500; ++r) {
+		std::pair<size_t, size_t> range = randomRange(random, samples.size());
+		size_t buckets = 1 + random() % (r % 2 ? 2000 : 3*(range.second - range.first));
+		pyramid.envelope(range.first, range.second, buckets, envelope);
+		bruteEnvelope(samples, range.first, range.second, buckets, expected);
+		for(size_t i = 0; i != buckets; ++i)
+			if(!same(envelope[i], expected[i]))
+				return "bucket " + std::to_string(i) + " of " + std::to_string(buckets) + " of range " +
+							std::to_string(range.first) + " to " + std::to_string(range.second) + " differs";
+
+		// Bigger raw value is a smaller voltage
+		pyramid.envelope(range.first, range.second, buckets, 0.5f, 2.0f, min, max);
+		for(size_t i = 0; i != buckets; ++i)
+			if(fabs(min[i] - SampleScaler::toVolts(expected[i].max, 0.5f, 2.0f)) > 1e-4 ||
+						fabs(max[i] - SampleScaler::toVolts(expected[i].min, 0.5f, 2.0f)) > 1e-4)
+				return "volts of bucket " + std::to_string(i) + " differ";
+	}
+
+	// Empty ranges and ranges past the end
+	const size_t invalid[][2] = {{0, 0}, {100, 100}, {100, 99}, {0, samples.size() + 1},
+				{samples.size(), samples.size() + 1}};
+	for(const size_t* range : invalid) {
+		try {
+			pyramid.range(range[0], range[1]);
+			return "invalid range " + std::to_string(range[0]) + " to " + std::to_string(range[1]) + " accepted";
+		}
+		catch(std::out_of_range&) {
+		}
+		try {
+			pyramid.envelope(range[0], range[1], 10, envelope);
+			return "invalid envelope " + std::to_string(range[0]) + " to " + std::to_string(range[1]) + " accepted";
+		}
+		catch(std::out_of_range&) {
+		}
+	}
+	return "";
+
+}
+
+void measure(BenchReport& report, const std::string& name, const std::vector<uint8_t>& samples, size_t buckets) {
+
+	EnvelopePyramid pyramid;
+	double append = secondsPerCall([&]() {
+		pyramid.clear();
+		pyramid.append(samples.data(), samples.size());
+	});
+
+	std::vector<Min_max> envelope;
+	double fast = secondsPerCall([&]() {
+		pyramid.envelope(0, samples.size(), buckets, envelope);
+	});
+	double plain = secondsPerCall([&]() {
+		bruteEnvelope(samples, 0, samples.size(), buckets, envelope);
+	});
+
+	report.add("append", name, samples.size()/append/1e6, "Msamples/s");
+	report.add("envelope", name, 1/fast, "envelopes/s");
+	report.add("plain scan", name, 1/plain, "envelopes/s");
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("envelope", argc, argv);
+
+	std::vector<Waveform_frame> frames = sineFrames(3.0, 15000.0, 3.0, 1, 1048573, 1e-6, 0.0);
+	const std::vector<uint8_t>& samples = frames[0].samples;
+	std::string error = check(samples);
+	if(!error.empty()) {
+		report.note(error);
+		return 1;
+	}
+
+	measure(report, "1M to 1000", samples, 1000);
+	measure(report, "1M to 100k", samples, 100000);
+
+}
@@ -0,0 +1,131 @@
+// Frames per second the accumulators take, alone and while another thread takes snapshots continuously. The
+// snapshots are checked against a scalar accumulation of the frames.
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <math.h>
+#include "FrameAccumulator.hh"
+#include "BenchReport.hh"
+#include "SyntheticFrames.hh"
+
+namespace {
+
+//! @param count Frames added, cycling through frames
+//! @return false if the snapshot does not match a scalar accumulation of the frames
+bool check(BenchReport& report, const std::string& name, const std::vector<Waveform_frame>& frames, size_t count,
+			unsigned flags, const Accumulator_snapshot& snapshot) {
+
+	size_t samples = frames[0].samples.size();
+	std::vector<uint64_t> sums(samples, 0);
+	std::vector<uint8_t> min(samples, 255);
+	std::vector<uint8_t> max(samples, 0);
+	std::vector<uint32_t> histogram(samples*256, 0);
+	for(size_t f = 0; f != frames.size() && f != count; ++f) {
+		size_t uses = count/frames.size() + (f < count % frames.size());
+		const std::vector<uint8_t>& raw = frames[f].samples;
+		for(size_t i = 0; i != samples; ++i) {
+			sums[i] += uses*raw[i];
+			min[i] = std::min(min[i], raw[i]);
+			max[i] = std::max(max[i], raw[i]);
+			histogram[i*256 + 255 - raw[i]] += uses;
+		}
+	}
+
+	std::string error;
+	if(snapshot.frames != count)
+		error = "has " + std::to_string(snapshot.frames) + " frames instead of " + std::to_string(count);
+	for(size_t i = 0; i != samples && error.empty(); ++i) {
+		// Bigger raw value is a smaller voltage
+		if((flags & Accumulate_mean) &&
+					fabs(snapshot.mean[i] - SampleScaler::toVolts(double(sums[i])/count, 0.0f, 1.0f)) > 1e-4)
+			error = "mean of sample " + std::to_string(i) + " is " + std::to_string(snapshot.mean[i]);
+		else if((flags & Accumulate_peak) && (fabs(snapshot.min[i] - SampleScaler::toVolts(max[i], 0.0f, 1.0f)) > 1e-4 ||
+					fabs(snapshot.max[i] - SampleScaler::toVolts(min[i], 0.0f, 1.0f)) > 1e-4))
+			error = "peak of sample " + std::to_string(i) + " is " + std::to_string(snapshot.min[i]) + " to " +
+						std::to_string(snapshot.max[i]);
+		else if((flags & Accumulate_exponential) &&
+					(snapshot.exponential[i] < SampleScaler::toVolts(max[i] + 1, 0.0f, 1.0f) ||
+					snapshot.exponential[i] > SampleScaler::toVolts(min[i] - 1, 0.0f, 1.0f)))
+			error = "exponential average of sample " + std::to_string(i) + " is " +
+						std::to_string(snapshot.exponential[i]) + ", outside the samples";
+	}
+	if(error.empty() && (flags & Accumulate_histogram) && snapshot.histogram != histogram)
+		error = "histogram differs";
+	if(!error.empty())
+		report.note(name + " snapshot " + error);
+	return error.empty();
+
+}
+
+//! @return false if a snapshot does not match the frames added
+bool measure(BenchReport& report, const std::string& name, size_t samples, unsigned flags, bool snapshots) {
+
+	std::vector<Waveform_frame> frames = noiseFrames(100, 149, 64, samples, 1e-6);
+
+	// Every snapshot taken while frames are added has to be whole: as many histogram hits as samples accumulated,
+	// and never fewer frames than the snapshot before
+	FrameAccumulator accumulator(samples, flags);
+	std::atomic<bool> stop(false);
+	std::atomic<bool> torn(false);
+	size_t taken = 0;
+	std::thread reader;
+	if(snapshots)
+		reader = std::thread([&]() {
+			Accumulator_snapshot snapshot;
+			size_t frames = 0;
+			while(!stop) {
+				accumulator.snapshot(snapshot);
+				++taken;
+				uint64_t hits = 0;
+				for(uint32_t count : snapshot.histogram)
+					hits += count;
+				if(snapshot.frames < frames || ((flags & Accumulate_histogram) && hits != snapshot.frames*samples))
+					torn = true;
+				frames = snapshot.frames;
+			}
+		});
+
+	const size_t count = 2000000000/(samples*16);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i != count; ++i)
+		accumulator.add(frames[i % frames.size()]);
+	std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+	stop = true;
+	if(reader.joinable())
+		reader.join();
+
+	report.add("accumulate", name, count/time.count(), "frames/s");
+	if(snapshots)
+		report.add("snapshots", name, taken/time.count(), "snapshots/s");
+
+	if(torn) {
+		report.note(name + " took a snapshot that does not add up");
+		return false;
+	}
+	Accumulator_snapshot snapshot;
+	accumulator.snapshot(snapshot);
+	return check(report, name, frames, count, flags, snapshot);
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("accumulator", argc, argv);
+	if(!measure(report, "mean 600", 600, Accumulate_mean, false) ||
+				!measure(report, "exponential 600", 600, Accumulate_exponential, false) ||
+				!measure(report, "peak 600", 600, Accumulate_peak, false) ||
+				!measure(report, "histogram 600", 600, Accumulate_histogram, false) ||
+				!measure(report, "all 600", 600, Accumulate_all, false) ||
+				!measure(report, "all 600 + snapshots", 600, Accumulate_all, true) ||
+				!measure(report, "all 16k", 16384, Accumulate_all, false))
+		return 1;
+
+}
@@ -0,0 +1,258 @@
+// Compression ratio and speed of the frame codec against storing the raw samples. Synthetic frames are
+// always measured, frames of a capture file are measured too if one is given as the argument. Capture files
+// of raw and compressed frames are written and read back, with and without their index.
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <math.h>
+#include "FrameCodec.hh"
+#include "CaptureFile.hh"
+#include "BenchReport.hh"
+
+namespace {
+
+typedef std::vector<std::vector<uint8_t> > Frames;
+
+//! Quantized like the scope does it, 25 steps per division around 125
+Frames sine(size_t frames, size_t samples, double noise) {
+
+	std::mt19937 random(1);
+	std::normal_distribution<double> distribution(0.0, noise);
+	Frames result(frames, std::vector<uint8_t>(samples));
+	for(size_t f = 0; f != frames; ++f)
+		for(size_t i = 0; i != samples; ++i) {
+			double value = 125 + 75*sin(2*M_PI*(i + 7*f)/150.0) + (noise > 0 ? distribution(random) : 0);
+			result[f][i] = std::min(255.0, std::max(0.0, round(value)));
+		}
+	return result;
+
+}
+
+Frames square(size_t frames, size_t samples) {
+
+	Frames result(frames, std::vector<uint8_t>(samples));
+	for(size_t f = 0; f != frames; ++f)
+		for(size_t i = 0; i != samples; ++i)
+			result[f][i] = ((i + f)/100) % 2 ? 175 : 75;
+	return result;
+
+}
+
+Frames noise(size_t frames, size_t samples) {
+
+	std::mt19937 random(2);
+	Frames result(frames, std::vector<uint8_t>(samples));
+	for(size_t f = 0; f != frames; ++f)
+		for(size_t i = 0; i != samples; ++i)
+			result[f][i] = random();
+	return result;
+
+}
+
+//! @return false if a frame does not survive the round trip
+bool measure(BenchReport& report, const std::string& name, const Frames& frames) {
+
+	size_t raw = 0;
+	size_t encoded = 0;
+	std::vector<std::vector<uint8_t> > data(frames.size());
+	std::vector<uint8_t> decoded;
+	std::vector<uint8_t> copy;
+	const int rounds = 20;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		for(size_t f = 0; f != frames.size(); ++f) {
+			copy.resize(frames[f].size());
+			memcpy(copy.data(), frames[f].data(), frames[f].size());
+		}
+	std::chrono::duration<double> copy_time = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		for(size_t f = 0; f != frames.size(); ++f)
+			encodeFrame(frames[f], data[f]);
+	std::chrono::duration<double> encode_time = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		for(size_t f = 0; f != frames.size(); ++f)
+			decodeFrame(data[f].data(), data[f].size(), decoded);
+	std::chrono::duration<double> decode_time = std::chrono::steady_clock::now() - start;
+
+	for(size_t f = 0; f != frames.size(); ++f) {
+		raw += frames[f].size();
+		encoded += data[f].size();
+		decodeFrame(data[f].data(), data[f].size(), decoded);
+		if(decoded != frames[f]) {
+			report.note(name + ": frame " + std::to_string(f) + " does not survive the round trip");
+			return false;
+		}
+	}
+
+	double megabytes = (double)raw*rounds/1e6;
+	report.add("ratio", name, (double)raw/encoded, "raw/encoded");
+	report.add("raw copy", name, megabytes/copy_time.count(), "MB/s");
+	report.add("encode", name, megabytes/encode_time.count(), "MB/s");
+	report.add("decode", name, megabytes/decode_time.count(), "MB/s");
+	return true;
+
+}
+
+typedef std::chrono::system_clock::time_point Time;
+
+//! @return Description of the first difference between the capture and the frames, empty if there is none
+std::string verify(const CaptureReader& reader, const std::vector<Waveform_frame>& frames, bool compressed) {
+
+	if(reader.size() != frames.size())
+		return std::to_string(reader.size()) + " frames instead of " + std::to_string(frames.size());
+	Waveform_frame frame;
+	std::vector<Time> times;
+	for(size_t i = 0; i != frames.size(); ++i) {
+		const Waveform_frame& expected = frames[i];
+		reader.read(i, frame);
+		if(frame.samples != expected.samples || frame.channel != expected.channel ||
+					frame.timestamp != expected.timestamp || reader.timestamp(i) != expected.timestamp ||
+					reader.channel(i) != expected.channel || frame.volt_scale != expected.volt_scale ||
+					frame.volt_offset != expected.volt_offset || frame.timescale != expected.timescale ||
+					frame.time_offset != expected.time_offset || frame.sample_interval != expected.sample_interval)
+			return "frame " + std::to_string(i) + " differs";
+		// Raw samples are mapped directly, compressed ones only through read()
+		size_t count = 0;
+		try {
+			const uint8_t* samples = reader.samples(i, count);
+			if(compressed || count != expected.samples.size() ||
+						memcmp(samples, expected.samples.data(), count) != 0)
+				return "samples of frame " + std::to_string(i) + " differ";
+		}
+		catch(std::logic_error&) {
+			if(!compressed)
+				return "samples of raw frame " + std::to_string(i) + " are not mapped";
+		}
+		times.push_back(expected.timestamp);
+	}
+
+	// Seek to random times, exact frame times and past both ends
+	std::mt19937 random(3);
+	std::uniform_int_distribution<int64_t> offset(-2000000, 2000000);
+	for(int r = 0; r != 2000; ++r) {
+		Time begin = times[random() % times.size()] + std::chrono::nanoseconds(r % 2 ? offset(random) : 0);
+		Time end = begin + std::chrono::nanoseconds(std::abs(offset(random))*(r % 5));
+		if(r == 0)
+			begin = times.front() - std::chrono::seconds(1);
+		if(r == 1)
+			end = times.back() + std::chrono::seconds(1);
+		size_t first = std::lower_bound(times.begin(), times.end(), begin) - times.begin();
+		size_t last = std::lower_bound(times.begin(), times.end(), end) - times.begin();
+		if(reader.findFrame(begin) != first)
+			return "seeking found frame " + std::to_string(reader.findFrame(begin)) + " instead of " +
+						std::to_string(first);
+		if(reader.findRange(begin, end) != std::make_pair(first, last))
+			return "range of frames " + std::to_string(first) + " to " + std::to_string(last) + " not found";
+	}
+	return "";
+
+}
+
+//! Writes a capture file of segments of 256 frames, two channels acquired together, reads it back with its
+//! index and then without the trailer, so it has to be scanned
+//! @return false if the capture does not read back as written
+bool roundTrip(BenchReport& report, const std::string& name, bool compress) {
+
+	char path[] = "/tmp/codec_bench_XXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0) {
+		report.note(name + ": could not create a capture file");
+		return false;
+	}
+	close(fd);
+
+	Frames samples = sine(2501, 600, 1.5);
+	std::vector<Waveform_frame> frames(samples.size());
+	Time start = std::chrono::system_clock::now();
+	for(size_t i = 0; i != frames.size(); ++i) {
+		Waveform_frame& frame = frames[i];
+		frame.samples = samples[i];
+		frame.channel = i % 2 ? CH2 : CH1;
+		frame.timestamp = start + std::chrono::microseconds(1000*(i/2) + 37*(i % 7));
+		frame.volt_scale = i % 2 ? 0.5 : 2.0;
+		frame.volt_offset = 0.25*(i % 5);
+		frame.timescale = 5e-5;
+		frame.time_offset = 1e-6*(i % 3);
+		frame.sample_interval = 1e-6;
+	}
+	// Both channels of an acquisition have the same time
+	for(size_t i = 1; i < frames.size(); i += 2)
+		frames[i].timestamp = frames[i - 1].timestamp;
+
+	std::string error;
+	try {
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		CaptureWriter writer(path, 256, compress);
+		for(const Waveform_frame& frame : frames)
+			writer.append(frame);
+		writer.close();
+		std::chrono::duration<double> time = std::chrono::steady_clock::now() - begin;
+		report.add("capture write", name, frames.size()*600/1e6/time.count(), "MB/s");
+
+		{
+			CaptureReader reader(path);
+			error = reader.indexed() ? verify(reader, frames, compress) : "index not found";
+		}
+
+		// Without the trailer the index is not found and the segments are scanned
+		struct stat status;
+		if(error.empty() && (stat(path, &status) != 0 || truncate(path, status.st_size - sizeof(capture::Trailer)) != 0))
+			error = "could not truncate the capture file";
+		if(error.empty()) {
+			CaptureReader reader(path);
+			error = reader.indexed() ? "index found without a trailer" : verify(reader, frames, compress);
+			if(!error.empty())
+				error = "scanned: " + error;
+		}
+	}
+	catch(std::exception& e) {
+		error = e.what();
+	}
+	unlink(path);
+	if(!error.empty()) {
+		report.note(name + ": " + error);
+		return false;
+	}
+	return true;
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("codec", argc, argv);
+	if(!measure(report, "sine 600", sine(2000, 600, 0.0)) || !measure(report, "noisy sine 600", sine(2000, 600, 1.5)) ||
+				!measure(report, "noisy sine 16k", sine(100, 16384, 1.5)) ||
+				!measure(report, "square 16k", square(100, 16384)) || !measure(report, "noise 16k", noise(100, 16384)))
+		return 1;
+	if(!roundTrip(report, "raw", false) || !roundTrip(report, "compressed", true))
+		return 1;
+
+	if(!report.arguments().empty()) {
+		const std::string& path = report.arguments()[0];
+		CaptureReader reader(path);
+		Frames frames(reader.size());
+		Waveform_frame frame;
+		for(size_t i = 0; i != reader.size(); ++i) {
+			reader.read(i, frame);
+			frames[i] = frame.samples;
+		}
+		if(!measure(report, path, frames))
+			return 1;
+	}
+
+}
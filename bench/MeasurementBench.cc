@@ -0,0 +1,77 @@
+// Frames per second of the measurement engine, with a check of the measurements of synthetic frames
+// whose values are known
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include "Measurements.hh"
+#include "BenchReport.hh"
+#include "SyntheticFrames.hh"
+
+namespace {
+
+//! Square wave of 1 kHz from -2 V to 2 V with a linear 10 sample edge and 40% duty cycle at the middle of the edges
+Square_wave square() {
+
+	Square_wave wave;
+	wave.low = -2.0;
+	wave.high = 2.0;
+	wave.duty = 0.4;
+	wave.edge = 10.0;
+	wave.noise = 1.0;
+	return wave;
+
+}
+
+const double sample_interval = 1e-5;
+
+//! @return false if a measurement of a frame is off the square wave
+bool measure(BenchReport& report, const std::string& name, const std::vector<Waveform_frame>& frames) {
+
+	MeasurementEngine engine;
+	std::vector<Waveform_measurements> results;
+	const int rounds = 20;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		engine.measure(frames, results);
+	std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+	const Waveform_measurements& m = results[0];
+	report.add("measure", name, frames.size()*rounds/time.count(), "frames/s");
+	report.add("amplitude", name, m.amplitude, "V");
+	report.add("frequency", name, m.frequency, "Hz");
+	report.add("duty cycle", name, m.duty_cycle, "");
+	report.add("rise time", name, m.rise_time, "s");
+	report.add("fall time", name, m.fall_time, "s");
+
+	// 10% to 90% of a linear edge is 80% of it
+	Square_wave wave = square();
+	double edge_time = 0.8*wave.edge*sample_interval;
+	for(size_t f = 0; f != results.size(); ++f) {
+		const Waveform_measurements& r = results[f];
+		if(!near(r.amplitude, wave.high - wave.low, 0.02) || !near(r.frequency, 1/(wave.period*sample_interval), 0.005) ||
+					!near(r.duty_cycle, wave.duty, 0.02) || !near(r.rise_time, edge_time, 0.05) ||
+					!near(r.fall_time, edge_time, 0.05)) {
+			report.note(name + " frame " + std::to_string(f) + " measured amplitude " + std::to_string(r.amplitude) +
+						", frequency " + std::to_string(r.frequency) + ", duty " + std::to_string(r.duty_cycle) +
+						", rise " + std::to_string(r.rise_time) + ", fall " + std::to_string(r.fall_time));
+			return false;
+		}
+	}
+	return true;
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("measure", argc, argv);
+	if(!measure(report, "square 600", squareFrames(square(), 10000, 600, sample_interval, 13.0)) ||
+				!measure(report, "square 16k", squareFrames(square(), 400, 16384, sample_interval, 13.0)) ||
+				!measure(report, "square 1M", squareFrames(square(), 5, 1048576, sample_interval, 13.0)))
+		return 1;
+
+}
@@ -0,0 +1,623 @@
+// The acquisition pipeline piece by piece: scaling the samples to volts, parsing responses, the enum tables,
+// whole getData() round trips against a ScopeEmulator, unpaced and at 38400 baud on its pty and over TCP, and
+// getData() replayed from a trace with no link at all. The worker thread of UsbtmcTransport is run on the pty
+// of the emulator too, the program fails if its queries or a cancelled read do not complete. A ScopeManager
+// acquires from two emulators at once, the program fails if a frame set is wrong. Frames are streamed into
+// rings that drop and overwrite frames, and with timeouts, the program fails if a wrong frame comes out.
+// getSettings() is timed against the individual getters at 38400 baud and has to report what they do.
+// The serial speed is negotiated with emulators that take commands only at the rate they run at and refuse
+// rates above a limit, the program fails if the rate chosen is not the highest that works.
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "RigolScope.hh"
+#include "ScopeManager.hh"
+#include "Transport.hh"
+#include "SampleScaler.hh"
+#include "ScpiNumber.hh"
+#include "ScopeStrings.hh"
+#include "ScopeEmulator.hh"
+#include "BenchReport.hh"
+
+namespace {
+
+volatile double sink;
+
+void scaling(BenchReport& report, size_t samples) {
+
+	std::vector<uint8_t> raw(samples);
+	for(size_t i = 0; i != samples; ++i)
+		raw[i] = 125 + (i % 100);
+	std::vector<float> data(samples);
+	std::string name = std::to_string(samples) + " samples";
+
+	// The arithmetic done per sample before the lookup table
+	double formula = secondsPerCall([&]() {
+		float volt_scale = 0.5;
+		float volt_offset = 0.1;
+		for(size_t i = 0; i != samples; ++i)
+			data[i] = (125.0 - (float)raw[i])*volt_scale/25 - volt_offset;
+		sink = data[samples/2];
+	});
+	report.add("scale formula", name, formula*1e9/samples, "ns/sample");
+
+	SampleScaler scaler;
+	double table = secondsPerCall([&]() {
+		scaler.configure(0.1, 0.5);
+		scaler.convert(raw, data);
+		sink = data[samples/2];
+	});
+	report.add("scale table", name, table*1e9/samples, "ns/sample");
+
+}
+
+void parsing(BenchReport& report) {
+
+	const std::vector<std::string> floats = {"1.000e+00", "-5.000e-01", "1.20", "-0.32", "5.000e-07", "2.000e-03"};
+	const std::vector<std::string> integers = {"16384", "8192", "600", "1048576"};
+	const size_t rounds = 1000;
+
+	double nr3 = secondsPerCall([&]() {
+		for(size_t r = 0; r != rounds; ++r)
+			for(const std::string& response : floats) {
+				double value;
+				parseScpiNumber(response.data(), response.data() + response.size(), value);
+				sink = value;
+			}
+	});
+	report.add("parse", "double", nr3*1e9/(rounds*floats.size()), "ns/call");
+
+	double nr1 = secondsPerCall([&]() {
+		for(size_t r = 0; r != rounds; ++r)
+			for(const std::string& response : integers) {
+				size_t value;
+				parseScpiNumber(response.data(), response.data() + response.size(), value);
+				sink = value;
+			}
+	});
+	report.add("parse", "size_t", nr1*1e9/(rounds*integers.size()), "ns/call");
+
+	double to_float = secondsPerCall([&]() {
+		for(size_t r = 0; r != rounds; ++r)
+			for(const std::string& response : floats)
+				sink = scpiToFloat(response);
+	});
+	report.add("parse", "scpiToFloat", to_float*1e9/(rounds*floats.size()), "ns/call");
+
+}
+
+void tables(BenchReport& report) {
+
+	const std::vector<std::string> statuses = {"RUN", "STOP", "T'D", "WAIT", "AUTO"};
+	const std::vector<std::string> modes = {"EDGE", "PULSE", "VIDEO", "SLOPE", "PATTERN", "DURATION", "ALTERNATION"};
+	const size_t rounds = 1000;
+
+	double from_string = secondsPerCall([&]() {
+		for(size_t r = 0; r != rounds; ++r) {
+			for(const std::string& status : statuses)
+				sink = stringEnum<Trigger_status>(status);
+			for(const std::string& mode : modes)
+				sink = stringEnum<Trigger_mode>(mode);
+		}
+	});
+	report.add("enum table", "string to enum", from_string*1e9/(rounds*(statuses.size() + modes.size())), "ns/lookup");
+
+	// Through a volatile so the lookups are not folded at compile time
+	volatile int value = 0;
+	double to_string = secondsPerCall([&]() {
+		for(size_t r = 0; r != rounds; ++r)
+			for(int i = 0; i != 7; ++i) {
+				value = i;
+				sink = enumString((Trigger_mode)value).size();
+			}
+	});
+	report.add("enum table", "enum to string", to_string*1e9/(rounds*7), "ns/lookup");
+
+}
+
+void roundTrips(BenchReport& report, const std::string& link, bool paced, bool tcp = false) {
+
+	Emulator_config config;
+	config.baud = Baud_38400;
+	config.pace = paced;
+	config.tcp = tcp;
+	config.signals[0].noise = 0.05;
+	ScopeEmulator emulator(config);
+	emulator.start();
+
+	RigolScope scope(emulator.getDevice(), Baud_38400);
+	double min_seconds = paced ? 1.0 : 0.5;
+
+	double query = secondsPerCall([&]() {
+		sink = scope.getTimescale();
+	}, min_seconds);
+	report.add("query", link, query*1e6, "us/query");
+
+	std::vector<float> data;
+	double normal = secondsPerCall([&]() {
+		scope.getData(CH1, data);
+		sink = data[0];
+	}, min_seconds);
+	report.add("getData", link, 1/normal, "frames/s");
+	report.add("getData", link, normal*1e9/data.size(), "ns/sample");
+
+	if(paced)
+		return;
+
+	Waveform_frame frame;
+	double long_memory = secondsPerCall([&]() {
+		scope.getLongRawData(CH1, frame);
+		sink = frame.samples[0];
+	}, min_seconds);
+	report.add("getLongRawData", link, 1/long_memory, "frames/s");
+	report.add("getLongRawData", link, long_memory*1e9/frame.samples.size(), "ns/sample");
+
+}
+
+//! Queries through UsbtmcTransport, there is no usbtmc device here but the worker does the same blocking
+//! reads and writes on a pty. A read that nothing answers is cancelled and has to complete right away.
+//! @return false if a query failed or the cancelled read did not complete with operation_aborted
+bool usbtmcWorker(BenchReport& report) {
+
+	Emulator_config config;
+	config.pace = false;
+	ScopeEmulator emulator(config);
+	emulator.start();
+
+	boost::asio::io_service io;
+	UsbtmcTransport transport(io, emulator.getDevice());
+	Transport_stream stream(io, transport);
+	boost::asio::streambuf response;
+	const std::string command = ":TIM:SCAL?\n";
+	bool answered = true;
+
+	double query = secondsPerCall([&]() {
+		boost::asio::async_write(stream, boost::asio::buffer(command), [](const boost::system::error_code&, size_t) {});
+		boost::asio::async_read_until(stream, response, '\n', [&](const boost::system::error_code& error, 
+					size_t size) {
+			answered = answered && !error;
+			response.consume(size);
+		});
+		io.run();
+		io.restart();
+	}, 0.5);
+	report.add("query", "usbtmc worker on pty", query*1e6, "us/query");
+
+	char data[64];
+	boost::system::error_code result;
+	std::chrono::steady_clock::time_point cancelled;
+	transport.asyncReadSome(data, sizeof(data), [&](const boost::system::error_code& error, size_t) {
+		result = error;
+	});
+	boost::asio::deadline_timer timer(io, boost::posix_time::milliseconds(10));
+	timer.async_wait([&](const boost::system::error_code&) {
+		cancelled = std::chrono::steady_clock::now();
+		transport.cancel();
+	});
+	io.run();
+	double cancel = std::chrono::duration<double>(std::chrono::steady_clock::now() - cancelled).count();
+	report.add("cancel read", "usbtmc worker on pty", cancel*1e6, "us");
+
+	return answered && result == boost::asio::error::operation_aborted;
+
+}
+
+//! @return Peak to peak volts of a frame
+double peakToPeak(const Waveform_frame& frame) {
+
+	std::vector<float> data;
+	VoltageView(frame).convert(data);
+	std::pair<std::vector<float>::iterator, std::vector<float>::iterator> range =
+				std::minmax_element(data.begin(), data.end());
+	return *range.second - *range.first;
+
+}
+
+//! Acquires both channels of two emulators, with a signal of a different amplitude on every input, through a
+//! ScopeManager with a pool of four threads. Then the second emulator stops answering.
+//! @return Description of the first frame set that is wrong, empty if there is none
+std::string manager(BenchReport& report) {
+
+	const double amplitudes[2][2] = {{2.0, 1.0}, {4.0, 0.5}};
+	std::unique_ptr<ScopeEmulator> emulators[2];
+	ScopeManager manager(4);
+	for(size_t s = 0; s != 2; ++s) {
+		Emulator_config config;
+		config.pace = false;
+		config.data_latency = std::chrono::milliseconds(20);
+		for(size_t c = 0; c != 2; ++c)
+			config.signals[c].amplitude = amplitudes[s][c];
+		emulators[s].reset(new ScopeEmulator(config));
+		emulators[s]->start();
+		manager.addScope(emulators[s]->getDevice(), Baud_38400);
+		manager.getScope(s).setSerialTimeout(boost::posix_time::milliseconds(300));
+	}
+
+	const std::vector<Acquisition> acquisitions = manager.allScopes({CH1, CH2});
+	for(int r = 0; r != 10; ++r) {
+		Frame_set set = manager.acquire(acquisitions);
+		std::chrono::system_clock::time_point end = std::chrono::system_clock::now();
+		if(set.frames.size() != 4 || set.errors.size() != 4)
+			return std::to_string(set.frames.size()) + " frames in a set of 4";
+		for(size_t i = 0; i != 4; ++i) {
+			const Waveform_frame& frame = set.frames[i];
+			const Acquisition& acquisition = acquisitions[i];
+			if(set.errors[i])
+				return "frame " + std::to_string(i) + " failed: " + set.errors[i].message();
+			double amplitude = amplitudes[acquisition.scope][acquisition.chan - 1];
+			if(frame.channel != acquisition.chan || frame.samples.empty() || frame.timestamp < set.start ||
+						frame.timestamp > end || fabs(peakToPeak(frame) - amplitude) > 0.1)
+				return "frame " + std::to_string(i) + " is not from channel " + std::to_string(acquisition.chan) +
+							" of scope " + std::to_string(acquisition.scope);
+		}
+		if(set.spread <= std::chrono::system_clock::duration(0) || set.spread > end - set.start)
+			return "spread of a set is not between its frames";
+	}
+
+	double acquire = secondsPerCall([&]() {
+		manager.acquire(acquisitions);
+	}, 0.5);
+	report.add("acquire", "2 scopes x 2 channels", 1/acquire, "sets/s");
+
+	if(!manager.acquire(std::vector<Acquisition>()).frames.empty())
+		return "empty set has frames";
+	try {
+		Acquisition missing = {2, CH1};
+		manager.acquire({missing});
+		return "acquired from a scope that does not exist";
+	}
+	catch(std::out_of_range&) {
+	}
+
+	// Only the frames of the scope that does not answer fail
+	emulators[1]->stop();
+	Frame_set set = manager.acquire(acquisitions);
+	if(set.errors[0] || set.errors[1] || !set.errors[2] || !set.errors[3])
+		return "errors of a set with a silent scope are not the errors of its frames";
+	return "";
+
+}
+
+//! @return Description of the first frame popped from ring that is not the next frame of the streamed channels,
+//! empty if there is none
+//! @param popped Amount of frames popped
+//! @param after Time the frames have to be acquired after
+std::string popStreamed(FrameRing<Waveform_frame>& ring, const double (&amplitudes)[2], size_t& popped,
+			std::chrono::system_clock::time_point after = std::chrono::system_clock::time_point::min()) {
+
+	Waveform_frame frame;
+	Channel expected = CH1;
+	std::chrono::system_clock::time_point last = after;
+	for(popped = 0; ring.pop(frame); ++popped) {
+		if(popped == 0)
+			expected = frame.channel;
+		if(frame.channel != expected || frame.timestamp <= last ||
+					fabs(peakToPeak(frame) - amplitudes[frame.channel - 1]) > 0.1)
+			return "frame " + std::to_string(popped) + " out of the ring is not the next frame";
+		expected = expected == CH1 ? CH2 : CH1;
+		last = frame.timestamp;
+	}
+	return "";
+
+}
+
+//! Wait while scope streams until done() returns true
+//! \note{Throws the error that stopped the streaming}
+template <class Condition>
+void streamUntil(RigolScope& scope, Condition done) {
+
+	while(!done()) {
+		if(!scope.isStreaming()) {
+			scope.stopStreaming();
+			throw std::runtime_error("Streaming stopped");
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+}
+
+//! Streams both channels of an emulator into a ring that drops new frames and into one that overwrites old
+//! ones, with nothing popping the frames meanwhile. Then the frames time out until the timeout is raised.
+//! @return Description of the first thing that went wrong, empty if nothing did
+std::string streaming(BenchReport& report) {
+
+	const double amplitudes[2] = {2.0, 1.0};
+	Emulator_config config;
+	config.pace = false;
+	for(size_t c = 0; c != 2; ++c)
+		config.signals[c].amplitude = amplitudes[c];
+	ScopeEmulator emulator(config);
+	emulator.start();
+	RigolScope scope(emulator.getDevice(), Baud_38400);
+	size_t popped = 0;
+	std::string error;
+
+	// The first frames stay, the rest are dropped
+	FrameRing<Waveform_frame> dropping(4, Ring_drop_newest);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	scope.startStreaming(dropping, {CH1, CH2});
+	streamUntil(scope, [&]() { return dropping.dropped() >= 20; });
+	scope.stopStreaming();
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	report.add("streaming", "pty unpaced", (dropping.pushed() + dropping.dropped())/time, "frames/s");
+	error = popStreamed(dropping, amplitudes, popped);
+	if(!error.empty() || popped != 4 || dropping.pushed() != 4)
+		return "dropping ring: " + (error.empty() ? std::to_string(popped) + " frames" : error);
+
+	// The frames left are the last ones, all acquired after overwriting started
+	FrameRing<Waveform_frame> overwriting(4, Ring_overwrite_oldest);
+	scope.startStreaming(overwriting, {CH1, CH2});
+	streamUntil(scope, [&]() { return overwriting.overwritten() >= 8; });
+	std::chrono::system_clock::time_point overwritten = std::chrono::system_clock::now();
+	uint64_t pushed = overwriting.pushed();
+	streamUntil(scope, [&]() { return overwriting.pushed() >= pushed + 6; });
+	scope.stopStreaming();
+	error = popStreamed(overwriting, amplitudes, popped, overwritten);
+	if(!error.empty() || popped != 4 || overwriting.pushed() - overwriting.overwritten() != 4)
+		return "overwriting ring: " + (error.empty() ? std::to_string(popped) + " frames" : error);
+
+	// Every frame times out, the data arriving late must not end up in the frames once they arrive in time
+	emulator.stop();
+	config.data_latency = std::chrono::milliseconds(150);
+	ScopeEmulator slow(config);
+	slow.start();
+	RigolScope late(slow.getDevice(), Baud_38400);
+	late.setSerialTimeout(boost::posix_time::milliseconds(100));
+	FrameRing<Waveform_frame> ring(16, Ring_drop_newest);
+	late.startStreaming(ring, {CH1, CH2});
+	streamUntil(late, [&]() { return late.getStreamingTimeouts() >= 3; });
+	late.stopStreaming();
+	if(ring.pushed() != 0)
+		return std::to_string(ring.pushed()) + " frames streamed although every frame timed out";
+
+	late.setSerialTimeout(boost::posix_time::seconds(2));
+	uint64_t timeouts = late.getStreamingTimeouts();
+	late.startStreaming(ring, {CH1, CH2});
+	streamUntil(late, [&]() { return ring.pushed() >= 6; });
+	late.stopStreaming();
+	error = popStreamed(ring, amplitudes, popped);
+	if(!error.empty() || late.getStreamingTimeouts() != timeouts)
+		return "after timeouts: " + (error.empty() ? std::string("timed out with a long timeout") : error);
+	if(late.getVoltScale(CH1) != 1.0f)
+		return "link out of step after streaming";
+	return "";
+
+}
+
+//! Every setting of getSettings() through its getter
+Scope_settings individualSettings(RigolScope& scope, Trigger_mode mode) {
+
+	Scope_settings settings;
+	for(size_t i = 0; i != 2; ++i) {
+		Channel chan = (Channel)(i + 1);
+		Scope_settings::Channel_settings& channel = settings.channel[i];
+		channel.enable = scope.getChannelEnable(chan);
+		channel.mem_depth = scope.getMemDepth(chan);
+		channel.volt_scale = scope.getVoltScale(chan);
+		channel.volt_offset = scope.getVoltOffset(chan);
+		channel.attenuation = scope.getAttenuation(chan);
+		channel.coupling = scope.getCoupling(chan);
+	}
+	settings.timescale = scope.getTimescale();
+	settings.time_offset = scope.getTimeOffset();
+	settings.freq_counter_enable = scope.getFreqCounterEnable();
+	settings.trigger_mode = scope.getTriggerMode();
+	settings.trigger_source = scope.getTriggerSource(mode);
+	if(mode == Edge || mode == Pulse || mode == Video)
+		settings.trigger_level = scope.getTriggerLevel(mode);
+	if(mode == Edge || mode == Pulse || mode == Slope || mode == Pattern || mode == Duration)
+		settings.trigger_sweep = scope.getTriggerSweep(mode);
+	settings.trigger_coupling = scope.getTriggerCoupling(mode);
+	settings.trigger_holdoff = scope.getTriggerHoldoff();
+	settings.trigger_status = scope.getTriggerStatus();
+	settings.edge_trigger_slope = scope.getEdgeTriggerSlope();
+	return settings;
+
+}
+
+bool same(const Scope_settings& a, const Scope_settings& b) {
+
+	for(size_t i = 0; i != 2; ++i) {
+		const Scope_settings::Channel_settings& x = a.channel[i];
+		const Scope_settings::Channel_settings& y = b.channel[i];
+		if(x.enable != y.enable || x.mem_depth != y.mem_depth || x.volt_scale != y.volt_scale ||
+					x.volt_offset != y.volt_offset || x.attenuation != y.attenuation || x.coupling != y.coupling)
+			return false;
+	}
+	return a.timescale == b.timescale && a.time_offset == b.time_offset &&
+				a.freq_counter_enable == b.freq_counter_enable && a.trigger_mode == b.trigger_mode &&
+				a.trigger_source == b.trigger_source && a.trigger_level == b.trigger_level &&
+				a.trigger_sweep == b.trigger_sweep && a.trigger_coupling == b.trigger_coupling &&
+				a.trigger_holdoff == b.trigger_holdoff && a.trigger_status == b.trigger_status &&
+				a.edge_trigger_slope == b.edge_trigger_slope;
+
+}
+
+//! Changes settings away from the defaults of the emulator and reads them with getSettings() and with the
+//! getters, for a trigger mode with level and sweep and for one without sweep
+//! @return Description of the first difference, empty if there is none
+std::string settings(BenchReport& report) {
+
+	Emulator_config config;
+	config.baud = Baud_38400;
+	ScopeEmulator emulator(config);
+	emulator.start();
+	RigolScope scope(emulator.getDevice(), Baud_38400);
+
+	scope.setVoltScale(CH1, 0.5);
+	scope.setVoltOffset(CH2, -0.3);
+	scope.setAttenuation(CH2, 10);
+	scope.setChannelEnable(CH2, false);
+	scope.setTimescale(0.0005);
+	scope.setTimeOffset(0.001);
+	scope.setFreqCounter(true);
+	scope.setTriggerMode(Pulse);
+	scope.setTriggerSource(Pulse, Source_CH2);
+	scope.setTriggerLevel(Pulse, 0.4);
+	scope.setTriggerSweep(Pulse, Sweep_normal);
+	scope.setTriggerCoupling(Pulse, Trig_AC);
+	scope.setTriggerSource(Video, Source_CH2);
+	scope.setTriggerLevel(Video, -0.2);
+	scope.setTriggerCoupling(Video, Trig_HF);
+	scope.setTriggerHoldoff(0.0002);
+	scope.setEdgeTriggerSlope(false);
+
+	const Trigger_mode modes[] = {Pulse, Video};
+	for(Trigger_mode mode : modes) {
+		Scope_settings batched = scope.getSettings(mode);
+		Scope_settings individual = individualSettings(scope, mode);
+		if(!same(batched, individual))
+			return "getSettings(" + std::string(enumString(mode)) + ") differs from the getters";
+	}
+	if(scope.getSettings(Pulse).channel[0].volt_scale != 0.5f || scope.getSettings(Pulse).trigger_sweep != Sweep_normal)
+		return "getSettings() does not report a setting";
+
+	double batched = secondsPerCall([&]() {
+		sink = scope.getSettings(Pulse).timescale;
+	}, 1.0);
+	double individual = secondsPerCall([&]() {
+		sink = individualSettings(scope, Pulse).timescale;
+	}, 1.0);
+	report.add("getSettings", "pty 38400 baud", batched*1e3, "ms");
+	report.add("getters", "pty 38400 baud", individual*1e3, "ms");
+	return "";
+
+}
+
+//! Negotiates the serial speed from 9600 baud with an emulator that drops commands sent at the wrong rate
+//! @param max_baud Highest rate the emulator switches to
+//! @param max_rate Highest rate negotiateSerialSpeed() tries
+//! @return Description of what went wrong, empty if the expected rate was chosen and the link works at it
+std::string negotiate(BenchReport& report, unsigned max_baud, Baud_rate max_rate, Baud_rate expected) {
+
+	Emulator_config config;
+	config.check_line_rate = true;
+	config.max_baud = max_baud;
+	ScopeEmulator emulator(config);
+	emulator.start();
+	RigolScope scope(emulator.getDevice(), Baud_9600);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Baud_rate rate = scope.negotiateSerialSpeed(max_rate);
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::string name = "up to " + std::to_string(max_rate) + ", scope up to " + std::to_string(max_baud);
+	report.add("negotiate", name, time*1e3, "ms");
+	if(rate != expected || scope.getSerialSpeed() != expected)
+		return name + ": negotiated " + std::to_string(rate) + " baud instead of " + std::to_string(expected);
+	if(scope.getVoltScale(CH1) != 1.0f)
+		return name + ": link does not work after negotiating";
+
+	// A rate the scope refuses falls back to the one that works, a lower rate is taken
+	if(max_baud >= 38400)
+		return "";
+	if(scope.setSerialSpeed(Baud_38400) || scope.getSerialSpeed() != expected || scope.getVoltScale(CH1) != 1.0f)
+		return name + ": no fall back from a rate the scope refuses";
+	if(!scope.setSerialSpeed(Baud_4800) || scope.getSerialSpeed() != Baud_4800 || scope.getVoltScale(CH1) != 1.0f)
+		return name + ": a lower rate does not work";
+	return "";
+
+}
+
+//! @return Description of the first negotiation that went wrong, empty if none did
+std::string serialSpeed(BenchReport& report) {
+
+	std::string error = negotiate(report, 19200, Baud_38400, Baud_19200);
+	if(error.empty())
+		error = negotiate(report, 38400, Baud_19200, Baud_19200);
+	if(error.empty())
+		error = negotiate(report, 38400, Baud_38400, Baud_38400);
+	return error;
+
+}
+
+//! Records frames from the emulator and replays them without delays, what is left is the cost of the
+//! RigolScope side of getData()
+void replay(BenchReport& report) {
+
+	const char* path = "pipeline_bench.trace";
+	const size_t frames = 200;
+	std::vector<float> data;
+	{
+		Emulator_config config;
+		config.pace = false;
+		ScopeEmulator emulator(config);
+		emulator.start();
+		RigolScope scope(emulator.getDevice(), Baud_38400);
+		scope.startRecording(path);
+		for(size_t i = 0; i != frames; ++i)
+			scope.getData(CH1, data);
+		scope.stopRecording();
+	}
+
+	double time = 0.0;
+	const int rounds = 5;
+	for(int r = 0; r != rounds; ++r) {
+		RigolScope scope(std::string("replay://") + path + "?speed=0", Baud_38400);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i != frames; ++i)
+			scope.getData(CH1, data);
+		time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	remove(path);
+
+	report.add("getData", "replay", rounds*frames/time, "frames/s");
+	report.add("getData", "replay", time*1e9/(rounds*frames*data.size()), "ns/sample");
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("pipeline", argc, argv);
+
+	scaling(report, 600);
+	scaling(report, 16384);
+	scaling(report, 1048576);
+	parsing(report);
+	tables(report);
+	roundTrips(report, "pty unpaced", false);
+	roundTrips(report, "pty 38400 baud", true);
+	roundTrips(report, "tcp unpaced", false, true);
+	replay(report);
+
+	if(!usbtmcWorker(report)) {
+		report.note("The usbtmc worker failed a query or did not cancel a read");
+		return 1;
+	}
+	std::string error = manager(report);
+	if(!error.empty()) {
+		report.note("ScopeManager: " + error);
+		return 1;
+	}
+	error = serialSpeed(report);
+	if(!error.empty()) {
+		report.note("Serial speed: " + error);
+		return 1;
+	}
+	error = settings(report);
+	if(!error.empty()) {
+		report.note("Settings: " + error);
+		return 1;
+	}
+	try {
+		error = streaming(report);
+	}
+	catch(std::exception& e) {
+		error = e.what();
+	}
+	if(!error.empty()) {
+		report.note("Streaming: " + error);
+		return 1;
+	}
+	return 0;
+
+}
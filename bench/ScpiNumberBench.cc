@@ -0,0 +1,127 @@
+// Microbenchmark of the SCPI number parser against the istringstream based helpers it replaced
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <math.h>
+#include "ScpiNumber.hh"
+#include "BenchReport.hh"
+
+namespace {
+
+float oldConvertToFloat(std::string const& s) {
+
+	std::istringstream i(s);
+	float x;
+	if (!(i >> x))
+		throw std::out_of_range("");
+	return x;
+
+}
+
+size_t oldConvertToSizeT(std::string const& s) {
+
+	std::istringstream i(s);
+	size_t x;
+	if (!(i >> x))
+		throw std::out_of_range("");
+	return x;
+
+}
+
+double oldConvertToDouble(std::string const& s) {
+
+	std::istringstream i(s);
+	double x;
+	if (!(i >> x))
+		throw std::out_of_range("");
+	return x;
+
+}
+
+float oldConvertExponent(std::string number, size_t decimals) {
+
+	float base = 0.0;
+
+	if(decimals == 0)
+		base = oldConvertToFloat(number.substr(0, (decimals + 1)));
+	else
+		base = oldConvertToFloat(number.substr(0, (decimals + 2)));
+
+	float exp = oldConvertToDouble(number.substr((decimals + 4), 2));
+
+	if(number.substr((decimals+3), 1) == "-")
+		exp = -1.0*exp;
+
+	return base*pow(10, exp);
+
+}
+
+template <class Function>
+double nanosecondsPerCall(size_t rounds, size_t calls_per_round, Function function) {
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i != rounds; ++i)
+		function();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count()/(rounds*calls_per_round);
+
+}
+
+volatile double sink;
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("scpi", argc, argv);
+
+	const std::vector<std::string> floats = {"1.000e+00", "-5.000e-01", "1.20", "-0.32", "5.000e-07", "2.000e-03"};
+	const std::vector<std::string> exponents = {"1.00000e+03", "1.00000e+06", "5.00000e-01"};
+	const std::vector<std::string> integers = {"16384", "8192", "600", "1048576"};
+	const size_t rounds = 200000;
+
+	// Check the parsers agree before timing them
+	for(size_t i = 0; i != floats.size(); ++i)
+		if(scpiToFloat(floats[i]) != oldConvertToFloat(floats[i]))
+			report.note("Mismatch for " + floats[i]);
+	for(size_t i = 0; i != integers.size(); ++i)
+		if(scpiToSizeT(integers[i]) != oldConvertToSizeT(integers[i]))
+			report.note("Mismatch for " + integers[i]);
+
+	double old_float = nanosecondsPerCall(rounds, floats.size(), [&]() {
+		for(size_t i = 0; i != floats.size(); ++i)
+			sink = oldConvertToFloat(floats[i]);
+	});
+	double new_float = nanosecondsPerCall(rounds, floats.size(), [&]() {
+		for(size_t i = 0; i != floats.size(); ++i)
+			sink = scpiToFloat(floats[i]);
+	});
+	double old_exponent = nanosecondsPerCall(rounds, exponents.size(), [&]() {
+		for(size_t i = 0; i != exponents.size(); ++i)
+			sink = oldConvertExponent(exponents[i], 5);
+	});
+	double new_exponent = nanosecondsPerCall(rounds, exponents.size(), [&]() {
+		for(size_t i = 0; i != exponents.size(); ++i)
+			sink = scpiToFloat(exponents[i]);
+	});
+	double old_integer = nanosecondsPerCall(rounds, integers.size(), [&]() {
+		for(size_t i = 0; i != integers.size(); ++i)
+			sink = oldConvertToSizeT(integers[i]);
+	});
+	double new_integer = nanosecondsPerCall(rounds, integers.size(), [&]() {
+		for(size_t i = 0; i != integers.size(); ++i)
+			sink = scpiToSizeT(integers[i]);
+	});
+
+	report.add("istringstream", "float (NR2/NR3)", old_float, "ns/call");
+	report.add("scpi parser", "float (NR2/NR3)", new_float, "ns/call");
+	report.add("istringstream", "exponent (NR3)", old_exponent, "ns/call");
+	report.add("scpi parser", "exponent (NR3)", new_exponent, "ns/call");
+	report.add("istringstream", "size_t (NR1)", old_integer, "ns/call");
+	report.add("scpi parser", "size_t (NR1)", new_integer, "ns/call");
+
+}
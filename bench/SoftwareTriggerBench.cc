@@ -0,0 +1,128 @@
+// Search speed of the software trigger, the SSE2 range search against a plain loop and whole triggers
+// over long frames
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <math.h>
+#include "SoftwareTrigger.hh"
+#include "BenchReport.hh"
+#include "SyntheticFrames.hh"
+
+namespace {
+
+size_t scalarFind(const uint8_t* samples, size_t begin, size_t end, int low, int high, bool inside) {
+
+	for(size_t i = begin; i != end; ++i)
+		if((samples[i] >= low && samples[i] <= high) == inside)
+			return i;
+	return end;
+
+}
+
+//! Noisy square wave with a period of 1000 samples, swinging between -1 V and 1 V, low for the first 500 samples
+Waveform_frame square(size_t samples) {
+
+	Square_wave wave;
+	wave.period = 1000.0;
+	wave.noise = 1.0;
+	std::mt19937 random(1);
+	return squareFrame(wave, samples, 1e-6, 500.0, random);
+
+}
+
+//! @param pulse Width of the pulses the trigger finds in samples, 0 if it finds the rising edges
+//! @return false if the events are not the rising edges or high pulses of the square wave
+bool measure(BenchReport& report, const std::string& name, const Waveform_frame& frame, const Soft_trigger& trigger,
+			size_t pulse) {
+
+	SoftwareTrigger engine(trigger);
+	std::vector<Trigger_event> events;
+	const int rounds = 50;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r) {
+		events.clear();
+		engine.scan(frame, events);
+	}
+	std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+	report.add("trigger", name, frame.samples.size()*rounds/time.count()/1e6, "Msamples/s");
+	report.add("events", name, events.size(), "events");
+
+	// The wave rises at sample 500 and then every 1000 samples, an event needs its end inside the frame
+	size_t expected = 0;
+	for(size_t begin = 500; begin + pulse < frame.samples.size(); begin += 1000) {
+		if(expected == events.size()) {
+			report.note(name + " missed the event at sample " + std::to_string(begin));
+			return false;
+		}
+		const Trigger_event& event = events[expected++];
+		if(event.begin != begin || event.sample != begin + pulse ||
+					fabs(event.width - pulse*frame.sample_interval) > frame.sample_interval/2) {
+			report.note(name + " found an event at samples " + std::to_string(event.begin) + " to " +
+						std::to_string(event.sample) + " instead of " + std::to_string(begin) + " to " +
+						std::to_string(begin + pulse));
+			return false;
+		}
+	}
+	if(expected != events.size()) {
+		report.note(name + " found " + std::to_string(events.size()) + " events instead of " + std::to_string(expected));
+		return false;
+	}
+	return true;
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("trigger", argc, argv);
+
+	Waveform_frame frame = square(1048576);
+	const uint8_t* samples = frame.samples.data();
+	size_t size = frame.samples.size();
+	const int rounds = 50;
+
+	// Range that no sample is inside of, so the whole frame gets searched
+	size_t found = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		found += scalarFind(samples, 0, size, 250, 255 - r % 2, true) == size;
+	std::chrono::duration<double> scalar = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		found += findRawRange(samples, 0, size, 250, 255 - r % 2, true) == size;
+	std::chrono::duration<double> simd = std::chrono::steady_clock::now() - start;
+
+	report.add("range search", "plain", size*rounds/scalar.count()/1e6, "Msamples/s");
+	report.add("range search", "findRawRange", size*rounds/simd.count()/1e6, "Msamples/s");
+	if(found != 2*rounds) {
+		report.note("A range search found a sample outside the frame");
+		return 1;
+	}
+
+	// The high half periods are 500 samples wide pulses and runts below 1.5 V
+	Soft_trigger trigger;
+	if(!measure(report, "edge", frame, trigger, 0))
+		return 1;
+	trigger.type = Soft_pulse;
+	trigger.min_width = 400e-6;
+	if(!measure(report, "pulse", frame, trigger, 500))
+		return 1;
+	trigger.type = Soft_runt;
+	trigger.level = -0.5;
+	trigger.upper_level = 1.5;
+	if(!measure(report, "runt", frame, trigger, 500))
+		return 1;
+	trigger.type = Soft_window;
+	trigger.level = 0.5;
+	trigger.upper_level = 1.5;
+	if(!measure(report, "window", frame, trigger, 0))
+		return 1;
+
+}
@@ -0,0 +1,75 @@
+// Spectra per second of the FFT module, on one thread and with the batch transform on all the cores
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <math.h>
+#include "Spectrum.hh"
+#include "BenchReport.hh"
+#include "SyntheticFrames.hh"
+
+namespace {
+
+//! Sine of 3 V (peak) with a period of 150 samples
+const double amplitude = 3.0;
+const double period = 150.0;
+const double sample_interval = 1e-6;
+
+std::vector<Waveform_frame> noisySine(size_t frames, size_t samples) {
+
+	return sineFrames(amplitude, period, 1.5, frames, samples, sample_interval, 7.0);
+
+}
+
+//! @return false if the highest bin of a spectrum is not at the sine
+bool measure(BenchReport& report, const std::string& name, const std::vector<Waveform_frame>& frames) {
+
+	SpectrumAnalyzer analyzer(Window_hann);
+	std::vector<Spectrum> results;
+	const int rounds = 5;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		analyzer.transform(frames, results, 1);
+	std::chrono::duration<double> single = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r != rounds; ++r)
+		analyzer.transform(frames, results, 0);
+	std::chrono::duration<double> batch = std::chrono::steady_clock::now() - start;
+
+	report.add("1 thread", name, frames.size()*rounds/single.count(), "spectra/s");
+	report.add("batch", name, frames.size()*rounds/batch.count(), "spectra/s");
+
+	// The peak is within a bin of the sine, at its RMS level less at most the scalloping loss of the Hann window
+	double frequency = 1/(period*sample_interval);
+	double level = 20*log10(amplitude/sqrt(2.0));
+	for(size_t f = 0; f != results.size(); ++f) {
+		const Spectrum& spectrum = results[f];
+		size_t peak = std::max_element(spectrum.magnitude.begin() + 1, spectrum.magnitude.end()) -
+					spectrum.magnitude.begin();
+		if(fabs(peak*spectrum.bin_width - frequency) > spectrum.bin_width ||
+					fabs(spectrum.magnitude[peak] - level) > 1.5) {
+			report.note(name + " frame " + std::to_string(f) + " peaks at " + std::to_string(peak*spectrum.bin_width) +
+						" Hz, " + std::to_string(spectrum.magnitude[peak]) + " dBV");
+			return false;
+		}
+	}
+	return true;
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	BenchReport report("fft", argc, argv);
+	report.note(std::to_string(std::thread::hardware_concurrency()) + " cores");
+	if(!measure(report, "sine 600", noisySine(20000, 600)) || !measure(report, "sine 16k", noisySine(1000, 16384)) ||
+				!measure(report, "sine 1M", noisySine(16, 1048576)))
+		return 1;
+
+}
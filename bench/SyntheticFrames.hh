@@ -0,0 +1,139 @@
+#ifndef SYNTHETICFRAMES_HH
+#define SYNTHETICFRAMES_HH
+
+// Synthetic frames shared by the benchmarks. The signals are given in volts and turned into raw samples with the
+// scaling of SampleScaler, so the benchmarks can check what they compute against the values the signal was made
+// of. Frames are 1 V/div without offset.
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include "WaveformFrame.hh"
+#include "SampleScaler.hh"
+
+//! Square wave with linear edges, the rising edge crosses the middle at sample 0 (before the shift)
+struct Square_wave {
+
+//! Volts
+	double low;
+	double high;
+//! Samples
+	double period;
+//! Fraction of the period above the middle
+	double duty;
+//! Samples an edge takes from low to high, 0 for steps
+	double edge;
+//! RMS of gaussian noise in raw steps
+	double noise;
+
+	Square_wave() : low(-1.0), high(1.0), period(100.0), duty(0.5), edge(0.0), noise(0.0) {}
+
+//! @return Fraction of the way from low to high at a phase of the period, in samples
+	double level(double phase) const {
+		// Distance from the middle of the rising edge, the first half of the rising edge is at the end of the period
+		double q = phase >= period - edge/2 ? phase - period : phase;
+		double high_end = duty*period;
+		if(edge <= 0)
+			return q < high_end ? 1.0 : 0.0;
+		if(q < edge/2)
+			return 0.5 + q/edge;
+		if(q < high_end - edge/2)
+			return 1.0;
+		if(q < high_end + edge/2)
+			return 0.5 - (q - high_end)/edge;
+		return 0.0;
+	}
+
+};
+
+//! @return Raw sample of volts with noise raw steps added, rounded and limited to the range of the samples
+inline uint8_t syntheticSample(double volts, double noise = 0.0) {
+
+	return std::min(255.0, std::max(0.0, round(SampleScaler::toRaw(volts, 0.0f, 1.0f) + noise)));
+
+}
+
+inline Waveform_frame syntheticFrame(size_t samples, double sample_interval) {
+
+	Waveform_frame frame;
+	frame.volt_scale = 1.0;
+	frame.sample_interval = sample_interval;
+	frame.samples.resize(samples);
+	return frame;
+
+}
+
+//! @param shift Samples the wave is moved to the left by
+inline Waveform_frame squareFrame(const Square_wave& wave, size_t samples, double sample_interval, double shift,
+			std::mt19937& random) {
+
+	std::normal_distribution<double> noise(0.0, wave.noise > 0 ? wave.noise : 1.0);
+	Waveform_frame frame = syntheticFrame(samples, sample_interval);
+	for(size_t i = 0; i != samples; ++i) {
+		double volts = wave.low + wave.level(fmod(i + shift, wave.period))*(wave.high - wave.low);
+		frame.samples[i] = syntheticSample(volts, wave.noise > 0 ? noise(random) : 0.0);
+	}
+	return frame;
+
+}
+
+//! Frames of a square wave, each shifted by shift samples more than the one before
+inline std::vector<Waveform_frame> squareFrames(const Square_wave& wave, size_t frames, size_t samples,
+			double sample_interval, double shift) {
+
+	std::mt19937 random(1);
+	std::vector<Waveform_frame> result;
+	for(size_t f = 0; f != frames; ++f)
+		result.push_back(squareFrame(wave, samples, sample_interval, shift*f, random));
+	return result;
+
+}
+
+//! Frames of a sine of amplitude volts (peak) and a period of period samples, each shifted by shift samples more
+//! than the one before
+//! @param noise RMS of gaussian noise in raw steps
+inline std::vector<Waveform_frame> sineFrames(double amplitude, double period, double noise, size_t frames,
+			size_t samples, double sample_interval, double shift) {
+
+	std::mt19937 random(1);
+	std::normal_distribution<double> gaussian(0.0, noise > 0 ? noise : 1.0);
+	std::vector<Waveform_frame> result;
+	for(size_t f = 0; f != frames; ++f) {
+		Waveform_frame frame = syntheticFrame(samples, sample_interval);
+		for(size_t i = 0; i != samples; ++i) {
+			frame.samples[i] = syntheticSample(amplitude*sin(2*M_PI*(i + shift*f)/period),
+						noise > 0 ? gaussian(random) : 0.0);
+		}
+		result.push_back(frame);
+	}
+	return result;
+
+}
+
+//! Frames of raw samples spread evenly over [low, high]
+inline std::vector<Waveform_frame> noiseFrames(uint8_t low, uint8_t high, size_t frames, size_t samples,
+			double sample_interval) {
+
+	std::mt19937 random(1);
+	std::uniform_int_distribution<int> value(low, high);
+	std::vector<Waveform_frame> result;
+	for(size_t f = 0; f != frames; ++f) {
+		Waveform_frame frame = syntheticFrame(samples, sample_interval);
+		for(uint8_t& sample : frame.samples)
+			sample = value(random);
+		result.push_back(frame);
+	}
+	return result;
+
+}
+
+//! @return true if value is within tolerance (a fraction of expected) of expected
+inline bool near(double value, double expected, double tolerance) {
+
+	return fabs(value - expected) <= tolerance*fabs(expected);
+
+}
+
+#endif
@@ -0,0 +1,145 @@
+// Runs a ScopeEmulator until interrupted, prints the address of its serial port (or TCP address) first.
+//
+// Usage: emulator.bin [options]
+//   --baud <rate>           Baud rate the scope starts at, default 9600
+//   --unpaced               Send as fast as the pty takes the bytes
+//   --max-baud <rate>       Ignore :RS232:BAUD above rate, default 38400
+//   --check-rate            Drop commands sent at a baud rate different from the scope
+//   --latency <us>          Delay before answering a query
+//   --data-latency <us>     Delay before sending a waveform
+//   --acquisition <us>      Time a single sweep takes to trigger
+//   --depth <points>        Long memory depth, default 16384
+//   --silent <header>       Never answer this query, can be given many times
+//   --signal <chan>,<shape>,<frequency>,<amplitude>[,<offset>[,<noise>]]
+//                           Shape is sine, square, triangle, sawtooth or dc, amplitude is peak to peak volts
+//   --link <path>           Symbolic link to the serial port, "/tmp/ttyScope" for example
+//   --tcp <port>            Listen on 127.0.0.1:<port> instead of a serial port, 0 for any free port
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include "ScopeEmulator.hh"
+
+namespace {
+
+Emulator_shape parseShape(const std::string& name) {
+
+	static const char* names[] = {"sine", "square", "triangle", "sawtooth", "dc"};
+	for(size_t i = 0; i != sizeof(names)/sizeof(names[0]); ++i)
+		if(name == names[i])
+			return (Emulator_shape)i;
+	throw std::invalid_argument("Unknown shape " + name);
+
+}
+
+void parseSignal(const std::string& text, Emulator_config& config) {
+
+	std::vector<std::string> fields;
+	std::stringstream stream(text);
+	std::string field;
+	while(std::getline(stream, field, ','))
+		fields.push_back(field);
+	if(fields.size() < 4 || (fields[0] != "1" && fields[0] != "2"))
+		throw std::invalid_argument("Signal has to be <chan>,<shape>,<frequency>,<amplitude>[,<offset>[,<noise>]]");
+
+	Emulator_signal& signal = config.signals[fields[0] == "1" ? 0 : 1];
+	signal.shape = parseShape(fields[1]);
+	signal.frequency = atof(fields[2].c_str());
+	signal.amplitude = atof(fields[3].c_str());
+	if(fields.size() > 4)
+		signal.offset = atof(fields[4].c_str());
+	if(fields.size() > 5)
+		signal.noise = atof(fields[5].c_str());
+
+}
+
+}
+
+int main(int argc, char** argv) {
+
+	Emulator_config config;
+	std::string link;
+
+	try {
+		for(int i = 1; i < argc; ++i) {
+			std::string option = argv[i];
+			if(option == "--unpaced") {
+				config.pace = false;
+				continue;
+			}
+			if(option == "--check-rate") {
+				config.check_line_rate = true;
+				continue;
+			}
+			if(i + 1 == argc)
+				throw std::invalid_argument("Missing value for " + option);
+			std::string value = argv[++i];
+			if(option == "--baud")
+				config.baud = atoi(value.c_str());
+			else if(option == "--max-baud")
+				config.max_baud = atoi(value.c_str());
+			else if(option == "--latency")
+				config.latency = std::chrono::microseconds(atol(value.c_str()));
+			else if(option == "--data-latency")
+				config.data_latency = std::chrono::microseconds(atol(value.c_str()));
+			else if(option == "--acquisition")
+				config.acquisition_time = std::chrono::microseconds(atol(value.c_str()));
+			else if(option == "--depth")
+				config.memory_depth = atol(value.c_str());
+			else if(option == "--silent")
+				config.silent.insert(value);
+			else if(option == "--signal")
+				parseSignal(value, config);
+			else if(option == "--link")
+				link = value;
+			else if(option == "--tcp") {
+				config.tcp = true;
+				config.tcp_port = atoi(value.c_str());
+			}
+			else
+				throw std::invalid_argument("Unknown option " + option);
+		}
+	}
+	catch(std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	if(config.tcp && !link.empty()) {
+		std::cerr << "--link is for the serial port, not --tcp" << std::endl;
+		return 1;
+	}
+
+	// The signals are waited for below, block them before the emulator thread inherits the mask
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, 0);
+
+	ScopeEmulator emulator(config);
+	if(!link.empty()) {
+		unlink(link.c_str());
+		if(symlink(emulator.getDevice().c_str(), link.c_str()) != 0) {
+			std::cerr << "Can not create " << link << std::endl;
+			return 1;
+		}
+	}
+	std::cout << (link.empty() ? emulator.getDevice() : link) << std::endl;
+
+	emulator.start();
+	int signal;
+	sigwait(&signals, &signal);
+	emulator.stop();
+
+	if(!link.empty())
+		unlink(link.c_str());
+	std::cerr << emulator.getCommands() << " commands, " << emulator.getBytesIn() << " bytes in, "
+				<< emulator.getBytesOut() << " bytes out" << std::endl;
+	return 0;
+
+}